@@ -8,7 +8,6 @@ public class HardwareBreakpoints : ModuleRules
 	public HardwareBreakpoints(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
-        bUseUnity = false; //Force separate compilation, otherwise order of definition for MAX_HARDWARE_BREAKPOINTS is undefined
 		
 		PublicIncludePaths.AddRange(
 			new string[] {
@@ -0,0 +1,327 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Commandlets/HWBP_HitLogCommandlet.h"
+
+#include "HAL/PlatformStackWalk.h"
+#include "Misc/Parse.h"
+
+#include "HardwareBreakpointsLog.h"
+#include "Profiling/HWBP_HitLogFormat.h"
+#include "Profiling/HWBP_MappedFileWriter.h"
+
+namespace HWBP_HitLogAnalyzer
+{
+	using namespace HWBP_HitLogFormat;
+
+	struct FModule
+	{
+		uint64 Base = 0;
+		uint64 Size = 0;
+		FString Name;
+	};
+
+	struct FWatchStats
+	{
+		uint64 Hits = 0;
+		uint64 FirstFrame = MAX_uint64;
+		uint64 LastFrame = 0;
+		TSet<uint64> Frames;
+	};
+
+	struct FLog
+	{
+		FHeader Header;
+		TArray<FModule> Modules;
+		TMap<uint32, FString> Strings;
+		TMap<uint32, uint64> ProgramCounters;
+		TMap<uint32, TArray<uint32>> Stacks;
+		TMap<uint32, uint32> ThreadNames;
+
+		uint64 NumHits = 0;
+		uint64 FirstCycles = 0;
+		uint64 LastCycles = 0;
+		TMap<TPair<uint32, uint32>, uint64> HitsPerCallSite;
+		TMap<uint32, FWatchStats> HitsPerLabel;
+		TMap<uint32, uint64> HitsPerThread;
+		TMap<uint32, uint64> HitsPerStack;
+	};
+
+	static bool Parse(const uint8* Data, int64 Size, FLog& Log)
+	{
+		if (Size < (int64)sizeof(FHeader))
+		{
+			return false;
+		}
+		FMemory::Memcpy(&Log.Header, Data, sizeof(FHeader));
+		if (Log.Header.Magic != Magic || Log.Header.Version != Version)
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("Not a hit log, or a different version (%u)"), Log.Header.Version);
+			return false;
+		}
+
+		const uint8* Cursor = Data + sizeof(FHeader);
+		const uint8* End = Data + Size;
+		for (uint32 i = 0; i < Log.Header.NumModules; ++i)
+		{
+			FModule& Module = Log.Modules[Log.Modules.AddDefaulted()];
+			uint64 NameLength;
+			if (End - Cursor < (int64)(2 * sizeof(uint64)))
+			{
+				return false;
+			}
+			FMemory::Memcpy(&Module.Base, Cursor, sizeof(uint64));
+			FMemory::Memcpy(&Module.Size, Cursor + sizeof(uint64), sizeof(uint64));
+			Cursor += 2 * sizeof(uint64);
+			if (!ReadVarint(Cursor, End, NameLength) || (uint64)(End - Cursor) < NameLength)
+			{
+				return false;
+			}
+			Module.Name = FString(FUTF8ToTCHAR((const ANSICHAR*)Cursor, (int32)NameLength));
+			Cursor += NameLength;
+		}
+
+		uint64 Cycles = Log.Header.StartCycles;
+		uint64 Frame = Log.Header.StartFrame;
+		Log.FirstCycles = Cycles;
+		//A truncated record at the end (the process died mid-write) just ends the log
+		while (Cursor < End)
+		{
+			const ERecordTag Tag = (ERecordTag)*Cursor++;
+			uint64 A, B;
+			switch (Tag)
+			{
+			case ERecordTag::None:
+				return true;
+			case ERecordTag::String:
+				if (!ReadVarint(Cursor, End, A) || !ReadVarint(Cursor, End, B) || (uint64)(End - Cursor) < B)
+				{
+					return true;
+				}
+				Log.Strings.Add((uint32)A, FString(FUTF8ToTCHAR((const ANSICHAR*)Cursor, (int32)B)));
+				Cursor += B;
+				break;
+			case ERecordTag::ProgramCounter:
+				if (!ReadVarint(Cursor, End, A) || !ReadVarint(Cursor, End, B))
+				{
+					return true;
+				}
+				Log.ProgramCounters.Add((uint32)A, B);
+				break;
+			case ERecordTag::Stack:
+			{
+				if (!ReadVarint(Cursor, End, A) || !ReadVarint(Cursor, End, B))
+				{
+					return true;
+				}
+				TArray<uint32>& Frames = Log.Stacks.Add((uint32)A);
+				for (uint64 i = 0; i < B; ++i)
+				{
+					uint64 FrameId;
+					if (!ReadVarint(Cursor, End, FrameId))
+					{
+						return true;
+					}
+					Frames.Add((uint32)FrameId);
+				}
+				break;
+			}
+			case ERecordTag::Thread:
+				if (!ReadVarint(Cursor, End, A) || !ReadVarint(Cursor, End, B))
+				{
+					return true;
+				}
+				Log.ThreadNames.Add((uint32)A, (uint32)B);
+				break;
+			case ERecordTag::Hit:
+			{
+				uint64 Fields[8];
+				for (uint64& Field : Fields)
+				{
+					if (!ReadVarint(Cursor, End, Field))
+					{
+						return true;
+					}
+				}
+				const uint64 ValueSize = Fields[7];
+				if ((uint64)(End - Cursor) < ValueSize)
+				{
+					return true;
+				}
+				Cursor += ValueSize;
+				Cycles += Fields[0];
+				Frame += Fields[1];
+				const uint32 ThreadId = (uint32)Fields[2];
+				const uint32 LabelId = (uint32)Fields[4];
+				const uint32 ProgramCounterId = (uint32)Fields[5];
+				const uint32 StackId = (uint32)Fields[6];
+
+				++Log.NumHits;
+				Log.LastCycles = Cycles;
+				++Log.HitsPerCallSite.FindOrAdd(TPair<uint32, uint32>(LabelId, ProgramCounterId));
+				++Log.HitsPerThread.FindOrAdd(ThreadId);
+				if (StackId != 0)
+				{
+					++Log.HitsPerStack.FindOrAdd(StackId);
+				}
+				FWatchStats& Watch = Log.HitsPerLabel.FindOrAdd(LabelId);
+				++Watch.Hits;
+				Watch.FirstFrame = FMath::Min(Watch.FirstFrame, Frame);
+				Watch.LastFrame = FMath::Max(Watch.LastFrame, Frame);
+				Watch.Frames.Add(Frame);
+				break;
+			}
+			default:
+				UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Unknown record tag %u, stopping"), (uint32)Tag);
+				return true;
+			}
+		}
+		return true;
+	}
+
+	//Maps a program counter from the logged process to the same module in this one, and resolves its symbol
+	class FSymbolizer
+	{
+	public:
+		explicit FSymbolizer(const TArray<FModule>& InLoggedModules)
+			: LoggedModules(InLoggedModules)
+		{
+			FPlatformStackWalk::InitStackWalking();
+			TArray<FStackWalkModuleInfo> Modules;
+			Modules.SetNum(FPlatformStackWalk::GetProcessModuleCount());
+			Modules.SetNum(FPlatformStackWalk::GetProcessModuleSignatures(Modules.GetData(), Modules.Num()));
+			for (const FStackWalkModuleInfo& Module : Modules)
+			{
+				LocalBases.Add(Module.ModuleName, Module.BaseOfImage);
+			}
+		}
+
+		FString Describe(uint64 ProgramCounter)
+		{
+			if (const FString* Cached = Cache.Find(ProgramCounter))
+			{
+				return *Cached;
+			}
+			FString Description = FString::Printf(TEXT("0x%016llX"), ProgramCounter);
+			for (const FModule& Module : LoggedModules)
+			{
+				if (ProgramCounter >= Module.Base && ProgramCounter < Module.Base + Module.Size)
+				{
+					const uint64 Offset = ProgramCounter - Module.Base;
+					Description = FString::Printf(TEXT("%s+0x%llX"), *Module.Name, Offset);
+					if (const uint64* LocalBase = LocalBases.Find(Module.Name))
+					{
+						ANSICHAR Symbol[1024] = { 0 };
+						FPlatformStackWalk::ProgramCounterToHumanReadableString(0, *LocalBase + Offset, Symbol, sizeof(Symbol));
+						Description = FString(ANSI_TO_TCHAR(Symbol)).TrimStartAndEnd();
+					}
+					break;
+				}
+			}
+			Cache.Add(ProgramCounter, Description);
+			return Description;
+		}
+
+	private:
+		const TArray<FModule>& LoggedModules;
+		TMap<FString, uint64> LocalBases;
+		TMap<uint64, FString> Cache;
+	};
+
+	template<typename KeyType>
+	static TArray<TPair<KeyType, uint64>> SortedByCount(const TMap<KeyType, uint64>& Counts, int32 Top)
+	{
+		TArray<TPair<KeyType, uint64>> Sorted = Counts.Array();
+		Sorted.Sort([](const TPair<KeyType, uint64>& A, const TPair<KeyType, uint64>& B) { return A.Value > B.Value; });
+		if (Sorted.Num() > Top)
+		{
+			Sorted.SetNum(Top);
+		}
+		return Sorted;
+	}
+}
+
+UHWBP_HitLogCommandlet::UHWBP_HitLogCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UHWBP_HitLogCommandlet::Main(const FString& Params)
+{
+	using namespace HWBP_HitLogAnalyzer;
+
+	FString Filename;
+	int32 Top = 20;
+	if (!FParse::Value(*Params, TEXT("File="), Filename))
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Usage: -run=HWBP_HitLog -File=<Path> [-Top=N]"));
+		return 1;
+	}
+	FParse::Value(*Params, TEXT("Top="), Top);
+
+	//Captures can be several GB, they're parsed straight from the mapped file instead of being copied into memory
+	FHWBP_MappedFileReader Reader;
+	if (!Reader.Open(Filename))
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't read %s"), *Filename);
+		return 1;
+	}
+	FLog Log;
+	if (!HWBP_HitLogAnalyzer::Parse(Reader.GetData(), Reader.GetSize(), Log))
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("%s is not a valid hit log"), *Filename);
+		return 1;
+	}
+
+	auto GetString = [&Log](uint32 Id) -> FString
+	{
+		const FString* String = Log.Strings.Find(Id);
+		return String && !String->IsEmpty() ? *String : FString(TEXT("Unlabeled"));
+	};
+	FSymbolizer Symbolizer(Log.Modules);
+	const double Seconds = (Log.LastCycles - Log.FirstCycles) * Log.Header.SecondsPerCycle;
+
+	UE_LOG(LogHardwareBreakpoints, Display, TEXT("%s: %llu hits over %.2fs, %d call sites, %d unique stacks, %lld bytes (%.1f bytes/hit)"),
+		*Filename, Log.NumHits, Seconds, Log.ProgramCounters.Num(), Log.Stacks.Num(), Reader.GetSize(), Log.NumHits ? (double)Reader.GetSize() / Log.NumHits : 0.0);
+
+	UE_LOG(LogHardwareBreakpoints, Display, TEXT("Watches:"));
+	for (const TPair<uint32, FWatchStats>& Watch : Log.HitsPerLabel)
+	{
+		const uint64 FrameSpan = Watch.Value.LastFrame - Watch.Value.FirstFrame + 1;
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %-48s %10llu hits, %.1f hits/s, %.2f hits/frame over %llu frames (hit in %d)"),
+			*GetString(Watch.Key), Watch.Value.Hits, Seconds > 0.0 ? Watch.Value.Hits / Seconds : 0.0,
+			(double)Watch.Value.Hits / FrameSpan, FrameSpan, Watch.Value.Frames.Num());
+	}
+
+	UE_LOG(LogHardwareBreakpoints, Display, TEXT("Top writers:"));
+	for (const TPair<TPair<uint32, uint32>, uint64>& CallSite : SortedByCount(Log.HitsPerCallSite, Top))
+	{
+		const uint64* ProgramCounter = Log.ProgramCounters.Find(CallSite.Key.Value);
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %10llu  %-32s %s"), CallSite.Value, *GetString(CallSite.Key.Key),
+			ProgramCounter ? *Symbolizer.Describe(*ProgramCounter) : TEXT("?"));
+	}
+
+	UE_LOG(LogHardwareBreakpoints, Display, TEXT("Threads:"));
+	for (const TPair<uint32, uint64>& Thread : SortedByCount(Log.HitsPerThread, Top))
+	{
+		const uint32* NameId = Log.ThreadNames.Find(Thread.Key);
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %10llu  %s (%u)"), Thread.Value, NameId ? *GetString(*NameId) : TEXT("?"), Thread.Key);
+	}
+
+	if (Log.HitsPerStack.Num() > 0)
+	{
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("Top stacks:"));
+		for (const TPair<uint32, uint64>& Stack : SortedByCount(Log.HitsPerStack, Top))
+		{
+			UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %llu hits:"), Stack.Value);
+			for (uint32 FrameId : Log.Stacks.FindRef(Stack.Key))
+			{
+				const uint64* ProgramCounter = Log.ProgramCounters.Find(FrameId);
+				UE_LOG(LogHardwareBreakpoints, Display, TEXT("      %s"), ProgramCounter ? *Symbolizer.Describe(*ProgramCounter) : TEXT("?"));
+			}
+		}
+	}
+	return 0;
+}
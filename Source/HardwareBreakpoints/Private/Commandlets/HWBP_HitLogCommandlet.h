@@ -0,0 +1,22 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "HWBP_HitLogCommandlet.generated.h"
+
+//Summarizes a binary hit log written by HWBP.HitLog.Start: top writers by call site, hit rates per watch and per thread,
+//and the most common call stacks. Call sites are symbolized against the modules loaded by the commandlet, so run it
+//from the same build that wrote the log
+//	UnrealEditor-Cmd <Project> -run=HWBP_HitLog -File=<Path> [-Top=N]
+UCLASS()
+class UHWBP_HitLogCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UHWBP_HitLogCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -2,6 +2,7 @@
 
 #include "HAL/PlatformHardwareBreakpoints.h"
 
+#include "Containers/ScriptArray.h"
 #include "Misc/ScopeExit.h"
 #include "Runtime/Launch/Resources/Version.h"
 #if ENGINE_MAJOR_VERSION >= 5 || ENGINE_MAJOR_VERSION == 4 && ENGINE_MINOR_VERSION >= 20
@@ -10,7 +11,18 @@
 	#include "GenericPlatformMath.h"
 #endif
 
-//This stuff depends on the value of MAX_HARDWARE_BREAKPOINTS which is defined per platform, so this has to be here instead of in GenericPlatformHardwareBreakpoints.cpp
+#include "HWBP_OwnerTracking.h"
+#include "HWBP_StackDedupe.h"
+#include "HWBP_Trace.h"
+#include "HWBP_Core/HWBP_HitClassification.h"
+#include "Profiling/HWBP_ChromeTrace.h"
+#include "Profiling/HWBP_FalseSharing.h"
+#include "Profiling/HWBP_FrameAttribution.h"
+#include "Profiling/HWBP_HitLog.h"
+#include "Profiling/HWBP_NodeHeatmap.h"
+#include "Profiling/HWBP_ReallocChurn.h"
+
+//This stuff depends on the number of slots of the platform, so this has to be here instead of in GenericPlatformHardwareBreakpoints.cpp
 
 template <typename T>
 static void SafeDelete(T*& Ptr)
@@ -22,32 +34,254 @@ static void SafeDelete(T*& Ptr)
 	}
 }
 
+//Realloc-following breakpoints assume the usual TArray layout: data pointer first, followed by ArrayNum
+static_assert(sizeof(FScriptArray) == sizeof(void*) + 2 * sizeof(int32), "Unexpected FScriptArray layout, realloc-following breakpoints need to be updated");
+
+//Only called when a breakpoint is removed for good. Disarming a slot in the handler to step over it must keep its data,
+//the register is re-enabled with the same label, filter, depth and linked slots after the single step
 void FGenericPlatformHardwareBreakpoints::RemoveBreakpointAssociatedData(DebugRegisterIndex Index)
 {
-	if (Index >= 0 && Index < MAX_HARDWARE_BREAKPOINTS)
+	if (Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots)
 	{
-		DataBreakpointInfo[Index].Address = nullptr;
 		SafeDelete(DataBreakpointInfo[Index].Condition);
+		SafeDelete(DataBreakpointInfo[Index].Latency);
+		DataBreakpointInfo[Index] = FDataBreakpointInfo();
+		HWBP_OwnerTracking::Untrack(Index);
+		HWBP_StackDedupe::ResetSlot(Index);
 	}
 }
 
 void FGenericPlatformHardwareBreakpoints::RemoveAllBreakpointAssociatedData()
 {
-	for (int i = 0; i < MAX_HARDWARE_BREAKPOINTS; ++i)
+	for (int i = 0; i < FPlatformHardwareBreakpointTraits::NumSlots; ++i)
 	{
-		DataBreakpointInfo[i].Address = nullptr;
 		SafeDelete(DataBreakpointInfo[i].Condition);
+		SafeDelete(DataBreakpointInfo[i].Latency);
+		DataBreakpointInfo[i] = FDataBreakpointInfo();
+		HWBP_OwnerTracking::Untrack(i);
+	}
+}
+
+int32 FGenericPlatformHardwareBreakpoints::GetLinkedBreakpoints(DebugRegisterIndex Index, DebugRegisterIndex (&OutLinked)[FPlatformHardwareBreakpointTraits::NumSlots])
+{
+	int32 NumLinked = 0;
+	if (Index < 0 || Index >= FPlatformHardwareBreakpointTraits::NumSlots || DataBreakpointInfo[Index].Group < 0)
+	{
+		return 0;
+	}
+	const DebugRegisterIndex Group = DataBreakpointInfo[Index].Group;
+	for (int i = 0; i < FPlatformHardwareBreakpointTraits::NumSlots; ++i)
+	{
+		if (i != Index && DataBreakpointInfo[i].Address && DataBreakpointInfo[i].Group == Group)
+		{
+			OutLinked[NumLinked++] = i;
+		}
+	}
+	return NumLinked;
+}
+
+int32 FGenericPlatformHardwareBreakpoints::RemoveBreakpointsWithDestroyedOwners(DebugRegisterIndex (&OutRemoved)[FPlatformHardwareBreakpointTraits::NumSlots])
+{
+	int32 NumRemoved = 0;
+	for (int32 i = 0; i < FPlatformHardwareBreakpointTraits::NumSlots; ++i)
+	{
+		//Removing a watch also clears its linked slots, so they're skipped here
+		if (DataBreakpointInfo[i].bHasOwner && !DataBreakpointInfo[i].Owner.IsValid())
+		{
+			FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(i);
+			OutRemoved[NumRemoved++] = i;
+		}
+	}
+	return NumRemoved;
+}
+
+//Where element watches of realloc-following breakpoints wait while their element is past the end of the array
+alignas(8) static uint64 ContainerElementParking = 0;
+
+void FGenericPlatformHardwareBreakpoints::HandleContainerHeaderWrite(DebugRegisterIndex Index, struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	FDataBreakpointInfo& HeaderInfo = DataBreakpointInfo[Index];
+	FDataBreakpointInfo& ElementInfo = DataBreakpointInfo[HeaderInfo.Group];
+	const FScriptArray* Array = static_cast<const FScriptArray*>(ElementInfo.ArrayHeader);
+
+	int32 OldNum = 0;
+	if (HeaderInfo.Role == EDataBreakpointRole::ContainerNum)
+	{
+		FMemory::Memcpy(&OldNum, HeaderInfo.LastValue, sizeof(OldNum));
+	}
+	FMemory::Memcpy(HeaderInfo.LastValue, HeaderInfo.Address, HeaderInfo.Size);
+
+	//Re-resolve the element in the current allocation and move the watch there
+	//An element past the end of the array is parked instead: after Shrink() or Empty() its old offset can be past the end of the new
+	//allocation, or there may be no allocation at all. It's moved back when the data pointer or ArrayNum shows it exists again
+	void* NewData = const_cast<void*>(Array->GetData());
+	void* NewAddress = &ContainerElementParking;
+	if (NewData != nullptr && ElementInfo.ElementIndex < Array->Num())
+	{
+		NewAddress = static_cast<uint8*>(NewData) + ElementInfo.ElementIndex * ElementInfo.ElementSize + ElementInfo.OffsetInElement;
+	}
+	if (NewAddress != ElementInfo.Address && FPlatformHardwareBreakpoints::RetargetBreakpointInContext(HeaderInfo.Group, NewAddress, ExceptionInfo))
+	{
+		ElementInfo.Address = NewAddress;
+		FMemory::Memcpy(ElementInfo.LastValue, NewAddress, ElementInfo.Size);
+	}
+
+	if (HeaderInfo.Role == EDataBreakpointRole::ContainerData)
+	{
+		HWBP_ReallocChurn::RecordContainerWrite(Array, HWBP_ReallocChurn::EContainerEvent::Reallocation, ExceptionInfo);
+	}
+	else if (Array->Num() != OldNum)
+	{
+		HWBP_ReallocChurn::RecordContainerWrite(Array, Array->Num() > OldNum ? HWBP_ReallocChurn::EContainerEvent::Grow : HWBP_ReallocChurn::EContainerEvent::Shrink, ExceptionInfo);
+	}
+}
+
+//Feeds a data breakpoint hit to every recorder that is running. LastValue still holds the value before the write
+void FGenericPlatformHardwareBreakpoints::RecordHit(DebugRegisterIndex Index, uint64 ProgramCounter, struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	const FDataBreakpointInfo& Info = DataBreakpointInfo[Index];
+	HWBP_TRACE_HIT(Index, ProgramCounter);
+	HWBP_ChromeTrace::RecordHit(Index, Info.Label, Info.Address, Info.LastValue, Info.Size, ProgramCounter);
+	HWBP_HitLog::RecordHit(Index, Info.Label, Info.Address, Info.Size, ProgramCounter, ExceptionInfo);
+	HWBP_NodeHeatmap::RecordHit(Info.Label, Info.Address);
+	HWBP_FrameAttribution::RecordHit(Info.Label, Info.Address);
+}
+
+//The return slot of a latency probe is parked here between calls. It's data, so an execute breakpoint on it never fires
+static uint8 ProbeReturnParking = 0;
+
+bool FGenericPlatformHardwareBreakpoints::HandleFunctionProbeHit(DebugRegisterIndex& OutRegisterIndex, bool& bOutStepOver, struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	const uint64 Now = FPlatformTime::Cycles64();
+	const uint64 ProgramCounter = FPlatformHardwareBreakpoints::GetExceptionProgramCounter(ExceptionInfo);
+	for (int i = 0; i < FPlatformHardwareBreakpointTraits::NumSlots; ++i)
+	{
+		FDataBreakpointInfo& Info = DataBreakpointInfo[i];
+		if ((uint64)Info.Address != ProgramCounter)
+		{
+			continue;
+		}
+		if (Info.Role == EDataBreakpointRole::ProbeEntry)
+		{
+			DebugRegisterIndex Linked[FPlatformHardwareBreakpointTraits::NumSlots];
+			const int32 NumLinked = GetLinkedBreakpoints(i, Linked);
+			if (NumLinked == 0)
+			{
+				return false;
+			}
+			FDataBreakpointInfo& ReturnInfo = DataBreakpointInfo[Linked[0]];
+			const uint64 StackPointer = FPlatformHardwareBreakpoints::GetExceptionStackPointer(ExceptionInfo);
+			const bool bTimingCall = ReturnInfo.Address != &ProbeReturnParking;
+			//The stack grows down, so a deeper entry while a call is being timed is a nested call
+			//An entry at the same depth or above means the timed call was unwound without returning
+			if (bTimingCall && StackPointer < ReturnInfo.ProbeEntryStackPointer)
+			{
+				++Info.Latency->NestedCalls;
+			}
+			else
+			{
+				Info.Latency->AbandonedCalls += bTimingCall ? 1 : 0;
+				//On entry the return address is the first thing on the stack
+				void* ReturnAddress = *reinterpret_cast<void**>(StackPointer);
+				if (FPlatformHardwareBreakpoints::RetargetBreakpointInContext(Linked[0], ReturnAddress, ExceptionInfo))
+				{
+					ReturnInfo.Address = ReturnAddress;
+					ReturnInfo.ProbeEntryStackPointer = StackPointer;
+					ReturnInfo.ProbeEntryCycles = FPlatformTime::Cycles64();
+					//The entry timestamp doubles as the id linking entry and return in exported traces
+					HWBP_ChromeTrace::RecordProbeEntry(i, Info.Label, ReturnInfo.ProbeEntryCycles);
+				}
+			}
+			//Execute breakpoints fire before the instruction runs, so it has to be stepped over or it would fire again
+			OutRegisterIndex = i;
+			bOutStepOver = true;
+			return true;
+		}
+		if (Info.Role == EDataBreakpointRole::ExecuteCounter)
+		{
+			Info.Counters.Record(ProgramCounter);
+			RecordHit(i, ProgramCounter, ExceptionInfo);
+			OutRegisterIndex = i;
+			bOutStepOver = true;
+			return true;
+		}
+		if (Info.Role == EDataBreakpointRole::ProbeReturn)
+		{
+			OutRegisterIndex = i;
+			//A nested call returning to the same call site, keep waiting for the outer one
+			if (FPlatformHardwareBreakpoints::GetExceptionStackPointer(ExceptionInfo) <= Info.ProbeEntryStackPointer)
+			{
+				bOutStepOver = true;
+				return true;
+			}
+			DataBreakpointInfo[Info.Group].Latency->Record(Now - Info.ProbeEntryCycles);
+			HWBP_ChromeTrace::RecordProbeReturn(Info.Group, DataBreakpointInfo[Info.Group].Label, Info.ProbeEntryCycles, Info.ProbeEntryCycles);
+			//Parking the slot also means it won't fire again when execution continues, no need to step over
+			FPlatformHardwareBreakpoints::RetargetBreakpointInContext(i, &ProbeReturnParking, ExceptionInfo);
+			Info.Address = &ProbeReturnParking;
+			bOutStepOver = false;
+			return true;
+		}
 	}
+	return false;
 }
 
 PRAGMA_DISABLE_OPTIMIZATION
 bool FGenericPlatformHardwareBreakpoints::CheckDataBreakpointConditions(int& OutRegisterIndex, struct _EXCEPTION_POINTERS *ExceptionInfo)
 {
-	const int maxBreakpoints = MAX_HARDWARE_BREAKPOINTS;
+	const int maxBreakpoints = FPlatformHardwareBreakpointTraits::NumSlots;
+	const uint32 TriggeredMask = FPlatformHardwareBreakpoints::GetTriggeredBreakpointMask(ExceptionInfo);
 	for (int i = 0; i < maxBreakpoints; ++i)
 	{
-		if (DataBreakpointInfo[i].Address)
+		if (DataBreakpointInfo[i].Role == EDataBreakpointRole::ProbeEntry || DataBreakpointInfo[i].Role == EDataBreakpointRole::ProbeReturn || DataBreakpointInfo[i].Role == EDataBreakpointRole::ExecuteCounter)
+		{
+			continue;
+		}
+		if (DataBreakpointInfo[i].Address && DataBreakpointInfo[i].Mode != EDataBreakpointMode::Break)
+		{
+			//Counting watches skip everything else: no owner check, no conditions, no stack walk
+			//With DR6 we can tell exactly which slot fired, which also catches writes of the same value
+			//Watches armed on all threads are hit concurrently, so the last value is swapped in one atomic exchange and each hit
+			//is compared against the value right before it, never against one another thread is halfway through updating
+			uint64 CurrentValue = 0;
+			FMemory::Memcpy(&CurrentValue, DataBreakpointInfo[i].Address, DataBreakpointInfo[i].Size);
+			const uint64 PreviousValue = (uint64)FPlatformAtomics::InterlockedExchange((volatile int64*)DataBreakpointInfo[i].LastValue, (int64)CurrentValue);
+			const HWBP_Core::FHitClassification Hit = HWBP_Core::ClassifyHit(TriggeredMask, i, &PreviousValue, &CurrentValue, DataBreakpointInfo[i].Size);
+			//A store that spans several linked slots fires all of them in one exception, it's only counted on the lowest one
+			bool bCountedOnLinkedSlot = false;
+			for (int j = 0; j < i && DataBreakpointInfo[i].Group >= 0; ++j)
+			{
+				bCountedOnLinkedSlot |= (TriggeredMask & (1u << j)) != 0 && DataBreakpointInfo[j].Address && DataBreakpointInfo[j].Group == DataBreakpointInfo[i].Group;
+			}
+			if (Hit.bTriggered && !bCountedOnLinkedSlot)
+			{
+				const bool bRedundant = DataBreakpointInfo[i].Mode == EDataBreakpointMode::RedundantWrites && Hit.bRedundant;
+				const uint64 ProgramCounter = FPlatformHardwareBreakpoints::GetExceptionProgramCounter(ExceptionInfo);
+				DataBreakpointInfo[i].Counters.Record(ProgramCounter, bRedundant);
+				RecordHit(i, ProgramCounter, ExceptionInfo);
+				if (DataBreakpointInfo[i].Mode == EDataBreakpointMode::ThreadAttribution)
+				{
+					HWBP_FalseSharing::RecordWrite(DataBreakpointInfo[i].Address, DataBreakpointInfo[i].Size, (const uint8*)&PreviousValue, (const uint8*)&CurrentValue, ProgramCounter);
+				}
+			}
+		}
+		else if (DataBreakpointInfo[i].Address && DataBreakpointInfo[i].Role != EDataBreakpointRole::Watch)
 		{
+			//Container header watches are internal, they never break, they just keep the element watch they belong to up to date
+			if (FMemory::Memcmp(DataBreakpointInfo[i].LastValue, DataBreakpointInfo[i].Address, DataBreakpointInfo[i].Size) != 0)
+			{
+				HandleContainerHeaderWrite(i, ExceptionInfo);
+			}
+		}
+		else if (DataBreakpointInfo[i].Address)
+		{
+			//Writes to an element slot that is currently past the end of its container are writes to slack memory, not to the element
+			if (DataBreakpointInfo[i].ArrayHeader && DataBreakpointInfo[i].ElementIndex >= static_cast<const FScriptArray*>(DataBreakpointInfo[i].ArrayHeader)->Num())
+			{
+				FMemory::Memcpy(DataBreakpointInfo[i].LastValue, DataBreakpointInfo[i].Address, DataBreakpointInfo[i].Size);
+				continue;
+			}
+
 			//We check the current value of the memory for each data breakpoint compared to its last known value
 			//(we store it when the breakpoint is set)
 			//So if it's different, then we can assume it's because this breakpoint was hit
@@ -88,12 +322,15 @@ bool FGenericPlatformHardwareBreakpoints::CheckDataBreakpointConditions(int& Out
 					{
 						if (DataBreakpointInfo[i].Condition->ShouldBreak(DataBreakpointInfo[i].LastValue, DataBreakpointInfo[i].Address))
 						{
+							RecordHit(i, FPlatformHardwareBreakpoints::GetExceptionProgramCounter(ExceptionInfo), ExceptionInfo);
 							OutRegisterIndex = i;
 							return true;
 						}
+						HWBP_TRACE_CONDITION_REJECTED(i);
 					}
 					else
 					{
+						RecordHit(i, FPlatformHardwareBreakpoints::GetExceptionProgramCounter(ExceptionInfo), ExceptionInfo);
 						OutRegisterIndex = i;
 						return true;
 					}
@@ -102,7 +339,7 @@ bool FGenericPlatformHardwareBreakpoints::CheckDataBreakpointConditions(int& Out
 				//freed memory
 				else if (DataBreakpointInfo[i].bHasOwner)
 				{
-					FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(i);
+					FPlatformHardwareBreakpoints::RemoveBreakpointInContext(i, ExceptionInfo);
 				}
 			}
 		}
@@ -111,7 +348,7 @@ bool FGenericPlatformHardwareBreakpoints::CheckDataBreakpointConditions(int& Out
 }
 PRAGMA_ENABLE_OPTIMIZATION
 
-DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetDataBreakpoint(void* Address, int DataSize, UObject* Owner)
+EHardwareBreakpointSize FGenericPlatformHardwareBreakpoints::GetBreakpointSizeForDataSize(int DataSize)
 {
 	DataSize = FGenericPlatformMath::Min(8, DataSize);
 	EHardwareBreakpointSize BreakpointSize = EHardwareBreakpointSize::Size_8;
@@ -127,17 +364,238 @@ DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetDataBreakpoint(void*
 	{
 		BreakpointSize = EHardwareBreakpointSize::Size_1;
 	}
-	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Write, BreakpointSize, Address);
+	return BreakpointSize;
+}
+
+void FGenericPlatformHardwareBreakpoints::InitDataBreakpointInfo(DebugRegisterIndex Index, void* Address, int DataSize, UObject* Owner)
+{
+	DataSize = FGenericPlatformMath::Min(8, DataSize);
+	DataBreakpointInfo[Index].Owner = Owner;
+	DataBreakpointInfo[Index].bHasOwner = Owner != nullptr;
+	if (Owner != nullptr)
+	{
+		HWBP_OwnerTracking::Track(Index, Owner);
+	}
+	DataBreakpointInfo[Index].Address = Address;
+	DataBreakpointInfo[Index].Size = DataSize;
+	FMemory::Memcpy(DataBreakpointInfo[Index].LastValue, Address, DataSize);
+}
+
+DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetDataBreakpoint(void* Address, int DataSize, UObject* Owner)
+{
+	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Write, GetBreakpointSizeForDataSize(DataSize), Address);
+	if (Index >= 0)
+	{
+		InitDataBreakpointInfo(Index, Address, DataSize, Owner);
+	}
+	return Index;
+}
+
+DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetThreadAttributionDataBreakpoint(void* Address, int DataSize)
+{
+	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetHardwareBreakpointOnAllThreads(EHardwareBreakpointType::Write, GetBreakpointSizeForDataSize(DataSize), Address);
+	if (Index >= 0)
+	{
+		InitDataBreakpointInfo(Index, Address, DataSize, nullptr);
+		DataBreakpointInfo[Index].Mode = EDataBreakpointMode::ThreadAttribution;
+		DataBreakpointInfo[Index].bAllThreads = true;
+	}
+	return Index;
+}
+
+DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetCountingDataBreakpoint(void* Address, int DataSize, UObject* Owner)
+{
+	DebugRegisterIndex Index = SetDataBreakpoint(Address, DataSize, Owner);
+	if (Index >= 0)
+	{
+		DataBreakpointInfo[Index].Mode = EDataBreakpointMode::CountOnly;
+	}
+	return Index;
+}
+
+DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetCountingExecuteBreakpoint(void* Address)
+{
+	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Execute, EHardwareBreakpointSize::Size_1, Address);
 	if (Index >= 0)
 	{
-		DataBreakpointInfo[Index].Owner = Owner;
-		DataBreakpointInfo[Index].bHasOwner = Owner != nullptr;
 		DataBreakpointInfo[Index].Address = Address;
-		DataBreakpointInfo[Index].Size = DataSize;
-		FMemory::Memcpy(DataBreakpointInfo[Index].LastValue, Address, DataSize);
+		DataBreakpointInfo[Index].Role = EDataBreakpointRole::ExecuteCounter;
+		DataBreakpointInfo[Index].Mode = EDataBreakpointMode::CountOnly;
+	}
+	return Index;
+}
+
+DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetRedundantWriteDataBreakpoint(void* Address, int DataSize, UObject* Owner)
+{
+	DebugRegisterIndex Index = SetDataBreakpoint(Address, DataSize, Owner);
+	if (Index >= 0)
+	{
+		DataBreakpointInfo[Index].Mode = EDataBreakpointMode::RedundantWrites;
+	}
+	return Index;
+}
+
+DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetFunctionLatencyProbe(void* FunctionAddress)
+{
+	if (FunctionAddress == nullptr)
+	{
+		return -1;
+	}
+	DebugRegisterIndex EntryIndex = FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Execute, EHardwareBreakpointSize::Size_1, FunctionAddress);
+	if (EntryIndex < 0)
+	{
+		return -1;
+	}
+	//The return slot is reserved up front, the handler can't look for a free debug register
+	DebugRegisterIndex ReturnIndex = FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Execute, EHardwareBreakpointSize::Size_1, &ProbeReturnParking);
+	if (ReturnIndex < 0)
+	{
+		FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(EntryIndex);
+		return -1;
+	}
+	FDataBreakpointInfo& EntryInfo = DataBreakpointInfo[EntryIndex];
+	EntryInfo.Address = FunctionAddress;
+	EntryInfo.Role = EDataBreakpointRole::ProbeEntry;
+	EntryInfo.Group = EntryIndex;
+	EntryInfo.Latency = new FHardwareBreakpointLatencyHistogram();
+
+	FDataBreakpointInfo& ReturnInfo = DataBreakpointInfo[ReturnIndex];
+	ReturnInfo.Address = &ProbeReturnParking;
+	ReturnInfo.Role = EDataBreakpointRole::ProbeReturn;
+	ReturnInfo.Group = EntryIndex;
+	return EntryIndex;
+}
+
+bool FGenericPlatformHardwareBreakpoints::GetLatencyHistogram(DebugRegisterIndex Index, FHardwareBreakpointLatencyHistogram& OutHistogram, bool bReset)
+{
+	if (Index < 0 || Index >= FPlatformHardwareBreakpointTraits::NumSlots || DataBreakpointInfo[Index].Latency == nullptr)
+	{
+		return false;
+	}
+	OutHistogram = *DataBreakpointInfo[Index].Latency;
+	if (bReset)
+	{
+		DataBreakpointInfo[Index].Latency->Reset();
+	}
+	return true;
+}
+
+void FGenericPlatformHardwareBreakpoints::LinkBreakpoints(const DebugRegisterIndex* Indices, int32 NumIndices)
+{
+	if (NumIndices < 2)
+	{
+		return;
+	}
+	for (int32 i = 0; i < NumIndices; ++i)
+	{
+		if (Indices[i] >= 0 && Indices[i] < FPlatformHardwareBreakpointTraits::NumSlots)
+		{
+			DataBreakpointInfo[Indices[i]].Group = Indices[0];
+		}
+	}
+}
+
+void FGenericPlatformHardwareBreakpoints::SetBreakpointLabel(DebugRegisterIndex Index, FName Label)
+{
+	if (Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots)
+	{
+		DataBreakpointInfo[Index].Label = Label;
+	}
+}
+
+void FGenericPlatformHardwareBreakpoints::SetBreakpointInstanceFilter(DebugRegisterIndex Index, const void* Instance)
+{
+	if (Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots)
+	{
+		DataBreakpointInfo[Index].InstanceFilter = Instance;
+	}
+}
+
+const void* FGenericPlatformHardwareBreakpoints::GetBreakpointInstanceFilter(DebugRegisterIndex Index)
+{
+	return Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots ? DataBreakpointInfo[Index].InstanceFilter : nullptr;
+}
+
+FName FGenericPlatformHardwareBreakpoints::GetBreakpointLabel(DebugRegisterIndex Index)
+{
+	return Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots ? DataBreakpointInfo[Index].Label : NAME_None;
+}
+
+const void* FGenericPlatformHardwareBreakpoints::GetBreakpointAddress(DebugRegisterIndex Index)
+{
+	return Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots ? DataBreakpointInfo[Index].Address : nullptr;
+}
+
+EDataBreakpointMode FGenericPlatformHardwareBreakpoints::GetBreakpointMode(DebugRegisterIndex Index)
+{
+	return Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots ? DataBreakpointInfo[Index].Mode : EDataBreakpointMode::Break;
+}
+
+void FGenericPlatformHardwareBreakpoints::SetBreakpointStackDepth(DebugRegisterIndex Index, int32 Depth)
+{
+	if (Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots)
+	{
+		DataBreakpointInfo[Index].StackDepth = (uint16)FMath::Clamp(Depth, 0, (int32)MAX_uint16);
+	}
+}
+
+int32 FGenericPlatformHardwareBreakpoints::GetBreakpointStackDepth(DebugRegisterIndex Index)
+{
+	return Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots ? DataBreakpointInfo[Index].StackDepth : 0;
+}
+
+bool FGenericPlatformHardwareBreakpoints::GetHitCounters(DebugRegisterIndex Index, FHardwareBreakpointHitCounters& OutCounters, bool bReset)
+{
+	if (Index < 0 || Index >= FPlatformHardwareBreakpointTraits::NumSlots || DataBreakpointInfo[Index].Address == nullptr)
+	{
+		return false;
+	}
+	OutCounters = DataBreakpointInfo[Index].Counters;
+	if (bReset)
+	{
+		DataBreakpointInfo[Index].Counters.Reset();
+	}
+	return true;
+}
+
+DebugRegisterIndex FGenericPlatformHardwareBreakpoints::SetReallocFollowingDataBreakpoint(void* ArrayHeader, int32 ElementIndex, int32 ElementSize, int32 OffsetInElement, int DataSize, UObject* Owner)
+{
+	const FScriptArray* Array = static_cast<const FScriptArray*>(ArrayHeader);
+	if (!Array || ElementIndex < 0 || ElementIndex >= Array->Num())
+	{
+		return -1;
+	}
+	void* Address = static_cast<uint8*>(const_cast<void*>(Array->GetData())) + ElementIndex * ElementSize + OffsetInElement;
+	DebugRegisterIndex Index = SetDataBreakpoint(Address, DataSize, Owner);
+	if (Index < 0)
+	{
+		return -1;
+	}
+	//The data pointer is the one that has to be followed, ArrayNum is only watched if there's still a slot available
+	DebugRegisterIndex DataIndex = SetDataBreakpoint(ArrayHeader, sizeof(void*), Owner);
+	if (DataIndex < 0)
+	{
+		FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Index);
+		return -1;
+	}
+	DebugRegisterIndex NumIndex = SetDataBreakpoint(static_cast<uint8*>(ArrayHeader) + sizeof(void*), sizeof(int32), Owner);
+
+	FDataBreakpointInfo& ElementInfo = DataBreakpointInfo[Index];
+	ElementInfo.Group = Index;
+	ElementInfo.ArrayHeader = ArrayHeader;
+	ElementInfo.ElementIndex = ElementIndex;
+	ElementInfo.ElementSize = ElementSize;
+	ElementInfo.OffsetInElement = OffsetInElement;
+
+	DataBreakpointInfo[DataIndex].Role = EDataBreakpointRole::ContainerData;
+	DataBreakpointInfo[DataIndex].Group = Index;
+	if (NumIndex >= 0)
+	{
+		DataBreakpointInfo[NumIndex].Role = EDataBreakpointRole::ContainerNum;
+		DataBreakpointInfo[NumIndex].Group = Index;
 	}
 	return Index;
 }
 
 
-FGenericPlatformHardwareBreakpoints::FDataBreakpointInfo FGenericPlatformHardwareBreakpoints::DataBreakpointInfo[MAX_HARDWARE_BREAKPOINTS];
\ No newline at end of file
+TStaticArray<FGenericPlatformHardwareBreakpoints::FDataBreakpointInfo, FPlatformHardwareBreakpointTraits::NumSlots> FGenericPlatformHardwareBreakpoints::DataBreakpointInfo;
\ No newline at end of file
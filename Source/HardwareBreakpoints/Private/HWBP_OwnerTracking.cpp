@@ -0,0 +1,95 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_OwnerTracking.h"
+
+#include <atomic>
+
+#include "Async/Async.h"
+#include "UObject/Object.h"
+#include "UObject/UObjectArray.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "CallStackViewer.h"
+#include "HardwareBreakpointsLog.h"
+
+namespace HWBP_OwnerTracking
+{
+	//UObject array index + 1 of each slot's owner, 0 if the slot has none. Checked on every object deletion, so it's kept tiny
+	static std::atomic<int32> OwnerIndices[FPlatformHardwareBreakpointTraits::NumSlots] = {};
+	static std::atomic<bool> bRegistered{ false };
+
+	static void ReclaimSlots()
+	{
+		DebugRegisterIndex Removed[FPlatformHardwareBreakpointTraits::NumSlots];
+		const int32 NumRemoved = FPlatformHardwareBreakpoints::RemoveBreakpointsWithDestroyedOwners(Removed);
+		for (int32 i = 0; i < NumRemoved; ++i)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("Removed breakpoint on slot %d, its owner was destroyed"), Removed[i]);
+			//Same notification as removing it from the callstack window, it invalidates the handles to this slot
+			CallStackViewer::OnRemoveBreakpoint.Broadcast(Removed[i]);
+		}
+	}
+
+	class FOwnerDeleteListener : public FUObjectArray::FUObjectDeleteListener
+	{
+	public:
+		virtual void NotifyUObjectDeleted(const UObjectBase* Object, int32 Index) override
+		{
+			bool bAnyOwned = false;
+			for (std::atomic<int32>& OwnerIndex : OwnerIndices)
+			{
+				int32 Expected = Index + 1;
+				bAnyOwned |= OwnerIndex.compare_exchange_strong(Expected, 0, std::memory_order_relaxed);
+			}
+			if (!bAnyOwned)
+			{
+				return;
+			}
+			if (IsInGameThread())
+			{
+				ReclaimSlots();
+			}
+			else
+			{
+				AsyncTask(ENamedThreads::GameThread, &ReclaimSlots);
+			}
+		}
+
+		virtual void OnUObjectArrayShutdown() override
+		{
+			GUObjectArray.RemoveUObjectDeleteListener(this);
+			bRegistered = false;
+		}
+	};
+
+	static FOwnerDeleteListener DeleteListener;
+
+	void Track(int32 BreakpointIndex, const UObject* Owner)
+	{
+		if (BreakpointIndex < 0 || BreakpointIndex >= FPlatformHardwareBreakpointTraits::NumSlots)
+		{
+			return;
+		}
+		if (!bRegistered.exchange(true))
+		{
+			GUObjectArray.AddUObjectDeleteListener(&DeleteListener);
+		}
+		OwnerIndices[BreakpointIndex] = GUObjectArray.ObjectToIndex(Owner) + 1;
+	}
+
+	void Untrack(int32 BreakpointIndex)
+	{
+		if (BreakpointIndex >= 0 && BreakpointIndex < FPlatformHardwareBreakpointTraits::NumSlots)
+		{
+			OwnerIndices[BreakpointIndex].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void Shutdown()
+	{
+		if (bRegistered.exchange(false))
+		{
+			GUObjectArray.RemoveUObjectDeleteListener(&DeleteListener);
+		}
+	}
+}
@@ -0,0 +1,16 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Frees the slots of watches whose owner UObject is destroyed, as soon as it's destroyed, instead of waiting for a hit on the freed
+//memory to notice. Handles to those watches are invalidated
+//Uses a UObject delete listener, registered when the first watch with an owner is set. Objects destroyed on other threads
+//have their watches removed on the next game thread tick, since breakpoints are usually armed on the game thread
+namespace HWBP_OwnerTracking
+{
+	void Track(int32 BreakpointIndex, const UObject* Owner);
+	void Untrack(int32 BreakpointIndex);
+	void Shutdown();
+}
@@ -0,0 +1,127 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_ScriptBreakpoints.h"
+
+#include "UObject/Class.h"
+#include "UObject/Script.h"
+#include "UObject/Stack.h"
+#include "UObject/UObjectArray.h"
+
+#include "HardwareBreakpointsLog.h"
+#include "Profiling/HWBP_NodeHeatmap.h"
+#if PLATFORM_WINDOWS
+#include "Windows/WindowsPlatformHardwareBreakpointsUser.h"
+#endif
+
+namespace HWBP_ScriptBreakpoints
+{
+	//One bit per object index, read by the VM on every script function call
+	static TBitArray<> WatchedBits;
+	//Object indices are reused after GC, so a set bit is confirmed against the function it was set for
+	static TMap<int32, FWeakObjectPtr> WatchedFunctions;
+#if DO_BLUEPRINT_GUARD
+	static FDelegateHandle EnterScriptContextHandle;
+#endif
+
+	static void OnWatchedFunctionEntered(const UObject* ContextObject, const UFunction* Function)
+	{
+		//The callee's frame isn't pushed yet, so this attributes the call to the calling node
+		HWBP_NodeHeatmap::RecordHit(Function->GetFName(), Function);
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("_\n============= BLUEPRINT FUNCTION BREAKPOINT ===========\n%s called on %s\nScript stack:\n%s"),
+			*Function->GetPathName(), *GetNameSafe(ContextObject), *FFrame::GetScriptCallstack());
+		GLog->Flush();
+#if PLATFORM_WINDOWS
+		WindowsPlatformHardwareBreakpoints::CaughtBlueprintFunctionBreakpoint();
+#endif
+	}
+
+#if DO_BLUEPRINT_GUARD
+	static void OnEnterScriptContext(const FBlueprintContextTracker& Tracker, const UObject* ContextObject, const UFunction* Function)
+	{
+		//Script also runs on worker threads (e.g. thread safe anim graphs), while Add can reallocate WatchedBits on the game thread
+		if (!IsInGameThread())
+		{
+			return;
+		}
+		const int32 Index = GUObjectArray.ObjectToIndex(Function);
+		if (Index < WatchedBits.Num() && WatchedBits[Index])
+		{
+			const FWeakObjectPtr* Watched = WatchedFunctions.Find(Index);
+			if (Watched && Watched->Get() == Function)
+			{
+				OnWatchedFunctionEntered(ContextObject, Function);
+			}
+		}
+	}
+#endif
+
+	bool Add(const UFunction* Function)
+	{
+#if DO_BLUEPRINT_GUARD
+		if (Function == nullptr || Function->HasAnyFunctionFlags(FUNC_Native))
+		{
+			return false;
+		}
+		const int32 Index = GUObjectArray.ObjectToIndex(Function);
+		if (Index >= WatchedBits.Num())
+		{
+			WatchedBits.Add(false, Index + 1 - WatchedBits.Num());
+		}
+		WatchedBits[Index] = true;
+		WatchedFunctions.Add(Index, FWeakObjectPtr(Function));
+		if (!EnterScriptContextHandle.IsValid())
+		{
+			EnterScriptContextHandle = FBlueprintContextTracker::OnEnterScriptContext.AddStatic(&OnEnterScriptContext);
+		}
+		return true;
+#else
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Script function breakpoints need DO_BLUEPRINT_GUARD"));
+		return false;
+#endif
+	}
+
+	bool Remove(const UFunction* Function)
+	{
+		if (Function == nullptr)
+		{
+			return false;
+		}
+		const int32 Index = GUObjectArray.ObjectToIndex(Function);
+		if (WatchedFunctions.Remove(Index) == 0)
+		{
+			return false;
+		}
+		WatchedBits[Index] = false;
+		if (WatchedFunctions.Num() == 0)
+		{
+			RemoveAll();
+		}
+		return true;
+	}
+
+	void RemoveAll()
+	{
+		WatchedBits.Empty();
+		WatchedFunctions.Empty();
+#if DO_BLUEPRINT_GUARD
+		//Unhooked when nothing is watched, so the VM doesn't pay for the broadcast either
+		FBlueprintContextTracker::OnEnterScriptContext.Remove(EnterScriptContextHandle);
+		EnterScriptContextHandle.Reset();
+#endif
+	}
+
+	bool IsWatched(const UFunction* Function)
+	{
+		if (Function == nullptr)
+		{
+			return false;
+		}
+		const FWeakObjectPtr* Watched = WatchedFunctions.Find(GUObjectArray.ObjectToIndex(Function));
+		return Watched && Watched->Get() == Function;
+	}
+
+	int32 Num()
+	{
+		return WatchedFunctions.Num();
+	}
+}
@@ -0,0 +1,21 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UFunction;
+
+//Blueprint function breakpoints implemented in the script VM instead of with debug registers
+//The VM reports every script function it enters, and watched functions are looked up in a bitset indexed by object index,
+//so there's no limit on how many functions can be watched, unwatched calls cost a bit test, and no hardware slot is used
+//Requires DO_BLUEPRINT_GUARD (on in every build but Shipping)
+//Only calls on the game thread are caught, script run on worker threads (e.g. thread safe anim graphs) isn't checked
+namespace HWBP_ScriptBreakpoints
+{
+	bool Add(const UFunction* Function);
+	bool Remove(const UFunction* Function);
+	void RemoveAll();
+	bool IsWatched(const UFunction* Function);
+	int32 Num();
+}
@@ -0,0 +1,399 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_SourceLines.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "HWBP_SymbolPreloader.h"
+#include "Misc/HWBP_Ticker.h"
+
+namespace HWBP_SourceLines
+{
+	struct FWatchedAddress
+	{
+		int32 LineIndex = INDEX_NONE;
+		uint64 Address = 0;
+		DebugRegisterIndex Slot = -1;
+		//Probes only, from windows that were already harvested
+		uint64 Hits = 0;
+		uint64 WatchedFrames = 0;
+		//Its breakpoint was removed from somewhere else (e.g. the callstack window), it isn't armed again
+		bool bRemoved = false;
+	};
+
+	struct FWatchedLine
+	{
+		FString Location;
+		bool bCountOnly = false;
+	};
+
+	//Line tables don't change while a module is loaded. Cached addresses are checked against the module they were found in before reuse
+	struct FCachedLocation
+	{
+		TArray<FLineAddress> Addresses;
+		TArray<uint64> ModuleBases;
+	};
+
+	static TMap<FString, FCachedLocation> LocationCache;
+	static TArray<FWatchedLine> Lines;
+	static TArray<FWatchedAddress> Watches;
+	static int32 NextWatch = 0;
+	static int32 FramesPerWindow = 1;
+	static int32 FramesInWindow = 0;
+	static FHWBP_TickerHandle TickerHandle;
+
+	static bool ParseLocation(const FString& Location, FString& OutModuleFilter, FString& OutFile, int32& OutLine)
+	{
+		int32 LineSeparator;
+		if (!Location.FindLastChar(TEXT(':'), LineSeparator) || !LexTryParseString(OutLine, *Location.Mid(LineSeparator + 1)) || OutLine <= 0)
+		{
+			return false;
+		}
+		OutFile = Location.Left(LineSeparator);
+		OutModuleFilter.Reset();
+		int32 ModuleSeparator;
+		if (OutFile.FindChar(TEXT('!'), ModuleSeparator))
+		{
+			OutModuleFilter = OutFile.Left(ModuleSeparator);
+			OutFile = OutFile.Mid(ModuleSeparator + 1);
+		}
+		return !OutFile.IsEmpty();
+	}
+
+	static bool IsCacheValid(const FCachedLocation& Cached)
+	{
+		for (int32 i = 0; i < Cached.Addresses.Num(); ++i)
+		{
+			FHardwareBreakpointModuleBuildId BuildId;
+			if (!FPlatformHardwareBreakpoints::GetModuleBuildId(Cached.Addresses[i].Address, BuildId) || BuildId.Base != Cached.ModuleBases[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool FindAddresses(const FString& Location, TArray<FLineAddress>& OutAddresses)
+	{
+		FString ModuleFilter;
+		FString File;
+		int32 Line = 0;
+		if (!ParseLocation(Location, ModuleFilter, File, Line))
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("Invalid source location %s, expected [Module!]File:Line"), *Location);
+			return false;
+		}
+		if (const FCachedLocation* Cached = LocationCache.Find(Location))
+		{
+			if (IsCacheValid(*Cached))
+			{
+				OutAddresses = Cached->Addresses;
+				return OutAddresses.Num() > 0;
+			}
+			LocationCache.Remove(Location);
+		}
+		if (HWBP_SymbolPreloader::IsLoading())
+		{
+			//DbgHelp isn't thread safe
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Symbols are being loaded in the background, try again once HWBP.Symbols.Status reports they're loaded"));
+			return false;
+		}
+
+		FPlatformStackWalk::InitStackWalking();
+		TArray<FStackWalkModuleInfo> Modules;
+		Modules.SetNum(FPlatformStackWalk::GetProcessModuleCount());
+		Modules.SetNum(FPlatformStackWalk::GetProcessModuleSignatures(Modules.GetData(), Modules.Num()));
+
+		FCachedLocation NewEntry;
+		TSet<uint64> SeenAddresses;
+		const FTCHARToANSI AnsiFile(*File);
+		for (const FStackWalkModuleInfo& Module : Modules)
+		{
+			if (!ModuleFilter.IsEmpty() && !FString(Module.ModuleName).MatchesWildcard(ModuleFilter))
+			{
+				continue;
+			}
+			FPlatformHardwareBreakpoints::EnumerateSourceLineAddresses(Module.BaseOfImage, AnsiFile.Get(), Line, [&](uint64 Address, const ANSICHAR* FilePath)
+			{
+				bool bAlreadySeen = false;
+				SeenAddresses.Add(Address, &bAlreadySeen);
+				if (!bAlreadySeen)
+				{
+					NewEntry.Addresses.Add({ Module.ModuleName, ANSI_TO_TCHAR(FilePath), Address });
+					NewEntry.ModuleBases.Add(Module.BaseOfImage);
+				}
+			});
+		}
+		OutAddresses = NewEntry.Addresses;
+		LocationCache.Add(Location, MoveTemp(NewEntry));
+		if (OutAddresses.Num() == 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("No code found for %s. The line might have been optimized out, or have no code of its own (try a nearby line)"), *Location);
+			return false;
+		}
+		return true;
+	}
+
+	//A slot number alone doesn't say the watch is still in it: after it was removed from somewhere else (callstack window,
+	//ClearAllHardwareBreakpoints) the slot can be handed to another breakpoint. Breakpoints set directly don't record an address
+	static bool IsOwnWatch(const FWatchedAddress& Watch)
+	{
+		const void* SlotAddress = FPlatformHardwareBreakpoints::GetBreakpointAddress(Watch.Slot);
+		return FPlatformHardwareBreakpoints::GetBreakpointLabel(Watch.Slot) == FName(*Lines[Watch.LineIndex].Location)
+			&& (SlotAddress == nullptr || SlotAddress == (const void*)Watch.Address);
+	}
+
+	static void HarvestProbe(FWatchedAddress& Watch)
+	{
+		FHardwareBreakpointHitCounters Counters;
+		if (Lines[Watch.LineIndex].bCountOnly && FPlatformHardwareBreakpoints::GetHitCounters(Watch.Slot, Counters, true))
+		{
+			Watch.Hits += Counters.TotalHits;
+		}
+	}
+
+	static bool ArmWatch(FWatchedAddress& Watch)
+	{
+		const FWatchedLine& Line = Lines[Watch.LineIndex];
+		Watch.Slot = Line.bCountOnly
+			? FPlatformHardwareBreakpoints::SetCountingExecuteBreakpoint((void*)Watch.Address)
+			: FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Execute, EHardwareBreakpointSize::Size_1, (void*)Watch.Address);
+		if (Watch.Slot < 0)
+		{
+			return false;
+		}
+		FPlatformHardwareBreakpoints::SetBreakpointLabel(Watch.Slot, FName(*Line.Location));
+		return true;
+	}
+
+	//Arms unwatched addresses on the free slots, starting at NextWatch
+	static void ArmFreeSlots()
+	{
+		for (int32 Count = 0; Count < Watches.Num(); ++Count)
+		{
+			FWatchedAddress& Watch = Watches[NextWatch];
+			if (Watch.Slot < 0 && !Watch.bRemoved && !ArmWatch(Watch))
+			{
+				break;
+			}
+			NextWatch = (NextWatch + 1) % Watches.Num();
+		}
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		bool bAnyWaiting = false;
+		for (FWatchedAddress& Watch : Watches)
+		{
+			Watch.WatchedFrames += Watch.Slot >= 0 ? 1 : 0;
+			bAnyWaiting |= Watch.Slot < 0 && !Watch.bRemoved;
+		}
+		//Only addresses that don't fit in the free slots take turns, everything else stays armed
+		if (++FramesInWindow >= FramesPerWindow && bAnyWaiting)
+		{
+			FramesInWindow = 0;
+			for (FWatchedAddress& Watch : Watches)
+			{
+				if (Watch.Slot < 0)
+				{
+					continue;
+				}
+				if (IsOwnWatch(Watch))
+				{
+					HarvestProbe(Watch);
+					FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Watch.Slot);
+				}
+				else
+				{
+					Watch.bRemoved = true;
+				}
+				Watch.Slot = -1;
+			}
+			ArmFreeSlots();
+		}
+		return true;
+	}
+
+	bool Start(const FString& Location, bool bCountOnly, int32 InFramesPerWindow)
+	{
+		TArray<FLineAddress> Addresses;
+		if (!FindAddresses(Location, Addresses))
+		{
+			return false;
+		}
+		if (!IsRunning())
+		{
+			//Results of the last session are kept until the next one starts, so they can still be reported
+			Lines.Reset();
+			Watches.Reset();
+			NextWatch = 0;
+		}
+		const int32 LineIndex = Lines.Add({ Location, bCountOnly });
+		for (const FLineAddress& LineAddress : Addresses)
+		{
+			FWatchedAddress& Watch = Watches[Watches.AddDefaulted()];
+			Watch.LineIndex = LineIndex;
+			Watch.Address = LineAddress.Address;
+		}
+		FramesPerWindow = FMath::Max(1, InFramesPerWindow);
+		ArmFreeSlots();
+
+		int32 NumArmed = 0;
+		for (const FWatchedAddress& Watch : Watches)
+		{
+			NumArmed += Watch.Slot >= 0 ? 1 : 0;
+		}
+		if (NumArmed == 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("No free breakpoint slots, %s will be watched when one is freed"), *Location);
+		}
+		else if (NumArmed < Watches.Num())
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%d watched addresses share %d slots, they take turns every %d frames"), Watches.Num(), NumArmed, FramesPerWindow);
+		}
+		if (!TickerHandle.IsValid())
+		{
+			TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+		}
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Watching %s (%d addresses) with %s"), *Location, Addresses.Num(), bCountOnly ? TEXT("probes") : TEXT("breakpoints"));
+		return true;
+	}
+
+	void Stop()
+	{
+		if (TickerHandle.IsValid())
+		{
+			FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+		}
+		for (FWatchedAddress& Watch : Watches)
+		{
+			if (Watch.Slot >= 0 && IsOwnWatch(Watch))
+			{
+				HarvestProbe(Watch);
+				FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Watch.Slot);
+			}
+			Watch.Slot = -1;
+		}
+	}
+
+	bool IsRunning()
+	{
+		return TickerHandle.IsValid();
+	}
+
+	void DumpReport(bool bReset)
+	{
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= SOURCE LINE PROBES ============="));
+		for (int32 LineIndex = 0; LineIndex < Lines.Num(); ++LineIndex)
+		{
+			if (!Lines[LineIndex].bCountOnly)
+			{
+				continue;
+			}
+			uint64 LineFrames = 0;
+			double EstimatedHits = 0.0;
+			TArray<FString> AddressLines;
+			for (FWatchedAddress& Watch : Watches)
+			{
+				if (Watch.LineIndex != LineIndex)
+				{
+					continue;
+				}
+				uint64 Hits = Watch.Hits;
+				FHardwareBreakpointHitCounters Counters;
+				if (Watch.Slot >= 0 && IsOwnWatch(Watch) && FPlatformHardwareBreakpoints::GetHitCounters(Watch.Slot, Counters, bReset))
+				{
+					Hits += Counters.TotalHits;
+				}
+				const double HitsPerFrame = Watch.WatchedFrames > 0 ? (double)Hits / Watch.WatchedFrames : 0.0;
+				EstimatedHits += HitsPerFrame;
+				LineFrames = FMath::Max(LineFrames, Watch.WatchedFrames);
+				AddressLines.Add(FString::Printf(TEXT("    0x%016llx: %llu hits in %llu watched frames (%.2f/frame)"), Watch.Address, Hits, Watch.WatchedFrames, HitsPerFrame));
+				if (bReset)
+				{
+					Watch.Hits = 0;
+					Watch.WatchedFrames = 0;
+				}
+			}
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s: %.2f hits/frame"), *Lines[LineIndex].Location, EstimatedHits);
+			for (const FString& AddressLine : AddressLines)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s"), *AddressLine);
+			}
+		}
+	}
+
+	static FAutoConsoleCommand FindCommand(
+		TEXT("HWBP.Line.Find"),
+		TEXT("Lists the code addresses of a source line. Usage: HWBP.Line.Find [Module!]File:Line"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			TArray<FLineAddress> Addresses;
+			if (Args.Num() < 1 || !FindAddresses(Args[0], Addresses))
+			{
+				return;
+			}
+			for (const FLineAddress& LineAddress : Addresses)
+			{
+				UE_LOG(LogHardwareBreakpoints, Display, TEXT("0x%016llx %s %s"), LineAddress.Address, *LineAddress.Module, *LineAddress.File);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand BreakCommand(
+		TEXT("HWBP.Line.Break"),
+		TEXT("Sets breakpoints on every address of a source line. Usage: HWBP.Line.Break [Module!]File:Line [FramesPerWindow]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			int32 Frames = 1;
+			if (Args.Num() > 1)
+			{
+				LexFromString(Frames, *Args[1]);
+			}
+			if (Args.Num() > 0)
+			{
+				Start(Args[0], false, Frames);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand ProbeCommand(
+		TEXT("HWBP.Line.Probe"),
+		TEXT("Counts executions of a source line without stopping. Usage: HWBP.Line.Probe [Module!]File:Line [FramesPerWindow]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			int32 Frames = 1;
+			if (Args.Num() > 1)
+			{
+				LexFromString(Frames, *Args[1]);
+			}
+			if (Args.Num() > 0)
+			{
+				Start(Args[0], true, Frames);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.Line.Stop"),
+		TEXT("Removes all source line breakpoints and probes, and prints the probe report"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+			DumpReport();
+		})
+	);
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.Line.Report"),
+		TEXT("Logs source line probe hits. Pass 'reset' to clear them afterwards"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			DumpReport(Args.Num() > 0 && Args[0] == TEXT("reset"));
+		})
+	);
+}
@@ -0,0 +1,32 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Breakpoints and count-only probes on source lines ("[Module!]File.cpp:123") of a running build, without recompiling
+//Lines are mapped to code addresses through the module's line tables, including every inlined copy of the line, and the results are cached per location
+//A line often compiles to more addresses than there are debug registers. Those take turns on the free slots, a few frames each,
+//and the report scales each address' hits by the share of frames it was watched
+//Like other execute breakpoints set from the game thread, only code running on the game thread is caught
+//Console: HWBP.Line.Find, HWBP.Line.Break, HWBP.Line.Probe <[Module!]File:Line> [FramesPerWindow], HWBP.Line.Stop, HWBP.Line.Report [reset]
+namespace HWBP_SourceLines
+{
+	struct FLineAddress
+	{
+		FString Module;
+		FString File;
+		uint64 Address = 0;
+	};
+
+	//Prefixing the location with the module avoids loading the line tables of every other module
+	bool FindAddresses(const FString& Location, TArray<FLineAddress>& OutAddresses);
+
+	//Watches every address of the line, with breakpoints, or with count-only probes if bCountOnly. Watches add up until Stop
+	bool Start(const FString& Location, bool bCountOnly, int32 FramesPerWindow = 1);
+	void Stop();
+	bool IsRunning();
+
+	//Logs probe hits per line and per address
+	void DumpReport(bool bReset = false);
+}
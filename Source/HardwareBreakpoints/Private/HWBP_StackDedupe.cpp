@@ -0,0 +1,166 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_StackDedupe.h"
+
+#include "CoreGlobals.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "HWBP_SymbolCache.h"
+#include "HWBP_SymbolPreloader.h"
+#include "Misc/HWBP_LockFreeTable.h"
+#include "Settings/HWBP_Settings.h"
+
+namespace HWBP_StackDedupe
+{
+	static const uint32 NumEntries = 4096;
+	//Bounds the work done in the handler. A call site that doesn't find a place within this many entries isn't deduplicated
+	static const uint32 MaxProbes = 16;
+
+	//Keyed by a hash of the call site and the generation of its slot
+	struct FEntry : FHWBP_LockFreeTableEntry
+	{
+		std::atomic<uint64> Window{ 0 };
+		std::atomic<uint32> Captured{ 0 };
+		std::atomic<uint32> Collapsed{ 0 };
+		std::atomic<uint32> CollapsedSinceCapture{ 0 };
+		//Only for the report, written by the thread that claimed the entry
+		uint64 ProgramCounter = 0;
+		uint64 ReturnAddress = 0;
+		int32 BreakpointIndex = -1;
+		uint32 Generation = 0;
+	};
+
+	static THWBP_LockFreeTable<FEntry, NumEntries, MaxProbes> Table;
+	static std::atomic<uint32> SlotGenerations[FPlatformHardwareBreakpointTraits::NumSlots];
+
+	static uint64 HashCallSite(int32 BreakpointIndex, uint64 ProgramCounter, uint64 ReturnAddress, uint32 Generation)
+	{
+		uint64 Hash = ProgramCounter * 0x9E3779B97F4A7C15ull;
+		Hash ^= (ReturnAddress + 0x632BE59BD9B4E019ull + (Hash << 6) + (Hash >> 2)) * 0xBF58476D1CE4E5B9ull;
+		Hash ^= ((uint64)Generation << 8 | (uint64)(uint8)BreakpointIndex) * 0x94D049BB133111EBull;
+		Hash ^= Hash >> 31;
+		return Hash | 1;
+	}
+
+	bool ShouldCaptureStack(int32 BreakpointIndex, uint64 ProgramCounter, uint64 ReturnAddress, uint32& OutCollapsedHits)
+	{
+		OutCollapsedHits = 0;
+		const int32 WindowFrames = GetDefault<UHWBP_Settings>()->StackDedupeFrames;
+		if (WindowFrames <= 0 || BreakpointIndex < 0 || BreakpointIndex >= FPlatformHardwareBreakpointTraits::NumSlots)
+		{
+			return true;
+		}
+		//+1 so that no window matches the 0 of an entry that was just claimed
+		const uint64 Window = GFrameCounter / WindowFrames + 1;
+		const uint32 Generation = SlotGenerations[BreakpointIndex].load(std::memory_order_relaxed);
+		const uint64 Key = HashCallSite(BreakpointIndex, ProgramCounter, ReturnAddress, Generation);
+
+		bool bClaimed = false;
+		FEntry* Entry = Table.FindOrClaim(Key, bClaimed);
+		if (Entry == nullptr)
+		{
+			return true;
+		}
+		if (bClaimed)
+		{
+			Entry->ProgramCounter = ProgramCounter;
+			Entry->ReturnAddress = ReturnAddress;
+			Entry->BreakpointIndex = BreakpointIndex;
+			Entry->Generation = Generation;
+			Entry->Publish();
+			Entry->Window.store(Window, std::memory_order_release);
+			Entry->Captured.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		uint64 SeenWindow = Entry->Window.load(std::memory_order_acquire);
+		if (SeenWindow != Window && Entry->Window.compare_exchange_strong(SeenWindow, Window, std::memory_order_acq_rel))
+		{
+			Entry->Captured.fetch_add(1, std::memory_order_relaxed);
+			OutCollapsedHits = Entry->CollapsedSinceCapture.exchange(0, std::memory_order_relaxed);
+			return true;
+		}
+		//Either captured already in this window, or another thread is opening the window and capturing it right now
+		Entry->Collapsed.fetch_add(1, std::memory_order_relaxed);
+		Entry->CollapsedSinceCapture.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	void ResetSlot(int32 BreakpointIndex)
+	{
+		if (BreakpointIndex >= 0 && BreakpointIndex < FPlatformHardwareBreakpointTraits::NumSlots)
+		{
+			SlotGenerations[BreakpointIndex].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void Reset()
+	{
+		Table.Reset([](FEntry& Entry)
+		{
+			Entry.Window.store(0, std::memory_order_relaxed);
+			Entry.Captured.store(0, std::memory_order_relaxed);
+			Entry.Collapsed.store(0, std::memory_order_relaxed);
+			Entry.CollapsedSinceCapture.store(0, std::memory_order_relaxed);
+		});
+		for (std::atomic<uint32>& Generation : SlotGenerations)
+		{
+			Generation.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void DumpReport(int32 MaxCallSites)
+	{
+		if (HWBP_SymbolPreloader::IsLoading())
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Symbols are still loading in the background, try again once they're loaded"));
+			return;
+		}
+		TArray<const FEntry*> Sorted;
+		uint64 TotalCollapsed = 0;
+		Table.ForEachReady([&Sorted, &TotalCollapsed](const FEntry& Entry)
+		{
+			if (Entry.Collapsed.load(std::memory_order_relaxed) == 0 || Entry.BreakpointIndex < 0 || Entry.BreakpointIndex >= FPlatformHardwareBreakpointTraits::NumSlots)
+			{
+				return;
+			}
+			if (Entry.Generation == SlotGenerations[Entry.BreakpointIndex].load(std::memory_order_relaxed))
+			{
+				Sorted.Add(&Entry);
+				TotalCollapsed += Entry.Collapsed.load(std::memory_order_relaxed);
+			}
+		});
+		Sorted.Sort([](const FEntry& A, const FEntry& B) { return A.Collapsed.load() > B.Collapsed.load(); });
+
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= COLLAPSED CALL SITES (%llu hits in %d call sites) ============="), TotalCollapsed, Sorted.Num());
+		for (int32 i = 0; i < Sorted.Num() && i < MaxCallSites; ++i)
+		{
+			const FEntry& Entry = *Sorted[i];
+			FProgramCounterSymbolInfo Site, Caller;
+			HWBP_SymbolCache::ProgramCounterToSymbolInfo(Entry.ProgramCounter, Site);
+			HWBP_SymbolCache::ProgramCounterToSymbolInfo(Entry.ReturnAddress, Caller);
+			const FName Label = FPlatformHardwareBreakpoints::GetBreakpointLabel(Entry.BreakpointIndex);
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("Slot %d%s%s: %u hits collapsed, %u stacks captured. %s (%s:%d), called from %s (%s:%d)"),
+				Entry.BreakpointIndex, Label.IsNone() ? TEXT("") : TEXT(" "), Label.IsNone() ? TEXT("") : *Label.ToString(),
+				Entry.Collapsed.load(), Entry.Captured.load(),
+				ANSI_TO_TCHAR(Site.FunctionName), ANSI_TO_TCHAR(Site.Filename), Site.LineNumber,
+				ANSI_TO_TCHAR(Caller.FunctionName), ANSI_TO_TCHAR(Caller.Filename), Caller.LineNumber);
+		}
+	}
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.Stacks.Report"),
+		TEXT("Lists the call sites whose repeated hits skipped stack capture. Usage: HWBP.Stacks.Report [MaxCallSites]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			int32 MaxCallSites = 20;
+			if (Args.Num() > 0)
+			{
+				LexFromString(MaxCallSites, *Args[0]);
+			}
+			DumpReport(MaxCallSites);
+		})
+	);
+}
@@ -0,0 +1,26 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Collapses repeated callstacks of non-modal hits. A call site is a (breakpoint slot, program counter, return address) triple,
+//and its stack is only walked and symbolized for the first hit in each window of UHWBP_Settings::StackDedupeFrames frames.
+//Later hits from the same call site in that window only bump a counter, which is reported with the next stack that is logged,
+//and by HWBP.Stacks.Report
+//The table is fixed size and lock free, so it can be used from the exception handler. When it fills up, hits from call sites
+//that don't fit are captured as usual
+namespace HWBP_StackDedupe
+{
+	//Called from the exception handler. Returns false if this call site's stack was already captured in the current window.
+	//When it returns true, OutCollapsedHits is the number of hits from this call site that were skipped since its last capture
+	bool ShouldCaptureStack(int32 BreakpointIndex, uint64 ProgramCounter, uint64 ReturnAddress, uint32& OutCollapsedHits);
+
+	//Call sites of a slot stop counting once the slot is reused by another breakpoint
+	void ResetSlot(int32 BreakpointIndex);
+	//Only safe when no breakpoint is armed
+	void Reset();
+
+	//Logs call sites with collapsed hits, most collapsed first
+	void DumpReport(int32 MaxCallSites = 20);
+}
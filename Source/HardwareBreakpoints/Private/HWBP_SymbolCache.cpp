@@ -0,0 +1,312 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_SymbolCache.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "Profiling/HWBP_MappedFileWriter.h"
+#include "Misc/HWBP_Ticker.h"
+
+namespace HWBP_SymbolCache
+{
+	static constexpr uint32 Magic = 'CSWH';
+	static constexpr uint32 Version = 1;
+	static const float FlushIntervalSeconds = 5.0f;
+
+	//File layout: FFileHeader, NumEntries x FFileEntry sorted by Offset, then the string table (null terminated UTF8)
+	struct FFileHeader
+	{
+		uint32 Magic = HWBP_SymbolCache::Magic;
+		uint32 Version = HWBP_SymbolCache::Version;
+		uint32 NumEntries = 0;
+		uint32 StringTableSize = 0;
+	};
+
+	struct FFileEntry
+	{
+		uint32 Offset;
+		//Offsets into the string table
+		uint32 Function;
+		uint32 File;
+		int32 Line;
+		int32 Displacement;
+	};
+
+	struct FNewEntry
+	{
+		FString Function;
+		FString File;
+		int32 Line = 0;
+		int32 Displacement = 0;
+	};
+
+	struct FModuleCache
+	{
+		FHardwareBreakpointModuleBuildId BuildId;
+		FString Filename;
+		FHWBP_MappedFileReader Reader;
+		const FFileEntry* Entries = nullptr;
+		const ANSICHAR* Strings = nullptr;
+		uint32 NumEntries = 0;
+		TMap<uint32, FNewEntry> NewEntries;
+
+		void Map()
+		{
+			Entries = nullptr;
+			Strings = nullptr;
+			NumEntries = 0;
+			if (!Reader.Open(Filename))
+			{
+				return;
+			}
+			const FFileHeader* Header = (const FFileHeader*)Reader.GetData();
+			if (Reader.GetSize() < (int64)sizeof(FFileHeader) || Header->Magic != Magic || Header->Version != Version
+				|| Reader.GetSize() != (int64)(sizeof(FFileHeader) + Header->NumEntries * sizeof(FFileEntry) + Header->StringTableSize))
+			{
+				UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Ignoring invalid symbol cache %s"), *Filename);
+				Reader.Close();
+				return;
+			}
+			Entries = (const FFileEntry*)(Header + 1);
+			NumEntries = Header->NumEntries;
+			Strings = (const ANSICHAR*)(Entries + NumEntries);
+		}
+
+		const FFileEntry* FindMapped(uint32 Offset) const
+		{
+			int32 Low = 0;
+			int32 High = (int32)NumEntries - 1;
+			while (Low <= High)
+			{
+				const int32 Middle = Low + (High - Low) / 2;
+				if (Entries[Middle].Offset == Offset)
+				{
+					return &Entries[Middle];
+				}
+				if (Entries[Middle].Offset < Offset)
+				{
+					Low = Middle + 1;
+				}
+				else
+				{
+					High = Middle - 1;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	static FCriticalSection Lock;
+	static TArray<TUniquePtr<FModuleCache>> Modules;
+	static uint64 NumHits = 0;
+	static uint64 NumMisses = 0;
+	static FHWBP_TickerHandle FlushTickerHandle;
+
+	static FString GetCacheDir()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("HardwareBreakpoints") / TEXT("SymbolCache");
+	}
+
+	static FModuleCache* FindModule(uint64 ProgramCounter)
+	{
+		for (const TUniquePtr<FModuleCache>& Module : Modules)
+		{
+			if (ProgramCounter >= Module->BuildId.Base && ProgramCounter < Module->BuildId.Base + Module->BuildId.Size)
+			{
+				return Module.Get();
+			}
+		}
+		FHardwareBreakpointModuleBuildId BuildId;
+		if (!FPlatformHardwareBreakpoints::GetModuleBuildId(ProgramCounter, BuildId))
+		{
+			return nullptr;
+		}
+		FModuleCache* Module = Modules.Add_GetRef(MakeUnique<FModuleCache>()).Get();
+		Module->BuildId = BuildId;
+		Module->Filename = GetCacheDir() / FString::Printf(TEXT("%s-%s.hwsc"), *BuildId.Name, *BytesToHex(BuildId.Id, sizeof(BuildId.Id)));
+		Module->Map();
+		return Module;
+	}
+
+	static void FillSymbolInfo(const FModuleCache& Module, uint64 ProgramCounter, const ANSICHAR* Function, const ANSICHAR* File, int32 Line, int32 Displacement, FProgramCounterSymbolInfo& OutSymbolInfo)
+	{
+		FCStringAnsi::Strncpy(OutSymbolInfo.ModuleName, TCHAR_TO_ANSI(*Module.BuildId.Name), FProgramCounterSymbolInfo::MAX_NAME_LENGTH);
+		FCStringAnsi::Strncpy(OutSymbolInfo.FunctionName, Function, FProgramCounterSymbolInfo::MAX_NAME_LENGTH);
+		FCStringAnsi::Strncpy(OutSymbolInfo.Filename, File, FProgramCounterSymbolInfo::MAX_NAME_LENGTH);
+		OutSymbolInfo.LineNumber = Line;
+		OutSymbolInfo.SymbolDisplacement = Displacement;
+		OutSymbolInfo.OffsetInModule = ProgramCounter - Module.BuildId.Base;
+		OutSymbolInfo.ProgramCounter = ProgramCounter;
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		Flush();
+		return true;
+	}
+
+	void ProgramCounterToSymbolInfo(uint64 ProgramCounter, FProgramCounterSymbolInfo& OutSymbolInfo)
+	{
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (FModuleCache* Module = FindModule(ProgramCounter))
+			{
+				const uint32 Offset = (uint32)(ProgramCounter - Module->BuildId.Base);
+				if (const FFileEntry* Entry = Module->FindMapped(Offset))
+				{
+					++NumHits;
+					FillSymbolInfo(*Module, ProgramCounter, Module->Strings + Entry->Function, Module->Strings + Entry->File, Entry->Line, Entry->Displacement, OutSymbolInfo);
+					return;
+				}
+				if (const FNewEntry* Entry = Module->NewEntries.Find(Offset))
+				{
+					++NumHits;
+					FillSymbolInfo(*Module, ProgramCounter, TCHAR_TO_ANSI(*Entry->Function), TCHAR_TO_ANSI(*Entry->File), Entry->Line, Entry->Displacement, OutSymbolInfo);
+					return;
+				}
+			}
+		}
+
+		++NumMisses;
+		FPlatformStackWalk::ProgramCounterToSymbolInfo(ProgramCounter, OutSymbolInfo);
+		if (OutSymbolInfo.FunctionName[0] == 0)
+		{
+			//Unresolved lookups aren't cached, symbols might just not be loaded yet
+			return;
+		}
+		FScopeLock ScopeLock(&Lock);
+		if (FModuleCache* Module = FindModule(ProgramCounter))
+		{
+			FNewEntry& Entry = Module->NewEntries.Add((uint32)(ProgramCounter - Module->BuildId.Base));
+			Entry.Function = ANSI_TO_TCHAR(OutSymbolInfo.FunctionName);
+			Entry.File = ANSI_TO_TCHAR(OutSymbolInfo.Filename);
+			Entry.Line = OutSymbolInfo.LineNumber;
+			Entry.Displacement = OutSymbolInfo.SymbolDisplacement;
+			if (!FlushTickerHandle.IsValid())
+			{
+				FlushTickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick), FlushIntervalSeconds);
+			}
+		}
+	}
+
+	static void WriteModule(FModuleCache& Module)
+	{
+		struct FSortableEntry
+		{
+			uint32 Offset;
+			FString Function;
+			FString File;
+			int32 Line;
+			int32 Displacement;
+		};
+		TArray<FSortableEntry> AllEntries;
+		AllEntries.Reserve(Module.NumEntries + Module.NewEntries.Num());
+		for (uint32 i = 0; i < Module.NumEntries; ++i)
+		{
+			const FFileEntry& Entry = Module.Entries[i];
+			if (!Module.NewEntries.Contains(Entry.Offset))
+			{
+				AllEntries.Add({ Entry.Offset, UTF8_TO_TCHAR(Module.Strings + Entry.Function), UTF8_TO_TCHAR(Module.Strings + Entry.File), Entry.Line, Entry.Displacement });
+			}
+		}
+		for (const TPair<uint32, FNewEntry>& Entry : Module.NewEntries)
+		{
+			AllEntries.Add({ Entry.Key, Entry.Value.Function, Entry.Value.File, Entry.Value.Line, Entry.Value.Displacement });
+		}
+		AllEntries.Sort([](const FSortableEntry& A, const FSortableEntry& B) { return A.Offset < B.Offset; });
+
+		//Function and file names repeat a lot, each one is stored once
+		TArray<uint8> StringTable;
+		TMap<FString, uint32> StringOffsets;
+		auto AddString = [&StringTable, &StringOffsets](const FString& String) -> uint32
+		{
+			if (const uint32* Existing = StringOffsets.Find(String))
+			{
+				return *Existing;
+			}
+			const uint32 StringOffset = StringTable.Num();
+			FTCHARToUTF8 Utf8(*String);
+			StringTable.Append((const uint8*)Utf8.Get(), Utf8.Length());
+			StringTable.Add(0);
+			StringOffsets.Add(String, StringOffset);
+			return StringOffset;
+		};
+		TArray<FFileEntry> FileEntries;
+		FileEntries.Reserve(AllEntries.Num());
+		for (const FSortableEntry& Entry : AllEntries)
+		{
+			FileEntries.Add({ Entry.Offset, AddString(Entry.Function), AddString(Entry.File), Entry.Line, Entry.Displacement });
+		}
+
+		FFileHeader Header;
+		Header.NumEntries = FileEntries.Num();
+		Header.StringTableSize = StringTable.Num();
+		TArray<uint8> FileData;
+		FileData.Append((const uint8*)&Header, sizeof(Header));
+		FileData.Append((const uint8*)FileEntries.GetData(), FileEntries.Num() * sizeof(FFileEntry));
+		FileData.Append(StringTable);
+
+		//Written next to the old file and moved over it, so a crash mid-write never leaves a broken cache
+		const FString TempFilename = Module.Filename + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(FileData, *TempFilename))
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Couldn't write symbol cache %s"), *TempFilename);
+			return;
+		}
+		Module.Reader.Close();
+		IFileManager::Get().Move(*Module.Filename, *TempFilename, true, true);
+		Module.NewEntries.Reset();
+		Module.Map();
+	}
+
+	void Flush()
+	{
+		FScopeLock ScopeLock(&Lock);
+		for (const TUniquePtr<FModuleCache>& Module : Modules)
+		{
+			if (Module->NewEntries.Num() > 0)
+			{
+				WriteModule(*Module);
+			}
+		}
+	}
+
+	void Clear()
+	{
+		FScopeLock ScopeLock(&Lock);
+		Modules.Reset();
+		IFileManager::Get().DeleteDirectory(*GetCacheDir(), false, true);
+		NumHits = 0;
+		NumMisses = 0;
+	}
+
+	static FAutoConsoleCommand StatsCommand(
+		TEXT("HWBP.SymbolCache.Stats"),
+		TEXT("Logs symbol cache hits and misses, and the cached entries per module"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FScopeLock ScopeLock(&Lock);
+			UE_LOG(LogHardwareBreakpoints, Display, TEXT("Symbol cache: %llu hits, %llu misses"), NumHits, NumMisses);
+			for (const TUniquePtr<FModuleCache>& Module : Modules)
+			{
+				UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %-40s %6u cached, %4d new  %s"), *Module->BuildId.Name, Module->NumEntries, Module->NewEntries.Num(), *FPaths::GetCleanFilename(Module->Filename));
+			}
+		})
+	);
+
+	static FAutoConsoleCommand ClearCommand(
+		TEXT("HWBP.SymbolCache.Clear"),
+		TEXT("Deletes the persistent symbol cache"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Clear();
+		})
+	);
+}
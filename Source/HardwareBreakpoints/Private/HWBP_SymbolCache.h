@@ -0,0 +1,20 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformStackWalk.h"
+
+//Persistent program counter -> (function, file, line) cache, so sessions on the same build don't pay for symbol lookups again
+//One file per module build (PDB GUID and age), holding entries sorted by offset in the module, which is memory mapped and binary searched
+//Lookups that miss are resolved through the platform stack walker and written back a few seconds later
+//Files live in Saved/HardwareBreakpoints/SymbolCache. Console: HWBP.SymbolCache.Stats, HWBP.SymbolCache.Clear
+namespace HWBP_SymbolCache
+{
+	//Drop-in for FPlatformStackWalk::ProgramCounterToSymbolInfo. Stack walking has to be initialized for lookups that miss the cache
+	void ProgramCounterToSymbolInfo(uint64 ProgramCounter, FProgramCounterSymbolInfo& OutSymbolInfo);
+
+	//Writes new entries to disk. Called periodically, and on module shutdown
+	void Flush();
+	void Clear();
+}
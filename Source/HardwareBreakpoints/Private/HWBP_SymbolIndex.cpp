@@ -0,0 +1,373 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_SymbolIndex.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "HWBP_SymbolPreloader.h"
+#include "Profiling/HWBP_MappedFileWriter.h"
+
+namespace HWBP_SymbolIndex
+{
+	static constexpr uint32 Magic = 'ISWH';
+	static constexpr uint32 Version = 1;
+	static const int32 MaxAmbiguousMatchesLogged = 16;
+
+	//File layout: FIndexHeader, NumEntries x FIndexEntry sorted by name, then the string table (null terminated UTF8)
+	struct FIndexHeader
+	{
+		uint32 Magic = HWBP_SymbolIndex::Magic;
+		uint32 Version = HWBP_SymbolIndex::Version;
+		uint32 NumEntries = 0;
+		uint32 StringTableSize = 0;
+	};
+
+	struct FIndexEntry
+	{
+		//Relative to the module base
+		uint32 Offset;
+		uint32 Size;
+		//Offset into the string table
+		uint32 Name;
+	};
+
+	struct FModuleIndex
+	{
+		FString Name;
+		uint64 Base = 0;
+		uint64 ImageSize = 0;
+		FHWBP_MappedFileReader Reader;
+		TArray<uint8> OwnedData;
+		const FIndexEntry* Entries = nullptr;
+		const ANSICHAR* Strings = nullptr;
+		uint32 NumEntries = 0;
+
+		bool SetData(const uint8* Data, int64 Size)
+		{
+			const FIndexHeader* Header = (const FIndexHeader*)Data;
+			if (Size < (int64)sizeof(FIndexHeader) || Header->Magic != Magic || Header->Version != Version
+				|| Size != (int64)(sizeof(FIndexHeader) + Header->NumEntries * sizeof(FIndexEntry) + Header->StringTableSize))
+			{
+				return false;
+			}
+			Entries = (const FIndexEntry*)(Header + 1);
+			NumEntries = Header->NumEntries;
+			Strings = (const ANSICHAR*)(Entries + NumEntries);
+			return true;
+		}
+
+		const ANSICHAR* GetName(uint32 EntryIndex) const
+		{
+			return Strings + Entries[EntryIndex].Name;
+		}
+
+		//First entry whose name isn't less than Name
+		uint32 LowerBound(const ANSICHAR* Name) const
+		{
+			uint32 Low = 0;
+			uint32 High = NumEntries;
+			while (Low < High)
+			{
+				const uint32 Middle = Low + (High - Low) / 2;
+				if (FCStringAnsi::Strcmp(GetName(Middle), Name) < 0)
+				{
+					Low = Middle + 1;
+				}
+				else
+				{
+					High = Middle;
+				}
+			}
+			return Low;
+		}
+	};
+
+	static FCriticalSection Lock;
+	//By module base. Modules that get unloaded are dropped on the next query
+	static TMap<uint64, TUniquePtr<FModuleIndex>> Modules;
+
+	static FString GetIndexDir()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("HardwareBreakpoints") / TEXT("SymbolIndex");
+	}
+
+	static bool BuildIndexData(uint64 ModuleBase, TArray<uint8>& OutData)
+	{
+		TArray<ANSICHAR> Names;
+		TArray<FIndexEntry> Entries;
+		const bool bEnumerated = FPlatformHardwareBreakpoints::EnumerateFunctionSymbols(ModuleBase, [ModuleBase, &Names, &Entries](const ANSICHAR* Name, uint64 Address, uint32 Size)
+		{
+			Entries.Add({ (uint32)(Address - ModuleBase), Size, (uint32)Names.Num() });
+			Names.Append(Name, FCStringAnsi::Strlen(Name) + 1);
+		});
+		if (!bEnumerated)
+		{
+			return false;
+		}
+		Entries.Sort([&Names](const FIndexEntry& A, const FIndexEntry& B) { return FCStringAnsi::Strcmp(&Names[A.Name], &Names[B.Name]) < 0; });
+
+		//Rebuilt in sorted order, so overloads that share a name share its string
+		TArray<ANSICHAR> StringTable;
+		StringTable.Reserve(Names.Num());
+		const ANSICHAR* PreviousName = nullptr;
+		for (FIndexEntry& Entry : Entries)
+		{
+			const ANSICHAR* Name = &Names[Entry.Name];
+			if (PreviousName == nullptr || FCStringAnsi::Strcmp(Name, PreviousName) != 0)
+			{
+				StringTable.Append(Name, FCStringAnsi::Strlen(Name) + 1);
+				PreviousName = Name;
+			}
+			Entry.Name = StringTable.Num() - (FCStringAnsi::Strlen(Name) + 1);
+		}
+
+		FIndexHeader Header;
+		Header.NumEntries = Entries.Num();
+		Header.StringTableSize = StringTable.Num();
+		OutData.Reset();
+		OutData.Append((const uint8*)&Header, sizeof(Header));
+		OutData.Append((const uint8*)Entries.GetData(), Entries.Num() * sizeof(FIndexEntry));
+		OutData.Append((const uint8*)StringTable.GetData(), StringTable.Num());
+		return true;
+	}
+
+	static TUniquePtr<FModuleIndex> IndexModule(const FStackWalkModuleInfo& ModuleInfo)
+	{
+		TUniquePtr<FModuleIndex> Module = MakeUnique<FModuleIndex>();
+		Module->Name = ModuleInfo.ModuleName;
+		Module->Base = ModuleInfo.BaseOfImage;
+		Module->ImageSize = ModuleInfo.ImageSize;
+
+		FString Filename;
+		FHardwareBreakpointModuleBuildId BuildId;
+		if (FPlatformHardwareBreakpoints::GetModuleBuildId(Module->Base, BuildId))
+		{
+			Filename = GetIndexDir() / FString::Printf(TEXT("%s-%s.hwsi"), *Module->Name, *BytesToHex(BuildId.Id, sizeof(BuildId.Id)));
+			if (Module->Reader.Open(Filename) && Module->SetData(Module->Reader.GetData(), Module->Reader.GetSize()))
+			{
+				return Module;
+			}
+			Module->Reader.Close();
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		if (!BuildIndexData(Module->Base, Module->OwnedData) || !Module->SetData(Module->OwnedData.GetData(), Module->OwnedData.Num()))
+		{
+			//Kept empty, so it isn't enumerated again on every query
+			return Module;
+		}
+		UE_LOG(LogHardwareBreakpoints, Verbose, TEXT("Indexed %u functions in %s in %.2fs"), Module->NumEntries, *Module->Name, FPlatformTime::Seconds() - StartTime);
+		//Modules without symbols aren't stored, they might have them next time
+		if (Module->NumEntries > 0 && !Filename.IsEmpty() && !FFileHelper::SaveArrayToFile(Module->OwnedData, *Filename))
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Couldn't write symbol index %s"), *Filename);
+		}
+		return Module;
+	}
+
+	//Indexes the loaded modules that match ModuleFilter (all of them if it's empty) that weren't indexed yet
+	static bool UpdateModules(const FString& ModuleFilter, TArray<const FModuleIndex*>& OutModules)
+	{
+		if (HWBP_SymbolPreloader::IsLoading())
+		{
+			//DbgHelp isn't thread safe
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Symbols are being loaded in the background, search again once HWBP.Symbols.Status reports they're loaded"));
+			return false;
+		}
+		FPlatformStackWalk::InitStackWalking();
+		TArray<FStackWalkModuleInfo> ModuleInfos;
+		ModuleInfos.SetNum(FPlatformStackWalk::GetProcessModuleCount());
+		ModuleInfos.SetNum(FPlatformStackWalk::GetProcessModuleSignatures(ModuleInfos.GetData(), ModuleInfos.Num()));
+
+		TSet<uint64> LoadedBases;
+		for (const FStackWalkModuleInfo& ModuleInfo : ModuleInfos)
+		{
+			LoadedBases.Add(ModuleInfo.BaseOfImage);
+		}
+		for (auto It = Modules.CreateIterator(); It; ++It)
+		{
+			if (!LoadedBases.Contains(It.Key()))
+			{
+				It.RemoveCurrent();
+			}
+		}
+
+		for (const FStackWalkModuleInfo& ModuleInfo : ModuleInfos)
+		{
+			if (!ModuleFilter.IsEmpty() && !FString(ModuleInfo.ModuleName).MatchesWildcard(ModuleFilter))
+			{
+				continue;
+			}
+			TUniquePtr<FModuleIndex>& Module = Modules.FindOrAdd(ModuleInfo.BaseOfImage);
+			if (!Module.IsValid() || Module->Name != ModuleInfo.ModuleName)
+			{
+				Module = IndexModule(ModuleInfo);
+			}
+			OutModules.Add(Module.Get());
+		}
+		return true;
+	}
+
+	//Case insensitive, * matches any sequence and ? any character
+	static bool MatchesWildcard(const ANSICHAR* Pattern, const ANSICHAR* Name)
+	{
+		const ANSICHAR* Star = nullptr;
+		const ANSICHAR* Resume = nullptr;
+		while (*Name)
+		{
+			if (*Pattern == '*')
+			{
+				Star = Pattern++;
+				Resume = Name;
+			}
+			else if (*Pattern == '?' || FCharAnsi::ToLower(*Pattern) == FCharAnsi::ToLower(*Name))
+			{
+				++Pattern;
+				++Name;
+			}
+			else if (Star)
+			{
+				Pattern = Star + 1;
+				Name = ++Resume;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		while (*Pattern == '*')
+		{
+			++Pattern;
+		}
+		return *Pattern == 0;
+	}
+
+	int32 Find(const FString& Query, EMatch Match, TArray<FSymbol>& OutSymbols, int32 MaxResults)
+	{
+		FString ModuleFilter;
+		FString Pattern = Query;
+		int32 Separator;
+		//Module names never have "::", operator! and operator!= do
+		if (Query.FindChar(TEXT('!'), Separator) && Separator > 0 && !Query.Left(Separator).Contains(TEXT("::")))
+		{
+			ModuleFilter = Query.Left(Separator);
+			Pattern = Query.Mid(Separator + 1);
+		}
+		const FTCHARToUTF8 Needle(*Pattern);
+		const int32 NeedleLength = Needle.Length();
+
+		FScopeLock ScopeLock(&Lock);
+		TArray<const FModuleIndex*> SearchedModules;
+		if (!UpdateModules(ModuleFilter, SearchedModules))
+		{
+			return 0;
+		}
+		int32 NumMatches = 0;
+		auto AddMatch = [&NumMatches, &OutSymbols, MaxResults](const FModuleIndex& Module, uint32 EntryIndex)
+		{
+			if (NumMatches++ < MaxResults)
+			{
+				FSymbol& Symbol = OutSymbols[OutSymbols.AddDefaulted()];
+				Symbol.Module = Module.Name;
+				Symbol.Name = UTF8_TO_TCHAR(Module.GetName(EntryIndex));
+				Symbol.Address = Module.Base + Module.Entries[EntryIndex].Offset;
+				Symbol.Size = Module.Entries[EntryIndex].Size;
+			}
+		};
+		for (const FModuleIndex* Module : SearchedModules)
+		{
+			switch (Match)
+			{
+			case EMatch::Exact:
+				for (uint32 i = Module->LowerBound(Needle.Get()); i < Module->NumEntries && FCStringAnsi::Strcmp(Module->GetName(i), Needle.Get()) == 0; ++i)
+				{
+					AddMatch(*Module, i);
+				}
+				break;
+			case EMatch::Prefix:
+				for (uint32 i = Module->LowerBound(Needle.Get()); i < Module->NumEntries && FCStringAnsi::Strncmp(Module->GetName(i), Needle.Get(), NeedleLength) == 0; ++i)
+				{
+					AddMatch(*Module, i);
+				}
+				break;
+			case EMatch::Substring:
+				for (uint32 i = 0; i < Module->NumEntries; ++i)
+				{
+					if (FCStringAnsi::Stristr(Module->GetName(i), Needle.Get()))
+					{
+						AddMatch(*Module, i);
+					}
+				}
+				break;
+			case EMatch::Wildcard:
+				for (uint32 i = 0; i < Module->NumEntries; ++i)
+				{
+					if (MatchesWildcard(Needle.Get(), Module->GetName(i)))
+					{
+						AddMatch(*Module, i);
+					}
+				}
+				break;
+			}
+		}
+		return NumMatches;
+	}
+
+	static EMatch GetDefaultMatch(const FString& Query)
+	{
+		int32 Unused;
+		return Query.FindChar(TEXT('*'), Unused) || Query.FindChar(TEXT('?'), Unused) ? EMatch::Wildcard : EMatch::Substring;
+	}
+
+	bool Resolve(const FString& Query, FSymbol& OutSymbol)
+	{
+		TArray<FSymbol> Symbols;
+		int32 NumMatches = Find(Query, EMatch::Exact, Symbols, MaxAmbiguousMatchesLogged);
+		if (NumMatches == 0)
+		{
+			NumMatches = Find(Query, GetDefaultMatch(Query), Symbols, MaxAmbiguousMatchesLogged);
+		}
+		if (NumMatches == 1)
+		{
+			OutSymbol = Symbols[0];
+			return true;
+		}
+		if (NumMatches == 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("No function matches %s"), *Query);
+			return false;
+		}
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("%s matches %d functions, use a more specific name or prefix it with the module (Module!Name):"), *Query, NumMatches);
+		for (const FSymbol& Symbol : Symbols)
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("  %s!%s"), *Symbol.Module, *Symbol.Name);
+		}
+		return false;
+	}
+
+	static FAutoConsoleCommand FindCommand(
+		TEXT("HWBP.Symbols.Find"),
+		TEXT("Lists native functions matching a name (substring, or wildcards with * and ?), optionally prefixed with a module filter: HWBP.Symbols.Find [Module!]Query [MaxResults]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() < 1)
+			{
+				return;
+			}
+			const int32 MaxResults = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 50;
+			TArray<FSymbol> Symbols;
+			const int32 NumMatches = Find(Args[0], GetDefaultMatch(Args[0]), Symbols, MaxResults);
+			for (const FSymbol& Symbol : Symbols)
+			{
+				UE_LOG(LogHardwareBreakpoints, Display, TEXT("0x%016llx %6u  %s!%s"), Symbol.Address, Symbol.Size, *Symbol.Module, *Symbol.Name);
+			}
+			UE_LOG(LogHardwareBreakpoints, Display, TEXT("%d of %d matches shown"), Symbols.Num(), NumMatches);
+		})
+	);
+}
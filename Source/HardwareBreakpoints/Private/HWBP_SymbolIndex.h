@@ -0,0 +1,38 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Searchable index of the function symbols of every loaded module, to find native functions to break on by partial name
+//Modules are indexed the first time a query covers them, and the index is stored per module build in Saved/HardwareBreakpoints/SymbolIndex,
+//so later sessions on the same build don't have to load the module's symbols to search it
+//Queries can start with "Module!" to only search (and index) matching modules, e.g. "*-Engine!UWorld::Tick*"
+//Console: HWBP.Symbols.Find <Query> [MaxResults]
+namespace HWBP_SymbolIndex
+{
+	enum class EMatch : uint8
+	{
+		Exact,
+		//Case sensitive, uses the index's sort order
+		Prefix,
+		//Case insensitive
+		Substring,
+		//Case insensitive, * and ? wildcards
+		Wildcard,
+	};
+
+	struct FSymbol
+	{
+		FString Module;
+		FString Name;
+		uint64 Address = 0;
+		uint32 Size = 0;
+	};
+
+	//Returns the total number of matches, which can be more than the MaxResults added to OutSymbols
+	int32 Find(const FString& Query, EMatch Match, TArray<FSymbol>& OutSymbols, int32 MaxResults = 1000);
+
+	//Exact name first, then wildcard (if Query has * or ?) or substring matches. Fails and logs the candidates if the query is ambiguous
+	bool Resolve(const FString& Query, FSymbol& OutSymbol);
+}
@@ -0,0 +1,282 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_SymbolPreloader.h"
+
+#include <atomic>
+
+#include "Async/Async.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+#include "HAL/PlatformTLS.h"
+#include "Misc/App.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "HWBP_SymbolCache.h"
+#include "Misc/HWBP_Ticker.h"
+
+namespace HWBP_SymbolPreloader
+{
+	enum class EState : uint8
+	{
+		Idle,
+		Loading,
+		Loaded,
+	};
+
+	static const int32 MaxPendingHits = 32;
+	static const int32 MaxPendingDepth = 64;
+
+	struct FPendingHit
+	{
+		uint64 Stack[MaxPendingDepth];
+		uint32 Depth = 0;
+		uint32 ThreadId = 0;
+		int32 BreakpointIndex = -1;
+		FName Label;
+	};
+
+	static std::atomic<EState> State{ EState::Idle };
+	static std::atomic<int32> NumModules{ 0 };
+	static std::atomic<int32> NumLoadedModules{ 0 };
+
+	//Hits are only queued while loading, and only flushed after, so this lock is never contended for long
+	static FCriticalSection PendingLock;
+	static FPendingHit PendingHits[MaxPendingHits];
+	static int32 NumPendingHits = 0;
+	static int32 NumDroppedHits = 0;
+
+	static FHWBP_TickerHandle TickerHandle;
+	//Kept so shutdown can wait for the worker, it runs code of this module
+	static TFuture<void> LoadTask;
+	//Checked between modules, a module's symbols are never left half loaded
+	static std::atomic<bool> bCancelLoad{ false };
+
+	//Lower is loaded first
+	static int32 GetModulePriority(const FStackWalkModuleInfo& Module)
+	{
+		const FString Name = Module.ModuleName;
+		const FString ImagePath = FPaths::ConvertRelativePathToFull(Module.ImageName);
+		if (Name.Contains(FApp::GetProjectName()))
+		{
+			return 0;
+		}
+		static const TCHAR* CoreModules[] = { TEXT("-Core"), TEXT("-CoreUObject"), TEXT("-Engine"), TEXT("-HardwareBreakpoints") };
+		for (const TCHAR* CoreModule : CoreModules)
+		{
+			if (Name.EndsWith(CoreModule))
+			{
+				return 1;
+			}
+		}
+		if (ImagePath.StartsWith(FPaths::ConvertRelativePathToFull(FPaths::ProjectDir())) || ImagePath.StartsWith(FPaths::ConvertRelativePathToFull(FPaths::EngineDir())))
+		{
+			return 2;
+		}
+		//System libraries, they rarely have symbols at hand anyway
+		return 3;
+	}
+
+	//Index of a module that contains a queued hit and isn't loaded yet, or INDEX_NONE
+	static int32 FindModuleForPendingHit(const TArray<FStackWalkModuleInfo>& Modules, const TBitArray<>& Loaded)
+	{
+		FScopeLock Lock(&PendingLock);
+		for (int32 HitIndex = 0; HitIndex < NumPendingHits; ++HitIndex)
+		{
+			const FPendingHit& Hit = PendingHits[HitIndex];
+			for (uint32 Frame = 0; Frame < Hit.Depth; ++Frame)
+			{
+				for (int32 ModuleIndex = 0; ModuleIndex < Modules.Num(); ++ModuleIndex)
+				{
+					const FStackWalkModuleInfo& Module = Modules[ModuleIndex];
+					if (!Loaded[ModuleIndex] && Hit.Stack[Frame] >= Module.BaseOfImage && Hit.Stack[Frame] < Module.BaseOfImage + Module.ImageSize)
+					{
+						return ModuleIndex;
+					}
+				}
+			}
+		}
+		return INDEX_NONE;
+	}
+
+	static void LoadSymbols()
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		//Registers every module with DbgHelp. Modules are registered with deferred loads, so their symbols are only read on the first lookup
+		FPlatformStackWalk::InitStackWalking();
+
+		TArray<FStackWalkModuleInfo> Modules;
+		Modules.SetNum(FPlatformStackWalk::GetProcessModuleCount());
+		Modules.SetNum(FPlatformStackWalk::GetProcessModuleSignatures(Modules.GetData(), Modules.Num()));
+		Modules.StableSort([](const FStackWalkModuleInfo& A, const FStackWalkModuleInfo& B) { return GetModulePriority(A) < GetModulePriority(B); });
+		NumModules = Modules.Num();
+
+		TBitArray<> Loaded(false, Modules.Num());
+		int32 NextInOrder = 0;
+		int32 LastReportedQuarter = 0;
+		for (int32 Count = 0; Count < Modules.Num(); ++Count)
+		{
+			if (bCancelLoad)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("Background symbol loading cancelled after %d/%d modules"), NumLoadedModules.load(), Modules.Num());
+				State = EState::Idle;
+				return;
+			}
+			int32 ModuleIndex = FindModuleForPendingHit(Modules, Loaded);
+			if (ModuleIndex == INDEX_NONE)
+			{
+				while (Loaded[NextInOrder])
+				{
+					++NextInOrder;
+				}
+				ModuleIndex = NextInOrder;
+			}
+			Loaded[ModuleIndex] = true;
+
+			//Any lookup inside the module forces its deferred symbol load
+			FProgramCounterSymbolInfo SymbolInfo;
+			FPlatformStackWalk::ProgramCounterToSymbolInfo(Modules[ModuleIndex].BaseOfImage + 0x1000, SymbolInfo);
+
+			const int32 Quarter = (++NumLoadedModules) * 4 / Modules.Num();
+			if (Quarter > LastReportedQuarter)
+			{
+				LastReportedQuarter = Quarter;
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("Symbols %d%% loaded (%d/%d modules, last %s)"), Quarter * 25, NumLoadedModules.load(), Modules.Num(), Modules[ModuleIndex].ModuleName);
+			}
+		}
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Symbols for %d modules loaded in the background in %.1fs"), Modules.Num(), FPlatformTime::Seconds() - StartTime);
+		State = EState::Loaded;
+	}
+
+	static void FlushPendingHits()
+	{
+		FScopeLock Lock(&PendingLock);
+		for (int32 HitIndex = 0; HitIndex < NumPendingHits; ++HitIndex)
+		{
+			const FPendingHit& Hit = PendingHits[HitIndex];
+			FString Stack;
+			for (uint32 Frame = 0; Frame < Hit.Depth; ++Frame)
+			{
+				ANSICHAR Line[1024] = { 0 };
+				FProgramCounterSymbolInfo SymbolInfo;
+				HWBP_SymbolCache::ProgramCounterToSymbolInfo(Hit.Stack[Frame], SymbolInfo);
+				FPlatformStackWalk::SymbolInfoToHumanReadableString(SymbolInfo, Line, sizeof(Line));
+				Stack += ANSI_TO_TCHAR(Line);
+				Stack += LINE_TERMINATOR;
+			}
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("_\n============= HARDWARE BREAKPOINT STACK (hit on slot %d%s%s, thread %u, while symbols were loading) ===========\nStack:\n%s"),
+				Hit.BreakpointIndex, Hit.Label.IsNone() ? TEXT("") : TEXT(", "), Hit.Label.IsNone() ? TEXT("") : *Hit.Label.ToString(), Hit.ThreadId, *Stack);
+		}
+		if (NumDroppedHits > 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("%d more hits arrived while symbols were loading, their callstacks were not kept"), NumDroppedHits);
+		}
+		NumPendingHits = 0;
+		NumDroppedHits = 0;
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		if (State != EState::Loaded)
+		{
+			return true;
+		}
+		FlushPendingHits();
+		TickerHandle.Reset();
+		return false;
+	}
+
+	void Start()
+	{
+		EState Expected = EState::Idle;
+		if (!State.compare_exchange_strong(Expected, EState::Loading))
+		{
+			return;
+		}
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Loading debug symbols in the background"));
+		TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+		bCancelLoad = false;
+		LoadTask = Async(EAsyncExecution::Thread, &LoadSymbols);
+	}
+
+	void Shutdown()
+	{
+		if (TickerHandle.IsValid())
+		{
+			FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+		}
+		if (LoadTask.IsValid())
+		{
+			bCancelLoad = true;
+			LoadTask.Wait();
+			LoadTask.Reset();
+		}
+	}
+
+	bool IsLoading()
+	{
+		return State == EState::Loading;
+	}
+
+	bool IsLoaded()
+	{
+		return State == EState::Loaded;
+	}
+
+	float GetProgress()
+	{
+		if (State == EState::Loaded)
+		{
+			return 1.0f;
+		}
+		const int32 Total = NumModules.load();
+		return Total > 0 ? (float)NumLoadedModules.load() / Total : 0.0f;
+	}
+
+	void QueueHit(int32 BreakpointIndex, struct _EXCEPTION_POINTERS* ExceptionInfo)
+	{
+		FScopeLock Lock(&PendingLock);
+		if (NumPendingHits == MaxPendingHits)
+		{
+			++NumDroppedHits;
+			return;
+		}
+		FPendingHit& Hit = PendingHits[NumPendingHits++];
+		Hit.Depth = FPlatformHardwareBreakpoints::UnwindStackBackTrace(Hit.Stack, MaxPendingDepth, ExceptionInfo);
+		Hit.ThreadId = FPlatformTLS::GetCurrentThreadId();
+		Hit.BreakpointIndex = BreakpointIndex;
+		Hit.Label = FPlatformHardwareBreakpoints::GetBreakpointLabel(BreakpointIndex);
+	}
+
+	static FAutoConsoleCommand PreloadCommand(
+		TEXT("HWBP.Symbols.Preload"),
+		TEXT("Starts loading debug symbols in the background, so breakpoint hits don't freeze the application to load them"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Start();
+		})
+	);
+
+	static FAutoConsoleCommand StatusCommand(
+		TEXT("HWBP.Symbols.Status"),
+		TEXT("Logs the progress of background symbol loading"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			switch (State.load())
+			{
+			case EState::Idle:
+				UE_LOG(LogHardwareBreakpoints, Display, TEXT("Background symbol loading hasn't started"));
+				break;
+			case EState::Loading:
+				UE_LOG(LogHardwareBreakpoints, Display, TEXT("Loading symbols: %d/%d modules, %d hits queued"), NumLoadedModules.load(), NumModules.load(), NumPendingHits);
+				break;
+			case EState::Loaded:
+				UE_LOG(LogHardwareBreakpoints, Display, TEXT("Symbols for %d modules loaded"), NumModules.load());
+				break;
+			}
+		})
+	);
+}
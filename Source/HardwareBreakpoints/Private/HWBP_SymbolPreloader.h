@@ -0,0 +1,26 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Loads debug symbols on a worker thread, so the first hit doesn't have to freeze the application while they load
+//Modules are loaded in order of how likely they are to show up in a hit: modules with queued hits first, then the project's,
+//then core engine modules, then everything else. Hits that arrive while loading are queued with raw program counters,
+//and logged with their symbolized callstack once loading is done
+//DbgHelp isn't thread safe, so hits don't touch it while the worker runs (stacks are captured from the unwind tables)
+//Started from UHWBP_Settings::SymbolPreload, or with HWBP.Symbols.Preload. Progress: HWBP.Symbols.Status
+namespace HWBP_SymbolPreloader
+{
+	//Does nothing if loading already started
+	void Start();
+	//Cancels loading and waits for the worker to finish the module it's on. Called when the module shuts down
+	void Shutdown();
+	bool IsLoading();
+	bool IsLoaded();
+	//In [0, 1]
+	float GetProgress();
+
+	//Called from the exception handler. Captures the callstack without DbgHelp, doesn't allocate
+	void QueueHit(int32 BreakpointIndex, struct _EXCEPTION_POINTERS* ExceptionInfo);
+}
@@ -0,0 +1,78 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_Trace.h"
+
+#if HWBP_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_DEFINE(HardwareBreakpointsChannel)
+
+UE_TRACE_EVENT_BEGIN(HardwareBreakpoints, BreakpointSet)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint64, Address)
+	UE_TRACE_EVENT_FIELD(int8, Index)
+	UE_TRACE_EVENT_FIELD(uint8, Type)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(HardwareBreakpoints, BreakpointRemoved)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(int8, Index)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(HardwareBreakpoints, Hit)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint64, ProgramCounter)
+	UE_TRACE_EVENT_FIELD(int8, Index)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(HardwareBreakpoints, ConditionRejected)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(int8, Index)
+UE_TRACE_EVENT_END()
+
+UE_TRACE_EVENT_BEGIN(HardwareBreakpoints, HandlerDuration)
+	UE_TRACE_EVENT_FIELD(uint64, StartCycle)
+	UE_TRACE_EVENT_FIELD(uint64, EndCycle)
+UE_TRACE_EVENT_END()
+
+namespace HWBP_Trace
+{
+	void OutputSet(DebugRegisterIndex Index, EHardwareBreakpointType Type, const void* Address)
+	{
+		UE_TRACE_LOG(HardwareBreakpoints, BreakpointSet, HardwareBreakpointsChannel)
+			<< BreakpointSet.Cycle(FPlatformTime::Cycles64())
+			<< BreakpointSet.Address((uint64)Address)
+			<< BreakpointSet.Index((int8)Index)
+			<< BreakpointSet.Type((uint8)Type);
+	}
+
+	void OutputRemove(DebugRegisterIndex Index)
+	{
+		UE_TRACE_LOG(HardwareBreakpoints, BreakpointRemoved, HardwareBreakpointsChannel)
+			<< BreakpointRemoved.Cycle(FPlatformTime::Cycles64())
+			<< BreakpointRemoved.Index((int8)Index);
+	}
+
+	void OutputHit(DebugRegisterIndex Index, uint64 ProgramCounter)
+	{
+		UE_TRACE_LOG(HardwareBreakpoints, Hit, HardwareBreakpointsChannel)
+			<< Hit.Cycle(FPlatformTime::Cycles64())
+			<< Hit.ProgramCounter(ProgramCounter)
+			<< Hit.Index((int8)Index);
+	}
+
+	void OutputConditionRejected(DebugRegisterIndex Index)
+	{
+		UE_TRACE_LOG(HardwareBreakpoints, ConditionRejected, HardwareBreakpointsChannel)
+			<< ConditionRejected.Cycle(FPlatformTime::Cycles64())
+			<< ConditionRejected.Index((int8)Index);
+	}
+
+	void OutputHandlerDuration(uint64 StartCycle, uint64 EndCycle)
+	{
+		UE_TRACE_LOG(HardwareBreakpoints, HandlerDuration, HardwareBreakpointsChannel)
+			<< HandlerDuration.StartCycle(StartCycle)
+			<< HandlerDuration.EndCycle(EndCycle);
+	}
+}
+
+#endif
@@ -0,0 +1,69 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+
+#if UE_TRACE_ENABLED && !UE_BUILD_SHIPPING
+#define HWBP_TRACE_ENABLED 1
+#else
+#define HWBP_TRACE_ENABLED 0
+#endif
+
+//Unreal Insights events for breakpoint set/remove/hit, rejected conditions and exception handler cost
+//Enable with -trace=default,HardwareBreakpoints (or Trace.Enable HardwareBreakpoints). Disabled channels cost a branch
+#if HWBP_TRACE_ENABLED
+
+UE_TRACE_CHANNEL_EXTERN(HardwareBreakpointsChannel)
+
+namespace HWBP_Trace
+{
+	void OutputSet(DebugRegisterIndex Index, EHardwareBreakpointType Type, const void* Address);
+	//Index -1 means every breakpoint was removed
+	void OutputRemove(DebugRegisterIndex Index);
+	void OutputHit(DebugRegisterIndex Index, uint64 ProgramCounter);
+	void OutputConditionRejected(DebugRegisterIndex Index);
+	void OutputHandlerDuration(uint64 StartCycle, uint64 EndCycle);
+
+	//Times the exception handler, and shows it as a CPU scope on the Insights timeline
+	struct FHandlerScope
+	{
+		uint64 StartCycle;
+		FHandlerScope()
+			: StartCycle(UE_TRACE_CHANNELEXPR_IS_ENABLED(HardwareBreakpointsChannel) ? FPlatformTime::Cycles64() : 0)
+		{
+		}
+		~FHandlerScope()
+		{
+			if (StartCycle != 0)
+			{
+				OutputHandlerDuration(StartCycle, FPlatformTime::Cycles64());
+			}
+		}
+	};
+}
+
+//The channel is tested at the call site, so a disabled channel doesn't pay for the call into HWBP_Trace.cpp
+#define HWBP_TRACE_IF_ENABLED(Expression) \
+	do { if (UE_TRACE_CHANNELEXPR_IS_ENABLED(HardwareBreakpointsChannel)) { Expression; } } while (0)
+#define HWBP_TRACE_SET(Index, Type, Address) HWBP_TRACE_IF_ENABLED(HWBP_Trace::OutputSet(Index, Type, Address))
+#define HWBP_TRACE_REMOVE(Index) HWBP_TRACE_IF_ENABLED(HWBP_Trace::OutputRemove(Index))
+#define HWBP_TRACE_HIT(Index, ProgramCounter) HWBP_TRACE_IF_ENABLED(HWBP_Trace::OutputHit(Index, ProgramCounter))
+#define HWBP_TRACE_CONDITION_REJECTED(Index) HWBP_TRACE_IF_ENABLED(HWBP_Trace::OutputConditionRejected(Index))
+#define HWBP_TRACE_HANDLER_SCOPE() \
+	HWBP_Trace::FHandlerScope HWBP_HandlerScope; \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR("HardwareBreakpointsExceptionHandler", HardwareBreakpointsChannel)
+
+#else
+
+#define HWBP_TRACE_SET(Index, Type, Address)
+#define HWBP_TRACE_REMOVE(Index)
+#define HWBP_TRACE_HIT(Index, ProgramCounter)
+#define HWBP_TRACE_CONDITION_REJECTED(Index)
+#define HWBP_TRACE_HANDLER_SCOPE()
+
+#endif
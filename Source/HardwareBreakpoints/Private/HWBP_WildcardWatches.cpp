@@ -0,0 +1,181 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "HWBP_WildcardWatches.h"
+
+#include "UObject/WeakObjectPtr.h"
+
+#include "CallStackViewer.h"
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_Ticker.h"
+
+using namespace PropertyHelpers;
+
+namespace HWBP_WildcardWatches
+{
+	struct FWildcardWatch
+	{
+		TWeakObjectPtr<UObject> Object;
+		FPropertyPathExpansion Expansion;
+		FName Label;
+		//Armed slot of each expanded address. Addresses that didn't fit in the free slots aren't in here
+		TMap<void*, DebugRegisterIndex> Armed;
+		int32 NumUnwatched = 0;
+	};
+
+	static TArray<FWildcardWatch> Watches;
+	static FHWBP_TickerHandle TickerHandle;
+	static FDelegateHandle RemoveBreakpointHandle;
+	//Set while a watch removes its own breakpoints, so they're not taken for a removal from somewhere else
+	static bool bRemovingOwnBreakpoint = false;
+
+	static void RemoveOwnBreakpoint(DebugRegisterIndex Index)
+	{
+		TGuardValue<bool> Guard(bRemovingOwnBreakpoint, true);
+		FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Index);
+		//Invalidates the handles returned when it was armed
+		CallStackViewer::OnRemoveBreakpoint.Broadcast(Index);
+	}
+
+	//Removes the breakpoints of addresses that aren't in the expansion anymore, and arms the ones that are new
+	static void Sync(FWildcardWatch& Watch, TArray<DebugRegisterIndex>* OutArmed)
+	{
+		TArray<FPropertyAddress> Addresses;
+		Watch.Expansion.GetAddresses(Addresses);
+		TSet<void*> Current;
+		Current.Reserve(Addresses.Num());
+		for (const FPropertyAddress& PropertyAddress : Addresses)
+		{
+			Current.Add(PropertyAddress.Address);
+		}
+
+		for (auto It = Watch.Armed.CreateIterator(); It; ++It)
+		{
+			if (!Current.Contains(It.Key()))
+			{
+				RemoveOwnBreakpoint(It.Value());
+				It.RemoveCurrent();
+			}
+		}
+
+		int32 NumUnwatched = 0;
+		for (const FPropertyAddress& PropertyAddress : Addresses)
+		{
+			if (Watch.Armed.Contains(PropertyAddress.Address))
+			{
+				continue;
+			}
+			const DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetDataBreakpoint(PropertyAddress.Address, PropertyAddress.Property->GetSize(), Watch.Object.Get());
+			if (Index < 0)
+			{
+				++NumUnwatched;
+				continue;
+			}
+			FPlatformHardwareBreakpoints::SetBreakpointLabel(Index, Watch.Label);
+			Watch.Armed.Add(PropertyAddress.Address, Index);
+			if (OutArmed)
+			{
+				OutArmed->Add(Index);
+			}
+		}
+		if (NumUnwatched > 0 && NumUnwatched != Watch.NumUnwatched)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Out of breakpoint slots, %d of the %d addresses of %s aren't watched"), NumUnwatched, Addresses.Num(), *Watch.Label.ToString());
+		}
+		Watch.NumUnwatched = NumUnwatched;
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		for (int32 i = Watches.Num() - 1; i >= 0; --i)
+		{
+			FWildcardWatch& Watch = Watches[i];
+			UObject* Object = Watch.Object.Get();
+			//Owner tracking already freed its slots
+			if (Object == nullptr)
+			{
+				Watches.RemoveAtSwap(i);
+				continue;
+			}
+			//Only resolves what changed since the last frame, nothing to do if the arrays along the path weren't touched
+			if (Watch.Expansion.Update(Object, Object->GetClass()) > 0)
+			{
+				Sync(Watch, nullptr);
+			}
+		}
+		if (Watches.Num() == 0)
+		{
+			TickerHandle.Reset();
+			return false;
+		}
+		return true;
+	}
+
+	int32 Add(UObject* Object, const FCompiledPropertyPath& Path, TArray<DebugRegisterIndex>& OutArmed)
+	{
+		if (Object == nullptr || !Path.IsValid())
+		{
+			return 0;
+		}
+		FWildcardWatch Watch;
+		Watch.Object = Object;
+		Watch.Expansion.Reset(Path);
+		Watch.Label = FName(*FString::Printf(TEXT("%s.%s"), *Object->GetName(), *Path.GetPath()));
+		Watch.Expansion.Update(Object, Object->GetClass());
+		TArray<FPropertyAddress> Addresses;
+		Watch.Expansion.GetAddresses(Addresses);
+		if (Addresses.Num() == 0)
+		{
+			return 0;
+		}
+		Sync(Watch, &OutArmed);
+
+		//A path without wildcards can't expand to anything else
+		if (Path.HasWildcards() && Watch.Armed.Num() > 0)
+		{
+			Watches.Add(MoveTemp(Watch));
+			if (!RemoveBreakpointHandle.IsValid())
+			{
+				RemoveBreakpointHandle = CallStackViewer::OnRemoveBreakpoint.AddStatic(&OnBreakpointRemoved);
+			}
+			if (!TickerHandle.IsValid())
+			{
+				TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+			}
+		}
+		return Addresses.Num();
+	}
+
+	void OnBreakpointRemoved(DebugRegisterIndex Index)
+	{
+		if (bRemovingOwnBreakpoint)
+		{
+			return;
+		}
+		const int32 WatchIndex = Watches.IndexOfByPredicate([Index](const FWildcardWatch& Watch)
+		{
+			for (const TPair<void*, DebugRegisterIndex>& Armed : Watch.Armed)
+			{
+				if (Armed.Value == Index)
+				{
+					return true;
+				}
+			}
+			return false;
+		});
+		if (WatchIndex != INDEX_NONE)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("Stopped following %s, one of its breakpoints was removed"), *Watches[WatchIndex].Label.ToString());
+			Watches.RemoveAtSwap(WatchIndex);
+		}
+	}
+
+	void RemoveAll()
+	{
+		Watches.Reset();
+		if (TickerHandle.IsValid())
+		{
+			FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+		}
+	}
+}
@@ -0,0 +1,23 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "PropertyHelpers.h"
+#include "HAL/PlatformHardwareBreakpoints.h"
+
+//Keeps the data breakpoints of a wildcard property path (e.g. "Components[*].RelativeLocation") in sync with the object
+//Each watch owns an FPropertyPathExpansion that is updated every frame, so only elements added since the last frame are resolved,
+//elements that went away have their breakpoint removed, and new ones are armed as long as there are free slots
+//Removing any of a watch's breakpoints from somewhere else (handle, callstack window, owner destroyed) stops following its path
+namespace HWBP_WildcardWatches
+{
+	//Arms the current expansion of Path on Object and keeps following it. OutArmed receives the slots armed now
+	//Returns the number of addresses the path expanded to
+	int32 Add(UObject* Object, const PropertyHelpers::FCompiledPropertyPath& Path, TArray<DebugRegisterIndex>& OutArmed);
+	//Called when a breakpoint is removed explicitly, stops following the watch it belonged to
+	void OnBreakpointRemoved(DebugRegisterIndex Index);
+	//Stops following every path, their breakpoints are left as they are
+	void RemoveAll();
+}
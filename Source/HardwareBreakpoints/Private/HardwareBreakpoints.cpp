@@ -6,11 +6,16 @@
 
 #include "HAL/PlatformHardwareBreakpoints.h"
 #include "HardwareBreakpointsLog.h"
+#include "HWBP_OwnerTracking.h"
+#include "HWBP_ScriptBreakpoints.h"
+#include "HWBP_SymbolCache.h"
+#include "HWBP_SymbolPreloader.h"
+#include "Profiling/HWBP_OpcodeProfiler.h"
+#include "Settings/HWBP_Settings.h"
 #include "Slate/HWBP_Styles.h"
 
 #if WITH_EDITOR
 #include "ISettingsModule.h"
-#include "Settings/HWBP_Settings.h"
 #include "Misc/HWBP_Build.h"
 #endif
 
@@ -21,7 +26,11 @@ DEFINE_LOG_CATEGORY(LogHardwareBreakpoints);
 void FHardwareBreakpointsModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
-	FPlatformHardwareBreakpoints::AddStructuredExceptionHandler();
+	//The exception handler is installed when the first breakpoint is armed, sessions that never set one don't pay for it
+	if (GetDefault<UHWBP_Settings>()->SymbolPreload == EHWBP_SymbolPreload::AtStartup)
+	{
+		HWBP_SymbolPreloader::Start();
+	}
 	
 	FHWBP_Styles::Initialize();
 
@@ -41,7 +50,14 @@ void FHardwareBreakpointsModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	//GNatives would keep pointing at the counting trampolines in this module after it's unloaded
+	HWBP_OpcodeProfiler::Stop();
+	//Unhooks the VM's script context delegate, which would otherwise call into this module after it's unloaded
+	HWBP_ScriptBreakpoints::RemoveAll();
+	HWBP_SymbolPreloader::Shutdown();
 	FPlatformHardwareBreakpoints::RemoveStructuredExceptionHandler();
+	HWBP_OwnerTracking::Shutdown();
+	HWBP_SymbolCache::Flush();
 
 	FHWBP_Styles::Shutdown();
 
@@ -9,7 +9,17 @@
 #include "HAL/PlatformHardwareBreakpoints.h"
 #include "CallStackViewer.h"
 #include "HWBP_Dialogs.h"
+#include "HWBP_ScriptBreakpoints.h"
+#include "HWBP_SourceLines.h"
+#include "HWBP_SymbolIndex.h"
+#include "HWBP_WildcardWatches.h"
 #include "HardwareBreakpointsLog.h"
+#include "Profiling/HWBP_FalseSharing.h"
+#include "Profiling/HWBP_LatencyProbes.h"
+#include "Profiling/HWBP_NodeHeatmap.h"
+#include "Profiling/HWBP_OpcodeProfiler.h"
+#include "Profiling/HWBP_RedundantWrites.h"
+#include "Profiling/HWBP_WriteProfiler.h"
 #if ENGINE_MAJOR_VERSION >= 5
 #include "UObject/UnrealTypePrivate.h"
 #endif
@@ -50,6 +60,18 @@ bool SetDataBreakpoint(UObject* Object, TCHAR* PropertyPath)
 	return true;
 }
 
+bool SetWildcardDataBreakpoints(UObject* Object, TCHAR* PropertyPath)
+{
+	FString Path = PropertyPath;
+	GetCurrentGameWorld()->GetTimerManager().SetTimerForNextTick([Object, Path]()
+	{
+		bool bResult = false;
+		TArray<FHardwareBreakpointHandle> Unused;
+		UHardwareBreakpointsBPLibrary::SetWildcardDataBreakpoints(Object, Path, bResult, Unused);
+	});
+	return true;
+}
+
 bool SetFunctionBreakpoint(UClass* Class, TCHAR* FunctionName)
 {
 	FName FuncName = FunctionName;
@@ -63,6 +85,37 @@ bool SetFunctionBreakpoint(UClass* Class, TCHAR* FunctionName)
 	return true;
 }
 
+bool SetScriptFunctionBreakpoint(UClass* Class, TCHAR* FunctionName)
+{
+	//Unlike hardware breakpoints this doesn't depend on the calling thread, so it can be set right away
+	bool bResult = false;
+	UHardwareBreakpointsBPLibrary::SetScriptFunctionBreakpoint(Class, FunctionName, bResult);
+	return bResult;
+}
+
+bool SetSymbolBreakpoint(TCHAR* SymbolName)
+{
+	FString Name = SymbolName;
+	GetCurrentGameWorld()->GetTimerManager().SetTimerForNextTick([Name]()
+	{
+		bool bResult = false;
+		FHardwareBreakpointHandle Unused;
+		UHardwareBreakpointsBPLibrary::SetSymbolBreakpoint(Name, bResult, Unused);
+	});
+	return true;
+}
+
+bool SetSourceLineBreakpoint(TCHAR* Location)
+{
+	FString LocationString = Location;
+	GetCurrentGameWorld()->GetTimerManager().SetTimerForNextTick([LocationString]()
+	{
+		bool bResult = false;
+		UHardwareBreakpointsBPLibrary::SetSourceLineBreakpoint(LocationString, bResult);
+	});
+	return true;
+}
+
 bool AnyHardwareBreakpointSet()
 {
 	return FPlatformHardwareBreakpoints::AnyBreakpointSet();
@@ -89,6 +142,67 @@ void UHardwareBreakpointsBPLibrary::SetDataBreakpoint(UObject* Object, FString P
 		return;
 	}
 	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetDataBreakpoint(PropertyAddress.Address, PropertyAddress.Property->GetSize(), Object);
+	FPlatformHardwareBreakpoints::SetBreakpointLabel(Index, FName(*FString::Printf(TEXT("%s.%s"), *Object->GetName(), *PropertyPath)));
+	BreakpointHandle.SetIndex(Index);
+	bSuccess = Index >= 0;
+}
+
+void UHardwareBreakpointsBPLibrary::SetWildcardDataBreakpoints(UObject* Object, FString PropertyPath, bool& bSuccess, TArray<FHardwareBreakpointHandle>& BreakpointHandles)
+{
+	bSuccess = false;
+	BreakpointHandles.Reset();
+	if (Object == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Tried to set a data breakpoint on an invalid object"));
+		return;
+	}
+	FCompiledPropertyPath CompiledPath;
+	if (!CompiledPath.Compile(PropertyPath))
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Invalid property path %s"), *PropertyPath);
+		return;
+	}
+	//Keeps following the path, so elements added to the arrays along it later on get watched too
+	TArray<DebugRegisterIndex> Armed;
+	const int32 NumAddresses = HWBP_WildcardWatches::Add(Object, CompiledPath, Armed);
+	if (NumAddresses == 0)
+	{
+		ShowPropertyNotFoundMessageDialog(PropertyPath, Object);
+		return;
+	}
+	for (DebugRegisterIndex Index : Armed)
+	{
+		BreakpointHandles[BreakpointHandles.AddDefaulted()].SetIndex(Index);
+	}
+	UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s expanded to %d addresses, %d watched"), *PropertyPath, NumAddresses, Armed.Num());
+	bSuccess = Armed.Num() > 0;
+}
+
+void UHardwareBreakpointsBPLibrary::SetReallocFollowingDataBreakpoint(UObject* Object, FString PropertyPath, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle)
+{
+	if (Object == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Tried to set a data breakpoint on an invalid object"));
+		bSuccess = false;
+		return;
+	}
+	FPropertyAddress PropertyAddress = FindPropertyAddress(Object, Object->GetClass(), PropertyPath);
+	if (PropertyAddress.Address == nullptr)
+	{
+		ShowPropertyNotFoundMessageDialog(PropertyPath, Object);
+		bSuccess = false;
+		return;
+	}
+	if (PropertyAddress.ContainerHeader == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Set Realloc Following Data Breakpoint called on a path that doesn't go through an array element or string character %s"), *PropertyPath);
+		bSuccess = false;
+		return;
+	}
+	const FScriptArray* Container = static_cast<const FScriptArray*>(PropertyAddress.ContainerHeader);
+	const int32 OffsetInElement = static_cast<int32>(static_cast<uint8*>(PropertyAddress.Address) - (static_cast<const uint8*>(Container->GetData()) + PropertyAddress.ContainerIndex * PropertyAddress.ContainerElementSize));
+	const int32 DataSize = CAST_PROPERTY<StrPropertyType>(PropertyAddress.Property) ? sizeof(TCHAR) : PropertyAddress.Property->GetSize();
+	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetReallocFollowingDataBreakpoint(PropertyAddress.ContainerHeader, PropertyAddress.ContainerIndex, PropertyAddress.ContainerElementSize, OffsetInElement, DataSize, Object);
 	BreakpointHandle.SetIndex(Index);
 	bSuccess = Index >= 0;
 }
@@ -211,12 +325,162 @@ void UHardwareBreakpointsBPLibrary::SetFunctionBreakpoint(UClass* Class, FName F
 	bSuccess = Index >= 0;
 }
 
+void UHardwareBreakpointsBPLibrary::SetScriptFunctionBreakpoint(UClass* Class, FName FunctionName, bool& bSuccess)
+{
+	UFunction* Function = Class ? Class->FindFunctionByName(FunctionName) : nullptr;
+	if (Function == nullptr || Function->HasAnyFunctionFlags(FUNC_Native))
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't find Blueprint function %s in %s"), *FunctionName.ToString(), *GetNameSafe(Class));
+		bSuccess = false;
+		return;
+	}
+	bSuccess = HWBP_ScriptBreakpoints::Add(Function);
+}
+
+void UHardwareBreakpointsBPLibrary::ClearScriptFunctionBreakpoint(UClass* Class, FName FunctionName)
+{
+	HWBP_ScriptBreakpoints::Remove(Class ? Class->FindFunctionByName(FunctionName) : nullptr);
+}
+
+void UHardwareBreakpointsBPLibrary::SetSymbolBreakpoint(const FString& SymbolName, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle)
+{
+	bSuccess = false;
+	HWBP_SymbolIndex::FSymbol Symbol;
+	if (!HWBP_SymbolIndex::Resolve(SymbolName, Symbol))
+	{
+		return;
+	}
+	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Execute, EHardwareBreakpointSize::Size_1, (void*)Symbol.Address);
+	BreakpointHandle.SetIndex(Index);
+	bSuccess = Index >= 0;
+	if (bSuccess)
+	{
+		FPlatformHardwareBreakpoints::SetBreakpointLabel(Index, FName(*Symbol.Name));
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Breakpoint set on %s!%s"), *Symbol.Module, *Symbol.Name);
+	}
+}
+
+void UHardwareBreakpointsBPLibrary::SetSourceLineBreakpoint(const FString& Location, bool& bSuccess)
+{
+	bSuccess = HWBP_SourceLines::Start(Location, false);
+}
+
+void UHardwareBreakpointsBPLibrary::SetSourceLineProbe(const FString& Location, int32 FramesPerWindow, bool& bSuccess)
+{
+	bSuccess = HWBP_SourceLines::Start(Location, true, FramesPerWindow);
+}
+
+void UHardwareBreakpointsBPLibrary::ClearSourceLineWatches()
+{
+	HWBP_SourceLines::Stop();
+}
+
+void UHardwareBreakpointsBPLibrary::StartWriteProfiler(UObject* Object, int32 FramesPerWindow, bool& bSuccess)
+{
+	if (Object == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Tried to start the write profiler on an invalid object"));
+		bSuccess = false;
+		return;
+	}
+	bSuccess = HWBP_WriteProfiler::Start(Object, FramesPerWindow);
+}
+
+void UHardwareBreakpointsBPLibrary::SetRedundantWriteDataBreakpoint(UObject* Object, FString PropertyPath, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle)
+{
+	if (Object == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Tried to set a data breakpoint on an invalid object"));
+		bSuccess = false;
+		return;
+	}
+	FPropertyAddress PropertyAddress = FindPropertyAddress(Object, Object->GetClass(), PropertyPath);
+	if (PropertyAddress.Address == nullptr)
+	{
+		ShowPropertyNotFoundMessageDialog(PropertyPath, Object);
+		bSuccess = false;
+		return;
+	}
+	DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetRedundantWriteDataBreakpoint(PropertyAddress.Address, PropertyAddress.Property->GetSize(), Object);
+	FPlatformHardwareBreakpoints::SetBreakpointLabel(Index, FName(*FString::Printf(TEXT("%s.%s"), *Object->GetName(), *PropertyPath)));
+	BreakpointHandle.SetIndex(Index);
+	bSuccess = Index >= 0;
+}
+
+void UHardwareBreakpointsBPLibrary::LogRedundantWriteReport()
+{
+	HWBP_RedundantWrites::DumpReport();
+}
+
+void UHardwareBreakpointsBPLibrary::StopWriteProfiler()
+{
+	HWBP_WriteProfiler::Stop();
+	HWBP_WriteProfiler::DumpReport();
+}
+
+void UHardwareBreakpointsBPLibrary::StartFalseSharingDetector(UObject* Object, FString PropertyPath, int32 FramesPerPass, bool& bSuccess)
+{
+	if (Object == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Tried to start the false sharing detector on an invalid object"));
+		bSuccess = false;
+		return;
+	}
+	FPropertyAddress PropertyAddress = FindPropertyAddress(Object, Object->GetClass(), PropertyPath);
+	if (PropertyAddress.Address == nullptr)
+	{
+		ShowPropertyNotFoundMessageDialog(PropertyPath, Object);
+		bSuccess = false;
+		return;
+	}
+	bSuccess = HWBP_FalseSharing::Start(PropertyAddress.Address, FramesPerPass);
+}
+
+void UHardwareBreakpointsBPLibrary::StopFalseSharingDetector()
+{
+	HWBP_FalseSharing::Stop();
+	HWBP_FalseSharing::DumpReport();
+}
+
+void UHardwareBreakpointsBPLibrary::SetFunctionLatencyProbe(FString SymbolName, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle)
+{
+	DebugRegisterIndex Index = HWBP_LatencyProbes::ProbeSymbol(SymbolName);
+	BreakpointHandle.SetIndex(Index);
+	bSuccess = Index >= 0;
+}
+
+void UHardwareBreakpointsBPLibrary::LogFunctionLatencyReport()
+{
+	HWBP_LatencyProbes::DumpReport();
+}
+
+void UHardwareBreakpointsBPLibrary::StartOpcodeProfiler()
+{
+	HWBP_OpcodeProfiler::Start();
+}
+
+void UHardwareBreakpointsBPLibrary::StopOpcodeProfiler()
+{
+	HWBP_OpcodeProfiler::Stop();
+	HWBP_OpcodeProfiler::DumpReport();
+}
+
+void UHardwareBreakpointsBPLibrary::StartBlueprintNodeHeatmap()
+{
+	HWBP_NodeHeatmap::Start();
+}
+
+void UHardwareBreakpointsBPLibrary::LogBlueprintNodeHeatmap()
+{
+	HWBP_NodeHeatmap::DumpReport();
+}
+
 namespace HardwareBreakpointsUtils
 {
 	//Used to invalidate all breakpoint handles
 	static int GlobalHandleSalt = 0;
 
-	static int PerSlotHandleSalt[MAX_HARDWARE_BREAKPOINTS] = { 0 };
+	static int PerSlotHandleSalt[FPlatformHardwareBreakpointTraits::NumSlots] = { 0 };
 
 	FDelegateHandle SlotSaltDelegateHandle;
 }
@@ -230,6 +494,14 @@ bool UHardwareBreakpointsBPLibrary::K2_IsBreakpointHandleValid(FHardwareBreakpoi
 	return false;
 }
 
+void UHardwareBreakpointsBPLibrary::SetBreakpointStackDepth(FHardwareBreakpointHandle BreakpointHandle, int32 Depth)
+{
+	if (BreakpointHandle.IsCurrent())
+	{
+		FPlatformHardwareBreakpoints::SetBreakpointStackDepth(BreakpointHandle.GetIndex(), Depth);
+	}
+}
+
 bool UHardwareBreakpointsBPLibrary::AnyHardwareBreakpointSet()
 {
 	return FPlatformHardwareBreakpoints::AnyBreakpointSet();
@@ -240,13 +512,20 @@ void UHardwareBreakpointsBPLibrary::ClearHardwareBreakpoint(FHardwareBreakpointH
 	if (BreakpointHandle.IsCurrent())
 	{
 		FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(BreakpointHandle.GetIndex());
+		HWBP_WildcardWatches::OnBreakpointRemoved(BreakpointHandle.GetIndex());
 	}
 	BreakpointHandle.Clear();
 }
 
 void UHardwareBreakpointsBPLibrary::ClearAllHardwareBreakpoints()
 {
+	//Tools that rotate over slots are stopped first, otherwise they'd take back slots handed out after this
+	HWBP_WriteProfiler::Stop();
+	HWBP_FalseSharing::Stop();
+	HWBP_SourceLines::Stop();
 	FPlatformHardwareBreakpoints::RemoveAllHardwareBreakpoints();
+	HWBP_ScriptBreakpoints::RemoveAll();
+	HWBP_WildcardWatches::RemoveAll();
 	//Invalidate all handles so they can't be used to clear a breakpoint they shouldn't be pointing to
 	++HardwareBreakpointsUtils::GlobalHandleSalt;
 }
@@ -254,7 +533,7 @@ void UHardwareBreakpointsBPLibrary::ClearAllHardwareBreakpoints()
 void FHardwareBreakpointHandle::SetIndex(DebugRegisterIndex Index)
 {
 	RegisterIndex = Index;
-	if (Index >= 0 && Index < MAX_HARDWARE_BREAKPOINTS)
+	if (Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots)
 	{
 		if (!HardwareBreakpointsUtils::SlotSaltDelegateHandle.IsValid())
 		{
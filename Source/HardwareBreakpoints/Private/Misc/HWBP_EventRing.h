@@ -0,0 +1,47 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreMinimal.h"
+
+//Ring of events that the exception handler can append to: storage is allocated up front by Reset, and appending only
+//claims a slot with an atomic increment. Once the ring is full the oldest events are overwritten
+template <typename EventType, uint64 Capacity>
+class THWBP_EventRing
+{
+public:
+	//Allocates the storage and forgets what was recorded. Not safe while events are being appended
+	void Reset()
+	{
+		Events.SetNumZeroed(Capacity);
+		NextEvent.store(0, std::memory_order_relaxed);
+	}
+
+	//Slot for the caller to fill in, null until Reset allocated the storage
+	EventType* Append()
+	{
+		if (Events.Num() == 0)
+		{
+			return nullptr;
+		}
+		return &Events[NextEvent.fetch_add(1, std::memory_order_relaxed) % Capacity];
+	}
+
+	//Events appended since Reset, including the ones that were overwritten
+	uint64 NumAppended() const
+	{
+		return NextEvent.load(std::memory_order_relaxed);
+	}
+
+	//Copy of the events still in the ring, not in append order once it wrapped around
+	TArray<EventType> Snapshot() const
+	{
+		return TArray<EventType>(Events.GetData(), (int32)FMath::Min<uint64>(NumAppended(), Events.Num()));
+	}
+
+private:
+	TArray<EventType> Events;
+	std::atomic<uint64> NextEvent{ 0 };
+};
@@ -0,0 +1,97 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreMinimal.h"
+
+//Base of the entries of a THWBP_LockFreeTable
+struct FHWBP_LockFreeTableEntry
+{
+	//0 means empty. Claimed once with a compare exchange, only cleared by Reset
+	std::atomic<uint64> Key{ 0 };
+	//Set by the thread that claimed the entry once it wrote the entry's own fields. Readers skip entries that aren't ready
+	std::atomic<bool> bReady{ false };
+
+	void Publish()
+	{
+		bReady.store(true, std::memory_order_release);
+	}
+
+	bool IsReady() const
+	{
+		return bReady.load(std::memory_order_acquire);
+	}
+};
+
+//Fixed size open addressing table that the exception handler can record into without allocating or waiting on a lock
+//Keys are hashes chosen by the caller and must never be 0. A key that doesn't find its entry or a free one within MaxProbes is dropped
+//The thread that claims an entry fills in its fields and then calls Publish(). Every other thread only touches the entry's atomics
+template <typename EntryType, uint32 NumEntries, uint32 MaxProbes>
+class THWBP_LockFreeTable
+{
+	static_assert((NumEntries & (NumEntries - 1)) == 0, "NumEntries must be a power of two");
+
+public:
+	//Entry that holds Key, claiming a free one if needed. bOutClaimed tells the caller it has to fill in and publish the entry
+	//Null if the table is too full around Key
+	EntryType* FindOrClaim(uint64 Key, bool& bOutClaimed)
+	{
+		bOutClaimed = false;
+		for (uint32 Probe = 0; Probe < MaxProbes; ++Probe)
+		{
+			EntryType& Entry = Entries[(Key + Probe) & (NumEntries - 1)];
+			uint64 Existing = Entry.Key.load(std::memory_order_acquire);
+			if (Existing == 0 && Entry.Key.compare_exchange_strong(Existing, Key, std::memory_order_acq_rel))
+			{
+				bOutClaimed = true;
+				return &Entry;
+			}
+			//compare_exchange_strong wrote the key of the thread that claimed the entry first into Existing
+			if (Existing == Key)
+			{
+				return &Entry;
+			}
+		}
+		NumDropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	//Calls Visitor with every published entry
+	template <typename VisitorType>
+	void ForEachReady(VisitorType&& Visitor) const
+	{
+		for (const EntryType& Entry : Entries)
+		{
+			if (Entry.IsReady())
+			{
+				Visitor(Entry);
+			}
+		}
+	}
+
+	//Clears the entries in place. ResetEntry clears the caller's fields, it runs after the entry is unpublished and before its key is freed
+	//A record made at the same time may be lost
+	template <typename ResetEntryType>
+	void Reset(ResetEntryType&& ResetEntry)
+	{
+		for (EntryType& Entry : Entries)
+		{
+			Entry.bReady.store(false, std::memory_order_relaxed);
+			ResetEntry(Entry);
+			Entry.Key.store(0, std::memory_order_release);
+		}
+		NumDropped.store(0, std::memory_order_relaxed);
+	}
+
+	//Keys that didn't fit since the last Reset
+	uint32 GetNumDropped() const
+	{
+		return NumDropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	EntryType Entries[NumEntries];
+	std::atomic<uint32> NumDropped{ 0 };
+};
@@ -0,0 +1,16 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+//The core ticker became the thread safe FTSTicker in UE 5.0, with its own handle type
+#if ENGINE_MAJOR_VERSION >= 5
+	using FHWBP_Ticker			= FTSTicker;
+	using FHWBP_TickerHandle	= FTSTicker::FDelegateHandle;
+#else
+	using FHWBP_Ticker			= FTicker;
+	using FHWBP_TickerHandle	= FDelegateHandle;
+#endif
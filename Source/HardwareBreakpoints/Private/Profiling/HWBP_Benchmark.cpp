@@ -0,0 +1,363 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_Benchmark.h"
+
+#include <atomic>
+
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/ThreadManager.h"
+#include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "HWBP_Trace.h"
+#include "Profiling/HWBP_HitLog.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <Windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+namespace HWBP_Benchmark
+{
+	//Arming goes through a helper thread that suspends the caller, it's orders of magnitude slower than a hit
+	static const int32 ArmIterationsDivisor = 20;
+	static const int32 Repeats = 3;
+	//The hit log queue isn't drained while the benchmark runs, stay under its capacity so hits aren't dropped
+	static const int32 MaxHitLogIterations = 5000;
+
+	//Each target on its own cache line, so watches on different targets don't interfere
+	struct alignas(64) FTarget
+	{
+		volatile int32 Value = 0;
+	};
+	static FTarget Targets[FPlatformHardwareBreakpointTraits::NumSlots];
+
+	struct FLatency
+	{
+		double MinNs = 0.0;
+		double MedianNs = 0.0;
+		double P99Ns = 0.0;
+		double MeanNs = 0.0;
+	};
+
+	static double CyclesToNs(double Cycles)
+	{
+		return Cycles * FPlatformTime::GetSecondsPerCycle64() * 1e9;
+	}
+
+	static FLatency Summarize(TArray<uint64>& Samples)
+	{
+		FLatency Result;
+		if (Samples.Num() == 0)
+		{
+			return Result;
+		}
+		Samples.Sort();
+		uint64 Total = 0;
+		for (uint64 Sample : Samples)
+		{
+			Total += Sample;
+		}
+		Result.MinNs = CyclesToNs(Samples[0]);
+		Result.MedianNs = CyclesToNs(Samples[Samples.Num() / 2]);
+		Result.P99Ns = CyclesToNs(Samples[FMath::Min(Samples.Num() - 1, Samples.Num() * 99 / 100)]);
+		Result.MeanNs = CyclesToNs((double)Total / Samples.Num());
+		return Result;
+	}
+
+	static FString LatencyToJson(const FLatency& Latency)
+	{
+		return FString::Printf(TEXT("{\"min_ns\":%.1f,\"median_ns\":%.1f,\"p99_ns\":%.1f,\"mean_ns\":%.1f}"), Latency.MinNs, Latency.MedianNs, Latency.P99Ns, Latency.MeanNs);
+	}
+
+	struct FReport
+	{
+		TArray<FString> Arm;
+		TArray<FString> Hit;
+		TArray<FString> Watches;
+		TArray<FString> Threads;
+		TArray<FString> Stacks;
+
+		void AddLatency(const TCHAR* Name, TArray<uint64>& Samples, TArray<FString>* Section = nullptr)
+		{
+			const FLatency Latency = Summarize(Samples);
+			UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %-28s median %10.1f ns  p99 %10.1f ns"), Name, Latency.MedianNs, Latency.P99Ns);
+			(Section ? *Section : Arm).Add(FString::Printf(TEXT("\"%s\":%s"), Name, *LatencyToJson(Latency)));
+		}
+	};
+
+	//Writes to Targets[0] N times, returns the best of a few runs in cycles
+	static uint64 TimeWrites(int32 Iterations)
+	{
+		uint64 Best = MAX_uint64;
+		for (int32 Repeat = 0; Repeat < Repeats; ++Repeat)
+		{
+			const uint64 Start = FPlatformTime::Cycles64();
+			for (int32 i = 0; i < Iterations; ++i)
+			{
+				Targets[0].Value = i;
+			}
+			Best = FMath::Min(Best, FPlatformTime::Cycles64() - Start);
+		}
+		return Best;
+	}
+
+	static void MeasureArmLatency(int32 Iterations, FReport& Report)
+	{
+		void* Address = (void*)&Targets[0].Value;
+		TArray<uint64> SetSamples, RemoveSamples, QuerySamples, CountersSamples, RemoveAllSamples, AllThreadsSetSamples, AllThreadsRemoveSamples;
+		for (int32 i = 0; i < Iterations; ++i)
+		{
+			uint64 Start = FPlatformTime::Cycles64();
+			DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Write, EHardwareBreakpointSize::Size_4, Address);
+			SetSamples.Add(FPlatformTime::Cycles64() - Start);
+
+			Start = FPlatformTime::Cycles64();
+			const bool bSet = FPlatformHardwareBreakpoints::IsBreakpointSet(Index);
+			QuerySamples.Add(FPlatformTime::Cycles64() - Start);
+
+			FHardwareBreakpointHitCounters Counters;
+			Start = FPlatformTime::Cycles64();
+			FPlatformHardwareBreakpoints::GetHitCounters(Index, Counters);
+			CountersSamples.Add(FPlatformTime::Cycles64() - Start);
+
+			Start = FPlatformTime::Cycles64();
+			FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Index);
+			RemoveSamples.Add(FPlatformTime::Cycles64() - Start);
+			if (Index < 0 || !bSet)
+			{
+				UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Couldn't arm a breakpoint, arm latencies are not meaningful"));
+				break;
+			}
+
+			for (int32 Slot = 0; Slot < FPlatformHardwareBreakpointTraits::NumSlots; ++Slot)
+			{
+				FPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType::Write, EHardwareBreakpointSize::Size_4, (void*)&Targets[Slot].Value);
+			}
+			Start = FPlatformTime::Cycles64();
+			FPlatformHardwareBreakpoints::RemoveAllHardwareBreakpoints();
+			RemoveAllSamples.Add(FPlatformTime::Cycles64() - Start);
+		}
+		//Every thread in the process is suspended and updated, this is the one that scales with thread count
+		for (int32 i = 0; i < FMath::Max(1, Iterations / 10); ++i)
+		{
+			uint64 Start = FPlatformTime::Cycles64();
+			DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetThreadAttributionDataBreakpoint(Address, sizeof(int32));
+			AllThreadsSetSamples.Add(FPlatformTime::Cycles64() - Start);
+			Start = FPlatformTime::Cycles64();
+			FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Index);
+			AllThreadsRemoveSamples.Add(FPlatformTime::Cycles64() - Start);
+		}
+
+		Report.AddLatency(TEXT("set"), SetSamples);
+		Report.AddLatency(TEXT("remove"), RemoveSamples);
+		Report.AddLatency(TEXT("remove_all"), RemoveAllSamples);
+		Report.AddLatency(TEXT("is_set"), QuerySamples);
+		Report.AddLatency(TEXT("get_hit_counters"), CountersSamples);
+		Report.AddLatency(TEXT("set_all_threads"), AllThreadsSetSamples);
+		Report.AddLatency(TEXT("remove_all_threads"), AllThreadsRemoveSamples);
+	}
+
+	static void MeasureHitCost(int32 Iterations, FReport& Report)
+	{
+		void* Address = (void*)&Targets[0].Value;
+		const uint64 Baseline = TimeWrites(Iterations);
+
+		auto Measure = [&](const TCHAR* Mode, DebugRegisterIndex Index, int32 ModeIterations)
+		{
+			if (Index < 0)
+			{
+				UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Couldn't arm a breakpoint for mode %s"), Mode);
+				return;
+			}
+			const uint64 ModeBaseline = ModeIterations == Iterations ? Baseline : TimeWrites(ModeIterations);
+			const uint64 Armed = TimeWrites(ModeIterations);
+			FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Index);
+			const double PerHitNs = CyclesToNs((double)(Armed > ModeBaseline ? Armed - ModeBaseline : 0) / ModeIterations);
+			UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %-28s %10.1f ns/hit"), Mode, PerHitNs);
+			Report.Hit.Add(FString::Printf(TEXT("\"%s\":{\"ns_per_hit\":%.1f}"), Mode, PerHitNs));
+		};
+
+		Measure(TEXT("count_only"), FPlatformHardwareBreakpoints::SetCountingDataBreakpoint(Address, sizeof(int32)), Iterations);
+		Measure(TEXT("redundant_writes"), FPlatformHardwareBreakpoints::SetRedundantWriteDataBreakpoint(Address, sizeof(int32)), Iterations);
+		//A Break mode watch whose condition never passes, the full conditional path short of stopping execution
+		Measure(TEXT("conditional_rejected"), FPlatformHardwareBreakpoints::SetDataBreakpointWithCondition((int32*)Address, [](int32 OldValue, int32 NewValue) { return false; }), Iterations);
+#if HWBP_TRACE_ENABLED
+		//Same count-only hit with the Insights channel on, so each hit also emits its trace events
+		const bool bWasTracing = HardwareBreakpointsChannel.IsEnabled();
+		HardwareBreakpointsChannel.Toggle(true);
+		Measure(TEXT("count_only_trace"), FPlatformHardwareBreakpoints::SetCountingDataBreakpoint(Address, sizeof(int32)), Iterations);
+		HardwareBreakpointsChannel.Toggle(bWasTracing);
+#else
+		Report.Hit.Add(TEXT("\"count_only_trace\":null"));
+#endif
+		if (!HWBP_HitLog::IsRunning())
+		{
+			const FString HitLogFile = FPaths::CreateTempFilename(*FPaths::ProjectSavedDir(), TEXT("HWBP_Benchmark"), TEXT(".hwbl"));
+			if (HWBP_HitLog::Start(HitLogFile))
+			{
+				Measure(TEXT("count_only_hit_log"), FPlatformHardwareBreakpoints::SetCountingDataBreakpoint(Address, sizeof(int32)), FMath::Min(Iterations, MaxHitLogIterations));
+				HWBP_HitLog::Stop();
+				IFileManager::Get().Delete(*HitLogFile);
+			}
+		}
+		//Break mode stops execution on every hit (debugger or callstack window), it can't be timed in a loop
+		Report.Hit.Add(TEXT("\"break\":null"));
+	}
+
+	//Stack walkers on a captured context of this thread, at the hit log's depth. No breakpoint involved, it's the part of a hit that scales with the stack
+	static void MeasureStackCapture(int32 Iterations, FReport& Report)
+	{
+#if PLATFORM_WINDOWS
+		static const uint32 Depth = 16;
+		CONTEXT Context;
+		RtlCaptureContext(&Context);
+		EXCEPTION_POINTERS ExceptionInfo = { nullptr, &Context };
+		uint64 Stack[Depth];
+		auto Measure = [&](const TCHAR* Name, uint32 (*Walk)(uint64*, uint32, struct _EXCEPTION_POINTERS*))
+		{
+			TArray<uint64> Samples;
+			for (int32 i = 0; i < Iterations; ++i)
+			{
+				const uint64 Start = FPlatformTime::Cycles64();
+				Walk(Stack, Depth, &ExceptionInfo);
+				Samples.Add(FPlatformTime::Cycles64() - Start);
+			}
+			Report.AddLatency(Name, Samples, &Report.Stacks);
+		};
+		Measure(TEXT("unwind_tables"), &FPlatformHardwareBreakpoints::UnwindStackBackTrace);
+		Measure(TEXT("frame_pointers"), &FPlatformHardwareBreakpoints::FramePointerStackBackTrace);
+		//Whatever the project settings pick, DbgHelp included
+		Measure(TEXT("configured"), &FPlatformHardwareBreakpoints::CaptureStackBackTrace);
+#endif
+	}
+
+	static void MeasureWatchScaling(int32 Iterations, FReport& Report)
+	{
+		const uint64 Baseline = TimeWrites(Iterations);
+		for (int32 NumWatches = 1; NumWatches <= FPlatformHardwareBreakpointTraits::NumSlots; ++NumWatches)
+		{
+			//Only Targets[0] is written, the other watches only add to the handler's per slot work
+			for (int32 Slot = 0; Slot < NumWatches; ++Slot)
+			{
+				FPlatformHardwareBreakpoints::SetCountingDataBreakpoint((void*)&Targets[Slot].Value, sizeof(int32));
+			}
+			const uint64 Armed = TimeWrites(Iterations);
+			FPlatformHardwareBreakpoints::RemoveAllHardwareBreakpoints();
+			const double PerHitNs = CyclesToNs((double)(Armed > Baseline ? Armed - Baseline : 0) / Iterations);
+			UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %d watches %20s %10.1f ns/hit"), NumWatches, TEXT(""), PerHitNs);
+			Report.Watches.Add(FString::Printf(TEXT("{\"watches\":%d,\"ns_per_hit\":%.1f}"), NumWatches, PerHitNs));
+		}
+	}
+
+	static void MeasureThreadScaling(int32 Iterations, FReport& Report)
+	{
+		const int32 MaxThreads = FMath::Max(1, FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+		for (int32 NumThreads = 1; NumThreads <= MaxThreads; NumThreads *= 2)
+		{
+			//One dedicated thread per writer, all of them waiting on a start barrier, so NumThreads really write at once
+			//They're created before arming, threads created afterwards aren't covered by the all threads watch
+			const int32 WritesPerThread = FMath::Max(1, Iterations / NumThreads);
+			std::atomic<int32> NumReady{ 0 };
+			std::atomic<bool> bGo{ false };
+			TArray<TFuture<void>> Writers;
+			for (int32 Thread = 0; Thread < NumThreads; ++Thread)
+			{
+				Writers.Add(Async(EAsyncExecution::Thread, [WritesPerThread, &NumReady, &bGo]()
+				{
+					++NumReady;
+					while (!bGo)
+					{
+						FPlatformProcess::Yield();
+					}
+					for (int32 i = 0; i < WritesPerThread; ++i)
+					{
+						Targets[0].Value = i;
+					}
+				}));
+			}
+			while (NumReady < NumThreads)
+			{
+				FPlatformProcess::Yield();
+			}
+
+			DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetThreadAttributionDataBreakpoint((void*)&Targets[0].Value, sizeof(int32));
+			const double StartSeconds = FPlatformTime::Seconds();
+			bGo = true;
+			for (TFuture<void>& Writer : Writers)
+			{
+				Writer.Wait();
+			}
+			const double Elapsed = FPlatformTime::Seconds() - StartSeconds;
+			if (Index < 0)
+			{
+				UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Couldn't arm a breakpoint on all threads"));
+				return;
+			}
+			FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Index);
+
+			const double HitsPerSecond = Elapsed > 0.0 ? WritesPerThread * NumThreads / Elapsed : 0.0;
+			UE_LOG(LogHardwareBreakpoints, Display, TEXT("  %d threads %20s %10.0f hits/s"), NumThreads, TEXT(""), HitsPerSecond);
+			Report.Threads.Add(FString::Printf(TEXT("{\"threads\":%d,\"hits_per_second\":%.0f}"), NumThreads, HitsPerSecond));
+		}
+	}
+
+	bool Run(int32 Iterations, const FString& Filename)
+	{
+		if (FPlatformHardwareBreakpoints::AnyBreakpointSet())
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("The benchmark needs every debug register, clear all breakpoints first"));
+			return false;
+		}
+		Iterations = FMath::Max(Iterations, ArmIterationsDivisor);
+
+		FReport Report;
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("Arm/disarm latency:"));
+		MeasureArmLatency(Iterations / ArmIterationsDivisor, Report);
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("Handler cost by mode:"));
+		MeasureHitCost(Iterations, Report);
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("Scaling with watches:"));
+		MeasureWatchScaling(Iterations, Report);
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("Stack capture (16 frames):"));
+		MeasureStackCapture(Iterations / ArmIterationsDivisor, Report);
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("Scaling with threads:"));
+		MeasureThreadScaling(Iterations, Report);
+
+		int32 NumThreads = 0;
+		FThreadManager::Get().ForEachThread([&NumThreads](uint32 ThreadId, FRunnableThread* Thread) { ++NumThreads; });
+		const FString Json = FString::Printf(
+			TEXT("{\n\"format\":1,\n\"date\":\"%s\",\n\"engine\":\"%s\",\n\"configuration\":\"%s\",\n\"platform\":\"%s\",\n\"cpu\":\"%s\",\n\"engine_threads\":%d,\n\"iterations\":%d,\n")
+			TEXT("\"arm\":{%s},\n\"hit\":{%s},\n\"watch_scaling\":[%s],\n\"stack_capture\":{%s},\n\"thread_scaling\":[%s]\n}\n"),
+			*FDateTime::UtcNow().ToIso8601(), *FEngineVersion::Current().ToString(), LexToString(FApp::GetBuildConfiguration()),
+			ANSI_TO_TCHAR(FPlatformProperties::PlatformName()), *FPlatformMisc::GetCPUBrand().TrimStartAndEnd(), NumThreads, Iterations,
+			*FString::Join(Report.Arm, TEXT(",")), *FString::Join(Report.Hit, TEXT(",")), *FString::Join(Report.Watches, TEXT(",")), *FString::Join(Report.Stacks, TEXT(",")), *FString::Join(Report.Threads, TEXT(",")));
+
+		const FString OutputFilename = Filename.IsEmpty()
+			? FPaths::ProfilingDir() / TEXT("HardwareBreakpoints") / FString::Printf(TEXT("Benchmark-%s.json"), *FDateTime::Now().ToString())
+			: Filename;
+		if (!FFileHelper::SaveStringToFile(Json, *OutputFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't write %s"), *OutputFilename);
+			return false;
+		}
+		UE_LOG(LogHardwareBreakpoints, Display, TEXT("Benchmark results written to %s"), *OutputFilename);
+		return true;
+	}
+
+	static FAutoConsoleCommand BenchmarkCommand(
+		TEXT("HWBP.Benchmark"),
+		TEXT("Measures arm/disarm latency and per hit handler cost, and writes the results as JSON. Optionally pass the number of iterations (default 10000) and the file name. Needs every debug register to be free"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			Run(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000, Args.Num() > 1 ? Args[1] : FString());
+		})
+	);
+}
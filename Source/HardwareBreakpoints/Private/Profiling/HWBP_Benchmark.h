@@ -0,0 +1,18 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Measures what the plugin costs, so regressions show up between versions:
+//	- Arm/disarm latency: set, remove, remove all, set on all threads, and queries
+//	- Handler cost per hit for each mode that doesn't stop execution (count only, redundant writes, rejected condition, count only with the trace channel on,
+//	  count only with the hit log recording)
+//	- Scaling of the per hit cost with the number of armed watches, and of hit throughput with the number of threads writing at once
+//	- Cost of capturing a 16 frame callstack with each stack walker
+//Results are logged and written as JSON to the Profiling folder. Needs every debug register to be free
+//Console: HWBP.Benchmark [Iterations] [File]
+namespace HWBP_Benchmark
+{
+	bool Run(int32 Iterations = 10000, const FString& Filename = FString());
+}
@@ -0,0 +1,332 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_ChromeTrace.h"
+
+#include <atomic>
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTLS.h"
+#include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_Ticker.h"
+
+namespace HWBP_ChromeTrace
+{
+	static const uint64 QueueCapacity = 16 * 1024;
+	//Counter tracks are emitted at most this often, the hit instants themselves are never aggregated
+	static const double CounterIntervalSeconds = 0.25;
+	static const int32 MaxCounterWatches = 32;
+
+	enum class EEventKind : uint8
+	{
+		Hit,
+		ProbeEntry,
+		ProbeReturn,
+	};
+
+	struct FQueuedEvent
+	{
+		//Index + 1 of the event stored here once it's fully written, so the reader never sees half written events
+		std::atomic<uint64> Ready{ 0 };
+		uint64 Cycles = 0;
+		uint64 EntryCycles = 0;
+		uint64 ProgramCounter = 0;
+		uint64 FlowId = 0;
+		uint8 OldValue[8] = { 0 };
+		uint8 NewValue[8] = { 0 };
+		const void* Address = nullptr;
+		FName Label;
+		uint32 ThreadId = 0;
+		int8 Slot = -1;
+		uint8 Size = 0;
+		EEventKind Kind = EEventKind::Hit;
+	};
+
+	static FQueuedEvent* Queue = nullptr;
+	static std::atomic<uint64> Head{ 0 };
+	static std::atomic<uint64> Tail{ 0 };
+	static std::atomic<uint64> Dropped{ 0 };
+	static bool bRunning = false;
+
+	static FArchive* Writer = nullptr;
+	static FString OutputFilename;
+	static uint64 StartCycles = 0;
+	static uint32 ProcessId = 0;
+	static double LastCounterTime = 0.0;
+	static TMap<FName, uint32> HitsSinceLastCounter;
+	static FHWBP_TickerHandle TickerHandle;
+
+	//Claims a queue entry, or returns null (and counts a drop) if the writer hasn't caught up
+	static FQueuedEvent* BeginEvent(uint64& OutIndex)
+	{
+		uint64 Index = Head.load(std::memory_order_relaxed);
+		do
+		{
+			if (Index - Tail.load(std::memory_order_acquire) >= QueueCapacity)
+			{
+				Dropped.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+		}
+		while (!Head.compare_exchange_weak(Index, Index + 1, std::memory_order_relaxed));
+		OutIndex = Index;
+		FQueuedEvent& Event = Queue[Index % QueueCapacity];
+		Event.Cycles = FPlatformTime::Cycles64();
+		Event.ThreadId = FPlatformTLS::GetCurrentThreadId();
+		return &Event;
+	}
+
+	static void EndEvent(FQueuedEvent& Event, uint64 Index)
+	{
+		Event.Ready.store(Index + 1, std::memory_order_release);
+	}
+
+	void RecordHit(int32 Slot, FName Label, const void* Address, const uint8* OldValue, int32 Size, uint64 ProgramCounter)
+	{
+		uint64 Index;
+		FQueuedEvent* Event = bRunning ? BeginEvent(Index) : nullptr;
+		if (Event == nullptr)
+		{
+			return;
+		}
+		Size = FMath::Clamp(Size, 0, 8);
+		Event->Kind = EEventKind::Hit;
+		Event->Slot = (int8)Slot;
+		Event->Label = Label;
+		Event->Address = Address;
+		Event->Size = (uint8)Size;
+		Event->ProgramCounter = ProgramCounter;
+		FMemory::Memzero(Event->OldValue);
+		FMemory::Memzero(Event->NewValue);
+		FMemory::Memcpy(Event->OldValue, OldValue, Size);
+		FMemory::Memcpy(Event->NewValue, Address, Size);
+		EndEvent(*Event, Index);
+	}
+
+	void RecordProbeEntry(int32 Slot, FName Label, uint64 FlowId)
+	{
+		uint64 Index;
+		FQueuedEvent* Event = bRunning ? BeginEvent(Index) : nullptr;
+		if (Event == nullptr)
+		{
+			return;
+		}
+		Event->Kind = EEventKind::ProbeEntry;
+		Event->Slot = (int8)Slot;
+		Event->Label = Label;
+		Event->FlowId = FlowId;
+		EndEvent(*Event, Index);
+	}
+
+	void RecordProbeReturn(int32 Slot, FName Label, uint64 FlowId, uint64 EntryCycles)
+	{
+		uint64 Index;
+		FQueuedEvent* Event = bRunning ? BeginEvent(Index) : nullptr;
+		if (Event == nullptr)
+		{
+			return;
+		}
+		Event->Kind = EEventKind::ProbeReturn;
+		Event->Slot = (int8)Slot;
+		Event->Label = Label;
+		Event->FlowId = FlowId;
+		Event->EntryCycles = EntryCycles;
+		EndEvent(*Event, Index);
+	}
+
+	static double ToMicroseconds(uint64 Cycles)
+	{
+		return Cycles > StartCycles ? FPlatformTime::ToMilliseconds64(Cycles - StartCycles) * 1000.0 : 0.0;
+	}
+
+	static FString EscapeJson(const FString& String)
+	{
+		return String.Replace(TEXT("\\"), TEXT("\\\\")).Replace(TEXT("\""), TEXT("\\\""));
+	}
+
+	static FString FormatValue(const uint8* Value, int32 Size)
+	{
+		uint64 Integer = 0;
+		FMemory::Memcpy(&Integer, Value, Size);
+		return FString::Printf(TEXT("0x%llX"), Integer);
+	}
+
+	static void WriteLine(const FString& Line)
+	{
+		FTCHARToUTF8 Utf8(*Line);
+		Writer->Serialize((void*)Utf8.Get(), Utf8.Length());
+		Writer->Serialize((void*)",\n", 2);
+	}
+
+	static FString DescribeLabel(const FQueuedEvent& Event)
+	{
+		return Event.Label.IsNone() ? FString::Printf(TEXT("Slot %d"), Event.Slot) : EscapeJson(Event.Label.ToString());
+	}
+
+	static void WriteEvent(const FQueuedEvent& Event)
+	{
+		const FString Label = DescribeLabel(Event);
+		switch (Event.Kind)
+		{
+		case EEventKind::Hit:
+			WriteLine(FString::Printf(TEXT("{\"name\":\"%s\",\"cat\":\"hit\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"slot\":%d,\"address\":\"%p\",\"old\":\"%s\",\"new\":\"%s\",\"pc\":\"0x%llX\"}}"),
+				*Label, ToMicroseconds(Event.Cycles), ProcessId, Event.ThreadId, Event.Slot, Event.Address,
+				*FormatValue(Event.OldValue, Event.Size), *FormatValue(Event.NewValue, Event.Size), Event.ProgramCounter));
+			++HitsSinceLastCounter.FindOrAdd(Event.Label);
+			break;
+		case EEventKind::ProbeEntry:
+			WriteLine(FString::Printf(TEXT("{\"name\":\"%s\",\"cat\":\"probe\",\"ph\":\"s\",\"id\":%llu,\"ts\":%.3f,\"pid\":%u,\"tid\":%u}"),
+				*Label, Event.FlowId, ToMicroseconds(Event.Cycles), ProcessId, Event.ThreadId));
+			break;
+		case EEventKind::ProbeReturn:
+			//The slice gives the flow arrow something to bind to at both ends
+			WriteLine(FString::Printf(TEXT("{\"name\":\"%s\",\"cat\":\"probe\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"slot\":%d}}"),
+				*Label, ToMicroseconds(Event.EntryCycles), ToMicroseconds(Event.Cycles) - ToMicroseconds(Event.EntryCycles), ProcessId, Event.ThreadId, Event.Slot));
+			WriteLine(FString::Printf(TEXT("{\"name\":\"%s\",\"cat\":\"probe\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%llu,\"ts\":%.3f,\"pid\":%u,\"tid\":%u}"),
+				*Label, Event.FlowId, ToMicroseconds(Event.Cycles), ProcessId, Event.ThreadId));
+			break;
+		}
+	}
+
+	static void WriteCounters(double Now)
+	{
+		const double Elapsed = Now - LastCounterTime;
+		LastCounterTime = Now;
+		if (HitsSinceLastCounter.Num() == 0 || Elapsed <= 0.0)
+		{
+			return;
+		}
+		FString Args;
+		int32 NumWatches = 0;
+		for (const TPair<FName, uint32>& Watch : HitsSinceLastCounter)
+		{
+			if (NumWatches++ == MaxCounterWatches)
+			{
+				break;
+			}
+			Args += FString::Printf(TEXT("%s\"%s\":%.1f"), Args.IsEmpty() ? TEXT("") : TEXT(","), Watch.Key.IsNone() ? TEXT("Unlabeled") : *EscapeJson(Watch.Key.ToString()), Watch.Value / Elapsed);
+		}
+		WriteLine(FString::Printf(TEXT("{\"name\":\"Hits/s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%u,\"args\":{%s}}"), ToMicroseconds(FPlatformTime::Cycles64()), ProcessId, *Args));
+		//Keep the keys, so a watch that stops being hit drops to 0 instead of keeping its last rate
+		for (TPair<FName, uint32>& Watch : HitsSinceLastCounter)
+		{
+			Watch.Value = 0;
+		}
+	}
+
+	static void Drain()
+	{
+		uint64 Index = Tail.load(std::memory_order_relaxed);
+		while (Index < Head.load(std::memory_order_acquire))
+		{
+			FQueuedEvent& Event = Queue[Index % QueueCapacity];
+			if (Event.Ready.load(std::memory_order_acquire) != Index + 1)
+			{
+				//Claimed but still being written, pick it up next time
+				break;
+			}
+			WriteEvent(Event);
+			++Index;
+			Tail.store(Index, std::memory_order_release);
+		}
+		const double Now = FPlatformTime::Seconds();
+		if (Now - LastCounterTime >= CounterIntervalSeconds)
+		{
+			WriteCounters(Now);
+		}
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		Drain();
+		return true;
+	}
+
+	bool Start(const FString& Filename)
+	{
+		Stop();
+		OutputFilename = Filename.IsEmpty()
+			? FPaths::ProfilingDir() / TEXT("HardwareBreakpoints") / FString::Printf(TEXT("Hits-%s.json"), *FDateTime::Now().ToString())
+			: Filename;
+		Writer = IFileManager::Get().CreateFileWriter(*OutputFilename);
+		if (Writer == nullptr)
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't create %s"), *OutputFilename);
+			return false;
+		}
+		if (Queue == nullptr)
+		{
+			Queue = new FQueuedEvent[QueueCapacity];
+		}
+		for (uint64 i = 0; i < QueueCapacity; ++i)
+		{
+			Queue[i].Ready.store(0, std::memory_order_relaxed);
+		}
+		Head = 0;
+		Tail = 0;
+		Dropped = 0;
+		HitsSinceLastCounter.Reset();
+		StartCycles = FPlatformTime::Cycles64();
+		ProcessId = FPlatformProcess::GetCurrentProcessId();
+		LastCounterTime = FPlatformTime::Seconds();
+
+		//JSON array format: the closing bracket is optional, so a capture cut short is still readable
+		Writer->Serialize((void*)"[\n", 2);
+		WriteLine(FString::Printf(TEXT("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"%s\"}}"), ProcessId, FApp::GetProjectName()));
+		TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+		bRunning = true;
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Streaming hits to %s"), *OutputFilename);
+		return true;
+	}
+
+	void Stop()
+	{
+		if (!bRunning)
+		{
+			return;
+		}
+		bRunning = false;
+		FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+		Drain();
+		WriteCounters(FPlatformTime::Seconds());
+		if (Dropped.load() > 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("%llu hits were dropped, the queue filled up between frames"), Dropped.load());
+		}
+		WriteLine(FString::Printf(TEXT("{\"name\":\"dropped_hits\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"count\":%llu}}"), ProcessId, Dropped.load()));
+		Writer->Serialize((void*)"{}]\n", 4);
+		Writer->Close();
+		delete Writer;
+		Writer = nullptr;
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Hits written to %s"), *OutputFilename);
+	}
+
+	bool IsRunning()
+	{
+		return bRunning;
+	}
+
+	static FAutoConsoleCommand StartCommand(
+		TEXT("HWBP.ChromeTrace.Start"),
+		TEXT("Streams breakpoint hits to a Chrome trace / Perfetto JSON file. Optionally pass the file name, defaults to the Profiling folder"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			Start(Args.Num() > 0 ? Args[0] : FString());
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.ChromeTrace.Stop"),
+		TEXT("Stops streaming breakpoint hits and closes the JSON file"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+		})
+	);
+}
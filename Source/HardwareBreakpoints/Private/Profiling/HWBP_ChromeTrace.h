@@ -0,0 +1,22 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Streams recorded hits to a Chrome trace event / Perfetto JSON file, for when Unreal Insights isn't at hand
+//(open it in chrome://tracing or ui.perfetto.dev). Each hit is an instant event with its old/new value, slot, call site and watch label,
+//hit rates per watch are emitted as counter tracks, and latency probe calls as slices with flow arrows from entry to return
+//The exception handler only pushes to a fixed size queue, which is drained to disk every frame, so memory stays bounded on long captures
+//Console: HWBP.ChromeTrace.Start [File], HWBP.ChromeTrace.Stop
+namespace HWBP_ChromeTrace
+{
+	bool Start(const FString& Filename = FString());
+	void Stop();
+	bool IsRunning();
+
+	//These are called from the exception handler, they don't allocate or lock
+	void RecordHit(int32 Slot, FName Label, const void* Address, const uint8* OldValue, int32 Size, uint64 ProgramCounter);
+	void RecordProbeEntry(int32 Slot, FName Label, uint64 FlowId);
+	void RecordProbeReturn(int32 Slot, FName Label, uint64 FlowId, uint64 EntryCycles);
+}
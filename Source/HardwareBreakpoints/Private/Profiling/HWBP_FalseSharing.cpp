@@ -0,0 +1,313 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_FalseSharing.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/ThreadManager.h"
+
+#include "CallStackViewer.h"
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_EventRing.h"
+#include "Misc/HWBP_Ticker.h"
+
+namespace HWBP_FalseSharing
+{
+	static const int32 ChunkSize = 8;
+	static const int32 NumChunks = CacheLineSize / ChunkSize;
+	static const uint64 MaxEvents = 1 << 16;
+
+	struct FWriteEvent
+	{
+		uint64 Cycles;
+		uint32 ThreadId;
+		uint8 Offset;
+		uint8 Size;
+	};
+
+	static THWBP_EventRing<FWriteEvent, MaxEvents> Events;
+	static uint8* LineBase = nullptr;
+
+	static_assert(NumChunks <= 8, "Passes are stored as 8 bit chunk masks");
+
+	struct FArmedChunk
+	{
+		DebugRegisterIndex Slot;
+		//Tells the chunk apart from a breakpoint that was set in the same slot after ours was removed from somewhere else
+		const void* Address;
+	};
+	static TArray<FArmedChunk, TInlineAllocator<FPlatformHardwareBreakpointTraits::NumSlots>> ArmedSlots;
+	//Chunks armed by each pass. Every pair of chunks is watched together in at least one pass, writes to two chunks can only
+	//be seen interleaving while both are watched
+	static TArray<uint8> Passes;
+	static int32 NextPass = 0;
+	static int32 CompletedPasses = 0;
+	static int32 FramesPerPass = 60;
+	static int32 FramesInPass = 0;
+	static FHWBP_TickerHandle TickerHandle;
+	static FDelegateHandle RemoveBreakpointHandle;
+
+	static void DisarmPass()
+	{
+		for (const FArmedChunk& Armed : ArmedSlots)
+		{
+			if (FPlatformHardwareBreakpoints::GetBreakpointAddress(Armed.Slot) == Armed.Address)
+			{
+				FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Armed.Slot);
+			}
+		}
+		ArmedSlots.Reset();
+	}
+
+	//A slot removed from somewhere else (callstack window, owner reclaim) can be handed to another breakpoint right away,
+	//so it's forgotten instead of being removed again when the pass ends
+	static void OnBreakpointRemoved(DebugRegisterIndex Index)
+	{
+		ArmedSlots.RemoveAll([Index](const FArmedChunk& Armed) { return Armed.Slot == Index; });
+	}
+
+	//Splits the line in groups of half the free slots, and pairs up every two groups: with 4 free slots that's 6 passes of 4 chunks
+	static void PlanPasses(int32 FreeSlots)
+	{
+		Passes.Reset();
+		const int32 GroupSize = FMath::Max(1, FreeSlots / 2);
+		const int32 NumGroups = FMath::DivideAndRoundUp(NumChunks, GroupSize);
+		auto GroupMask = [GroupSize](int32 Group)
+		{
+			uint8 Mask = 0;
+			for (int32 Chunk = Group * GroupSize; Chunk < FMath::Min((Group + 1) * GroupSize, NumChunks); ++Chunk)
+			{
+				Mask |= (uint8)(1 << Chunk);
+			}
+			return Mask;
+		};
+		if (FreeSlots < 2 || NumGroups == 1)
+		{
+			//With a single slot no two chunks are ever watched together, only interleavings on the same chunk can be seen
+			for (int32 Group = 0; Group < NumGroups; ++Group)
+			{
+				Passes.Add(GroupMask(Group));
+			}
+			return;
+		}
+		for (int32 First = 0; First < NumGroups; ++First)
+		{
+			for (int32 Second = First + 1; Second < NumGroups; ++Second)
+			{
+				Passes.Add((uint8)(GroupMask(First) | GroupMask(Second)));
+			}
+		}
+	}
+
+	//Arms the chunks of the next pass. If a slot was taken since the passes were planned, the pass is only partially watched
+	static void ArmNextPass()
+	{
+		const uint8 Mask = Passes[NextPass];
+		for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+		{
+			if ((Mask & (1 << Chunk)) == 0)
+			{
+				continue;
+			}
+			uint8* ChunkAddress = LineBase + Chunk * ChunkSize;
+			DebugRegisterIndex Slot = FPlatformHardwareBreakpoints::SetThreadAttributionDataBreakpoint(ChunkAddress, ChunkSize);
+			if (Slot < 0)
+			{
+				break;
+			}
+			ArmedSlots.Add({ Slot, ChunkAddress });
+		}
+		if (ArmedSlots.Num() == 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("False sharing detector couldn't arm any breakpoint, all slots are in use"));
+		}
+		NextPass = (NextPass + 1) % Passes.Num();
+		FramesInPass = 0;
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		if (++FramesInPass >= FramesPerPass && Passes.Num() > 1)
+		{
+			DisarmPass();
+			++CompletedPasses;
+			ArmNextPass();
+		}
+		return true;
+	}
+
+	bool Start(const void* Address, int32 InFramesPerPass)
+	{
+		Stop();
+		if (Address == nullptr)
+		{
+			return false;
+		}
+		LineBase = (uint8*)AlignDown(Address, CacheLineSize);
+		Events.Reset();
+		FramesPerPass = FMath::Max(1, InFramesPerPass);
+
+		//Counts the free slots by arming the line as far as they go
+		Passes.Reset();
+		Passes.Add((uint8)((1 << NumChunks) - 1));
+		NextPass = 0;
+		ArmNextPass();
+		const int32 FreeSlots = ArmedSlots.Num();
+		DisarmPass();
+		if (FreeSlots == 0)
+		{
+			return false;
+		}
+		PlanPasses(FreeSlots);
+		NextPass = 0;
+		CompletedPasses = 0;
+		ArmNextPass();
+		TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+		RemoveBreakpointHandle = CallStackViewer::OnRemoveBreakpoint.AddStatic(&OnBreakpointRemoved);
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Watching cache line %p on all threads, %d of %d bytes per pass, %d passes of %d frames"),
+			LineBase, ArmedSlots.Num() * ChunkSize, CacheLineSize, Passes.Num(), FramesPerPass);
+		return true;
+	}
+
+	void Stop()
+	{
+		if (TickerHandle.IsValid())
+		{
+			FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+		}
+		if (RemoveBreakpointHandle.IsValid())
+		{
+			CallStackViewer::OnRemoveBreakpoint.Remove(RemoveBreakpointHandle);
+			RemoveBreakpointHandle.Reset();
+		}
+		DisarmPass();
+	}
+
+	bool IsRunning()
+	{
+		return TickerHandle.IsValid();
+	}
+
+	void RecordWrite(const void* WatchedAddress, int32 WatchedSize, const uint8* PreviousValue, const uint8* CurrentValue, uint64 ProgramCounter)
+	{
+		FWriteEvent* Event = Events.Append();
+		if (Event == nullptr)
+		{
+			return;
+		}
+		//The hardware only tells us the watched chunk was written, the bytes that changed narrow it down to the field
+		const uint8* Current = CurrentValue;
+		const uint8* LastValue = PreviousValue;
+		int32 FirstChanged = 0;
+		int32 LastChanged = WatchedSize - 1;
+		while (FirstChanged < WatchedSize && Current[FirstChanged] == LastValue[FirstChanged])
+		{
+			++FirstChanged;
+		}
+		if (FirstChanged == WatchedSize)
+		{
+			//Same value written, we can't tell which bytes, so attribute the whole chunk
+			FirstChanged = 0;
+		}
+		else
+		{
+			while (LastChanged > FirstChanged && Current[LastChanged] == LastValue[LastChanged])
+			{
+				--LastChanged;
+			}
+		}
+
+		Event->Cycles = FPlatformTime::Cycles64();
+		Event->ThreadId = FPlatformTLS::GetCurrentThreadId();
+		Event->Offset = (uint8)((const uint8*)WatchedAddress + FirstChanged - LineBase);
+		Event->Size = (uint8)(LastChanged - FirstChanged + 1);
+	}
+
+	static FString GetThreadDescription(uint32 ThreadId)
+	{
+		const FString& ThreadName = FThreadManager::GetThreadName(ThreadId);
+		return ThreadName.IsEmpty() ? FString::Printf(TEXT("Thread %u"), ThreadId) : FString::Printf(TEXT("%s (%u)"), *ThreadName, ThreadId);
+	}
+
+	void DumpReport(int32 MaxPairs)
+	{
+		TArray<FWriteEvent> Sorted = Events.Snapshot();
+		Sorted.Sort([](const FWriteEvent& A, const FWriteEvent& B) { return A.Cycles < B.Cycles; });
+
+		struct FPairStats
+		{
+			uint32 Count = 0;
+			uint64 TotalCycles = 0;
+		};
+		//Key: writer thread/offset followed by the other thread/offset that wrote the line next
+		TMap<TTuple<uint32, uint8, uint32, uint8>, FPairStats> Pairs;
+		TMap<uint32, uint32> WritesPerThread;
+		uint32 FalseSharing = 0;
+		uint32 TrueSharing = 0;
+		for (int32 i = 0; i < Sorted.Num(); ++i)
+		{
+			++WritesPerThread.FindOrAdd(Sorted[i].ThreadId);
+			if (i == 0 || Sorted[i].ThreadId == Sorted[i - 1].ThreadId)
+			{
+				continue;
+			}
+			const FWriteEvent& Previous = Sorted[i - 1];
+			const FWriteEvent& Current = Sorted[i];
+			const bool bOverlap = Current.Offset < Previous.Offset + Previous.Size && Previous.Offset < Current.Offset + Current.Size;
+			(bOverlap ? TrueSharing : FalseSharing)++;
+			FPairStats& PairStats = Pairs.FindOrAdd(MakeTuple(Previous.ThreadId, Previous.Offset, Current.ThreadId, Current.Offset));
+			++PairStats.Count;
+			PairStats.TotalCycles += Current.Cycles - Previous.Cycles;
+		}
+
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= CACHE LINE %p ============="), LineBase);
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("%d writes recorded, %u cross-thread interleavings: %u false sharing (different bytes), %u true sharing (same bytes)"),
+			Sorted.Num(), FalseSharing + TrueSharing, FalseSharing, TrueSharing);
+		if (Passes.Num() > 1)
+		{
+			//Each pair of chunks shares at least one pass, so interleavings between any two fields show up once every pass ran
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("Only chunks watched in the same pass can interleave. %d of %d passes completed%s"),
+				FMath::Min(CompletedPasses, Passes.Num()), Passes.Num(), CompletedPasses < Passes.Num() ? TEXT(", some pairs of chunks haven't been watched together yet") : TEXT(""));
+		}
+		for (const TPair<uint32, uint32>& ThreadWrites : WritesPerThread)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %s: %u writes"), *GetThreadDescription(ThreadWrites.Key), ThreadWrites.Value);
+		}
+
+		Pairs.ValueSort([](const FPairStats& A, const FPairStats& B) { return A.Count > B.Count; });
+		int32 NumPrinted = 0;
+		for (const auto& Pair : Pairs)
+		{
+			if (NumPrinted++ >= MaxPairs)
+			{
+				break;
+			}
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %u x %s wrote +%u, then %s wrote +%u, %.2f us apart on average"),
+				Pair.Value.Count,
+				*GetThreadDescription(Pair.Key.Get<0>()), Pair.Key.Get<1>(),
+				*GetThreadDescription(Pair.Key.Get<2>()), Pair.Key.Get<3>(),
+				FPlatformTime::ToMilliseconds64(Pair.Value.TotalCycles / Pair.Value.Count) * 1000.0);
+		}
+	}
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.FalseSharing.Report"),
+		TEXT("Prints cross-thread write interleavings on the cache line watched by the false sharing detector"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			DumpReport();
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.FalseSharing.Stop"),
+		TEXT("Stops the false sharing detector and prints its report"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+			DumpReport();
+		})
+	);
+}
@@ -0,0 +1,26 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Confirms false sharing on a cache line before redesigning a struct layout
+//Watches the 64 byte line containing an address on all threads, and records which thread wrote which offset and when
+//Debug registers can only cover 4 x 8 bytes at once, so the line is watched in passes that rotate every few frames,
+//chosen so that every pair of 8 byte chunks is watched together in one of them
+//The report lists cross-thread write interleavings on the line, split into false sharing (different bytes) and true sharing (same bytes)
+//Console: HWBP.FalseSharing.Report, HWBP.FalseSharing.Stop
+namespace HWBP_FalseSharing
+{
+	static constexpr int32 CacheLineSize = 64;
+
+	bool Start(const void* Address, int32 FramesPerPass = 60);
+	void Stop();
+	bool IsRunning();
+
+	//Called from the exception handler for ThreadAttribution breakpoints, doesn't allocate or lock
+	//PreviousValue and CurrentValue are snapshots taken by the caller, the watched memory may be changing on other threads
+	void RecordWrite(const void* WatchedAddress, int32 WatchedSize, const uint8* PreviousValue, const uint8* CurrentValue, uint64 ProgramCounter);
+
+	void DumpReport(int32 MaxPairs = 10);
+}
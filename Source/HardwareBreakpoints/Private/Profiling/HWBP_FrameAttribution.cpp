@@ -0,0 +1,213 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_FrameAttribution.h"
+
+#include "Engine/EngineBaseTypes.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/ThreadManager.h"
+#include "Misc/CoreGlobals.h"
+
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_EventRing.h"
+
+namespace HWBP_FrameAttribution
+{
+	static const uint64 MaxEvents = 1 << 16;
+	//Tick group slot for hits outside of the world tick (slate, input, end of frame updates...)
+	static const uint8 OutsideWorldTick = TG_MAX;
+
+	enum class EThreadRole : uint8
+	{
+		Game,
+		Rendering,
+		RHI,
+		Other,
+	};
+
+	struct FHitEvent
+	{
+		FName Label;
+		const void* Watched;
+		uint64 Frame;
+		uint32 ThreadId;
+		uint8 TickGroup;
+		EThreadRole ThreadRole;
+	};
+
+	static THWBP_EventRing<FHitEvent, MaxEvents> Events;
+	static bool bRunning = false;
+
+	void Start()
+	{
+		Events.Reset();
+		bRunning = true;
+	}
+
+	void Stop()
+	{
+		bRunning = false;
+	}
+
+	bool IsRunning()
+	{
+		return bRunning;
+	}
+
+	static EThreadRole GetThreadRole()
+	{
+		if (IsInGameThread())
+		{
+			return EThreadRole::Game;
+		}
+		if (IsInActualRenderingThread())
+		{
+			return EThreadRole::Rendering;
+		}
+		if (IsInRHIThread())
+		{
+			return EThreadRole::RHI;
+		}
+		return EThreadRole::Other;
+	}
+
+	void RecordHit(FName Label, const void* Watched)
+	{
+		if (!bRunning)
+		{
+			return;
+		}
+		//Tick functions on worker threads run while the game thread waits for their tick group, so the world's group applies to them too
+		const UWorld* World = GWorld.GetReference();
+		FHitEvent* Event = Events.Append();
+		Event->Label = Label;
+		Event->Watched = Watched;
+		Event->Frame = GFrameCounter;
+		Event->ThreadId = FPlatformTLS::GetCurrentThreadId();
+		Event->TickGroup = World && World->bInTick ? (uint8)World->TickGroup : OutsideWorldTick;
+		Event->ThreadRole = GetThreadRole();
+	}
+
+	static FString DescribeTickGroup(uint8 TickGroup)
+	{
+		if (TickGroup == OutsideWorldTick)
+		{
+			return TEXT("Outside world tick");
+		}
+		return UEnum::GetValueAsString((ETickingGroup)TickGroup);
+	}
+
+	static FString DescribeThread(EThreadRole Role, uint32 ThreadId)
+	{
+		switch (Role)
+		{
+		case EThreadRole::Game: return TEXT("Game thread");
+		case EThreadRole::Rendering: return TEXT("Rendering thread");
+		case EThreadRole::RHI: return TEXT("RHI thread");
+		default:
+			{
+				const FString& ThreadName = FThreadManager::GetThreadName(ThreadId);
+				return ThreadName.IsEmpty() ? FString::Printf(TEXT("Thread %u"), ThreadId) : ThreadName;
+			}
+		}
+	}
+
+	void DumpReport()
+	{
+		TArray<FHitEvent> Sorted = Events.Snapshot();
+		//Grouped by watch, then in frame order
+		Sorted.Sort([](const FHitEvent& A, const FHitEvent& B)
+		{
+			return A.Watched != B.Watched ? A.Watched < B.Watched : A.Frame < B.Frame;
+		});
+
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= HITS PER FRAME AND TICK GROUP ============="));
+		if (Events.NumAppended() > MaxEvents)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("Only the last %llu of %llu hits are kept"), MaxEvents, Events.NumAppended());
+		}
+		for (int32 GroupStart = 0; GroupStart < Sorted.Num();)
+		{
+			TMap<uint8, uint32> PerTickGroup;
+			TMap<FString, uint32> PerThread;
+			uint32 Frames = 0;
+			uint32 FramesWithSeveralWrites = 0;
+			uint32 FramesWithSeveralTickGroups = 0;
+			uint32 MaxWritesInFrame = 0;
+			uint64 MaxWritesFrame = 0;
+
+			int32 GroupEnd = GroupStart;
+			while (GroupEnd < Sorted.Num() && Sorted[GroupEnd].Watched == Sorted[GroupStart].Watched)
+			{
+				//One frame at a time
+				const uint64 Frame = Sorted[GroupEnd].Frame;
+				uint32 WritesInFrame = 0;
+				uint32 TickGroupsInFrame = 0;
+				for (; GroupEnd < Sorted.Num() && Sorted[GroupEnd].Watched == Sorted[GroupStart].Watched && Sorted[GroupEnd].Frame == Frame; ++GroupEnd)
+				{
+					const FHitEvent& Event = Sorted[GroupEnd];
+					++WritesInFrame;
+					TickGroupsInFrame |= 1u << Event.TickGroup;
+					++PerTickGroup.FindOrAdd(Event.TickGroup);
+					++PerThread.FindOrAdd(DescribeThread(Event.ThreadRole, Event.ThreadId));
+				}
+				++Frames;
+				FramesWithSeveralWrites += WritesInFrame > 1 ? 1 : 0;
+				FramesWithSeveralTickGroups += FMath::CountBits(TickGroupsInFrame) > 1 ? 1 : 0;
+				if (WritesInFrame > MaxWritesInFrame)
+				{
+					MaxWritesInFrame = WritesInFrame;
+					MaxWritesFrame = Frame;
+				}
+			}
+
+			const FHitEvent& First = Sorted[GroupStart];
+			const uint32 Total = GroupEnd - GroupStart;
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s: %u hits in %u frames, %.2f per frame, max %u in frame %llu"),
+				First.Label.IsNone() ? *FString::Printf(TEXT("%p"), First.Watched) : *First.Label.ToString(),
+				Total, Frames, (double)Total / Frames, MaxWritesInFrame, MaxWritesFrame);
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("    Written more than once in %u frames, from more than one tick group in %u frames"),
+				FramesWithSeveralWrites, FramesWithSeveralTickGroups);
+			PerTickGroup.KeySort([](uint8 A, uint8 B) { return A < B; });
+			for (const TPair<uint8, uint32>& TickGroup : PerTickGroup)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %-24s %8u (%.1f%%)"), *DescribeTickGroup(TickGroup.Key), TickGroup.Value, 100.0 * TickGroup.Value / Total);
+			}
+			PerThread.ValueSort([](uint32 A, uint32 B) { return A > B; });
+			for (const TPair<FString, uint32>& Thread : PerThread)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %-24s %8u (%.1f%%)"), *Thread.Key, Thread.Value, 100.0 * Thread.Value / Total);
+			}
+			GroupStart = GroupEnd;
+		}
+	}
+
+	static FAutoConsoleCommand StartCommand(
+		TEXT("HWBP.FrameAttribution.Start"),
+		TEXT("Starts tagging count-only data breakpoint hits with frame, tick group and thread"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Start();
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.FrameAttribution.Stop"),
+		TEXT("Stops tagging hits and prints the per frame and tick group breakdown"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+			DumpReport();
+		})
+	);
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.FrameAttribution.Report"),
+		TEXT("Prints the per frame and tick group breakdown of hits"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			DumpReport();
+		})
+	);
+}
@@ -0,0 +1,21 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Puts hits in frame context: every hit of a count-only data breakpoint is tagged with the frame number, the world's tick group
+//and the role of the writing thread. The report breaks writes down per tick phase and shows how often a watched property
+//is written several times per frame, or from several tick groups in the same frame, which usually means wasted work
+//Console: HWBP.FrameAttribution.Start, HWBP.FrameAttribution.Stop, HWBP.FrameAttribution.Report
+namespace HWBP_FrameAttribution
+{
+	void Start();
+	void Stop();
+	bool IsRunning();
+
+	//Safe to call from the exception handler, doesn't allocate or lock
+	void RecordHit(FName Label, const void* Watched);
+
+	void DumpReport();
+}
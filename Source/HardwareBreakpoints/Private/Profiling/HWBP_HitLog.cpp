@@ -0,0 +1,352 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_HitLog.h"
+
+#include <atomic>
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/ThreadManager.h"
+#include "Misc/CoreGlobals.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "Profiling/HWBP_HitLogFormat.h"
+#include "Profiling/HWBP_MappedFileWriter.h"
+#include "Misc/HWBP_Ticker.h"
+
+namespace HWBP_HitLog
+{
+	using namespace HWBP_HitLogFormat;
+
+	static const uint64 QueueCapacity = 16 * 1024;
+	static const int32 MaxStackDepth = 16;
+
+	struct FQueuedHit
+	{
+		//Index + 1 of the hit stored here once it's fully written, so the reader never sees half written hits
+		std::atomic<uint64> Ready{ 0 };
+		uint64 Cycles = 0;
+		uint64 Frame = 0;
+		uint64 ProgramCounter = 0;
+		uint64 Stack[MaxStackDepth] = { 0 };
+		FName Label;
+		uint32 ThreadId = 0;
+		uint8 NewValue[8] = { 0 };
+		int8 Slot = -1;
+		uint8 Size = 0;
+		uint8 StackDepth = 0;
+	};
+
+	static FQueuedHit* Queue = nullptr;
+	static std::atomic<uint64> Head{ 0 };
+	static std::atomic<uint64> Tail{ 0 };
+	static std::atomic<uint64> Dropped{ 0 };
+	static bool bRunning = false;
+	static bool bStacks = false;
+
+	static FHWBP_MappedFileWriter Writer;
+	static FString OutputFilename;
+	static FHWBP_TickerHandle TickerHandle;
+
+	//Interning tables and delta state, only touched from the game thread
+	static TMap<FName, uint32> StringIds;
+	static TMap<uint64, uint32> ProgramCounterIds;
+	static TMap<uint32, uint32> StackIds;
+	static TSet<uint32> KnownThreads;
+	static uint64 LastCycles = 0;
+	static uint64 LastFrame = 0;
+	static uint64 NumHits = 0;
+	static TArray<uint8> Scratch;
+
+	void RecordHit(int32 Slot, FName Label, const void* Address, int32 Size, uint64 ProgramCounter, struct _EXCEPTION_POINTERS* ExceptionInfo)
+	{
+		if (!bRunning)
+		{
+			return;
+		}
+		uint64 Index = Head.load(std::memory_order_relaxed);
+		do
+		{
+			if (Index - Tail.load(std::memory_order_acquire) >= QueueCapacity)
+			{
+				Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		while (!Head.compare_exchange_weak(Index, Index + 1, std::memory_order_relaxed));
+
+		FQueuedHit& Hit = Queue[Index % QueueCapacity];
+		Hit.Cycles = FPlatformTime::Cycles64();
+		Hit.Frame = GFrameCounter;
+		Hit.ThreadId = FPlatformTLS::GetCurrentThreadId();
+		Hit.Slot = (int8)Slot;
+		Hit.Label = Label;
+		Hit.ProgramCounter = ProgramCounter;
+		Hit.Size = (uint8)FMath::Clamp(Size, 0, 8);
+		FMemory::Memzero(Hit.NewValue);
+		if (Address)
+		{
+			FMemory::Memcpy(Hit.NewValue, Address, Hit.Size);
+		}
+		const int32 BreakpointDepth = FPlatformHardwareBreakpoints::GetBreakpointStackDepth(Slot);
+		const uint32 Depth = BreakpointDepth > 0 ? FMath::Min(BreakpointDepth, MaxStackDepth) : MaxStackDepth;
+		Hit.StackDepth = bStacks ? (uint8)FPlatformHardwareBreakpoints::CaptureStackBackTrace(Hit.Stack, Depth, ExceptionInfo) : 0;
+		Hit.Ready.store(Index + 1, std::memory_order_release);
+	}
+
+	static void WriteString(uint32 Id, const FString& String)
+	{
+		FTCHARToUTF8 Utf8(*String);
+		Scratch.Add((uint8)ERecordTag::String);
+		WriteVarint(Scratch, Id);
+		WriteVarint(Scratch, Utf8.Length());
+		Scratch.Append((const uint8*)Utf8.Get(), Utf8.Length());
+	}
+
+	static uint32 InternLabel(FName Label)
+	{
+		if (const uint32* Id = StringIds.Find(Label))
+		{
+			return *Id;
+		}
+		//Ids start at 1, 0 is left for "none" in every table
+		const uint32 Id = StringIds.Num() + 1;
+		StringIds.Add(Label, Id);
+		WriteString(Id, Label.IsNone() ? FString() : Label.ToString());
+		return Id;
+	}
+
+	static uint32 InternProgramCounter(uint64 ProgramCounter)
+	{
+		if (const uint32* Id = ProgramCounterIds.Find(ProgramCounter))
+		{
+			return *Id;
+		}
+		const uint32 Id = ProgramCounterIds.Num() + 1;
+		ProgramCounterIds.Add(ProgramCounter, Id);
+		Scratch.Add((uint8)ERecordTag::ProgramCounter);
+		WriteVarint(Scratch, Id);
+		WriteVarint(Scratch, ProgramCounter);
+		return Id;
+	}
+
+	static uint32 InternStack(const uint64* Stack, int32 Depth)
+	{
+		if (Depth == 0)
+		{
+			return 0;
+		}
+		uint32 PCIds[MaxStackDepth];
+		for (int32 i = 0; i < Depth; ++i)
+		{
+			PCIds[i] = InternProgramCounter(Stack[i]);
+		}
+		//Stacks are keyed by the hash of their frame ids, a collision only merges two stacks in the report
+		const uint32 Hash = FCrc::MemCrc32(PCIds, Depth * sizeof(uint32), Depth);
+		if (const uint32* Id = StackIds.Find(Hash))
+		{
+			return *Id;
+		}
+		const uint32 Id = StackIds.Num() + 1;
+		StackIds.Add(Hash, Id);
+		Scratch.Add((uint8)ERecordTag::Stack);
+		WriteVarint(Scratch, Id);
+		WriteVarint(Scratch, Depth);
+		for (int32 i = 0; i < Depth; ++i)
+		{
+			WriteVarint(Scratch, PCIds[i]);
+		}
+		return Id;
+	}
+
+	static void InternThread(uint32 ThreadId)
+	{
+		bool bAlreadyKnown = false;
+		KnownThreads.Add(ThreadId, &bAlreadyKnown);
+		if (bAlreadyKnown)
+		{
+			return;
+		}
+		const FString& ThreadName = FThreadManager::GetThreadName(ThreadId);
+		const uint32 NameId = InternLabel(FName(ThreadName.IsEmpty() ? *FString::Printf(TEXT("Thread %u"), ThreadId) : *ThreadName));
+		Scratch.Add((uint8)ERecordTag::Thread);
+		WriteVarint(Scratch, ThreadId);
+		WriteVarint(Scratch, NameId);
+	}
+
+	static void EncodeHit(const FQueuedHit& Hit)
+	{
+		InternThread(Hit.ThreadId);
+		const uint32 LabelId = InternLabel(Hit.Label);
+		const uint32 ProgramCounterId = InternProgramCounter(Hit.ProgramCounter);
+		const uint32 StackId = InternStack(Hit.Stack, Hit.StackDepth);
+
+		//Hits from other threads can be queued slightly out of order, clamp instead of wrapping around
+		const uint64 DeltaCycles = Hit.Cycles > LastCycles ? Hit.Cycles - LastCycles : 0;
+		const uint64 DeltaFrame = Hit.Frame > LastFrame ? Hit.Frame - LastFrame : 0;
+		LastCycles = FMath::Max(LastCycles, Hit.Cycles);
+		LastFrame = FMath::Max(LastFrame, Hit.Frame);
+
+		Scratch.Add((uint8)ERecordTag::Hit);
+		WriteVarint(Scratch, DeltaCycles);
+		WriteVarint(Scratch, DeltaFrame);
+		WriteVarint(Scratch, Hit.ThreadId);
+		WriteVarint(Scratch, (uint8)Hit.Slot);
+		WriteVarint(Scratch, LabelId);
+		WriteVarint(Scratch, ProgramCounterId);
+		WriteVarint(Scratch, StackId);
+		WriteVarint(Scratch, Hit.Size);
+		Scratch.Append(Hit.NewValue, Hit.Size);
+		++NumHits;
+	}
+
+	static void Drain()
+	{
+		Scratch.Reset();
+		uint64 Index = Tail.load(std::memory_order_relaxed);
+		while (Index < Head.load(std::memory_order_acquire))
+		{
+			FQueuedHit& Hit = Queue[Index % QueueCapacity];
+			if (Hit.Ready.load(std::memory_order_acquire) != Index + 1)
+			{
+				//Claimed but still being written, pick it up next time
+				break;
+			}
+			EncodeHit(Hit);
+			++Index;
+			Tail.store(Index, std::memory_order_release);
+		}
+		if (Scratch.Num() > 0)
+		{
+			Writer.Append(Scratch.GetData(), Scratch.Num());
+		}
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		Drain();
+		return true;
+	}
+
+	static void WriteHeader()
+	{
+		TArray<FStackWalkModuleInfo> Modules;
+		Modules.SetNum(FPlatformStackWalk::GetProcessModuleCount());
+		Modules.SetNum(FPlatformStackWalk::GetProcessModuleSignatures(Modules.GetData(), Modules.Num()));
+
+		FHeader Header;
+		Header.SecondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+		Header.StartCycles = LastCycles;
+		Header.StartFrame = LastFrame;
+		Header.NumModules = Modules.Num();
+		Writer.Append(&Header, sizeof(Header));
+
+		Scratch.Reset();
+		for (const FStackWalkModuleInfo& Module : Modules)
+		{
+			FTCHARToUTF8 Name(Module.ModuleName);
+			Scratch.Append((const uint8*)&Module.BaseOfImage, sizeof(uint64));
+			const uint64 ImageSize = Module.ImageSize;
+			Scratch.Append((const uint8*)&ImageSize, sizeof(uint64));
+			WriteVarint(Scratch, Name.Length());
+			Scratch.Append((const uint8*)Name.Get(), Name.Length());
+		}
+		Writer.Append(Scratch.GetData(), Scratch.Num());
+	}
+
+	bool Start(const FString& Filename, bool bCaptureStacks)
+	{
+		Stop();
+		OutputFilename = Filename.IsEmpty()
+			? FPaths::ProfilingDir() / TEXT("HardwareBreakpoints") / FString::Printf(TEXT("Hits-%s.hwbl"), *FDateTime::Now().ToString())
+			: Filename;
+		if (!Writer.Open(OutputFilename))
+		{
+			return false;
+		}
+		if (Queue == nullptr)
+		{
+			Queue = new FQueuedHit[QueueCapacity];
+		}
+		for (uint64 i = 0; i < QueueCapacity; ++i)
+		{
+			Queue[i].Ready.store(0, std::memory_order_relaxed);
+		}
+		Head = 0;
+		Tail = 0;
+		Dropped = 0;
+		StringIds.Reset();
+		ProgramCounterIds.Reset();
+		StackIds.Reset();
+		KnownThreads.Reset();
+		NumHits = 0;
+		LastCycles = FPlatformTime::Cycles64();
+		LastFrame = GFrameCounter;
+		WriteHeader();
+
+		bStacks = bCaptureStacks;
+		TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+		bRunning = true;
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Logging hits%s to %s"), bStacks ? TEXT(" with call stacks") : TEXT(""), *OutputFilename);
+		return true;
+	}
+
+	void Stop()
+	{
+		if (!bRunning)
+		{
+			return;
+		}
+		bRunning = false;
+		FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+		Drain();
+		if (Dropped.load() > 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("%llu hits were dropped, the queue filled up between frames"), Dropped.load());
+		}
+		const int64 Size = Writer.Tell();
+		Writer.Close();
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("%llu hits written to %s (%lld bytes)"), NumHits, *OutputFilename, Size);
+	}
+
+	bool IsRunning()
+	{
+		return bRunning;
+	}
+
+	static FAutoConsoleCommand StartCommand(
+		TEXT("HWBP.HitLog.Start"),
+		TEXT("Logs breakpoint hits to a compact binary file. Optionally pass the file name (defaults to the Profiling folder), and 'stacks' to capture call stacks"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			FString Filename;
+			bool bCaptureStacks = false;
+			for (const FString& Arg : Args)
+			{
+				if (Arg.Equals(TEXT("stacks"), ESearchCase::IgnoreCase))
+				{
+					bCaptureStacks = true;
+				}
+				else
+				{
+					Filename = Arg;
+				}
+			}
+			Start(Filename, bCaptureStacks);
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.HitLog.Stop"),
+		TEXT("Stops logging breakpoint hits and closes the binary file"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+		})
+	);
+}
@@ -0,0 +1,21 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Compact binary log of every hit, for captures too long or too dense for the JSON and Insights outputs
+//Labels, call sites, stacks and thread names are interned and written once, hits only carry varint ids and deltas,
+//so a hit without a stack usually takes 10 to 20 bytes. The file is written through a memory mapping, see FHWBP_MappedFileWriter
+//The module table is stored in the header, so the log can be symbolized and summarized offline with:
+//	UnrealEditor-Cmd <Project> -run=HWBP_HitLog -File=<Path> [-Top=N]
+//Console: HWBP.HitLog.Start [File] [stacks], HWBP.HitLog.Stop
+namespace HWBP_HitLog
+{
+	bool Start(const FString& Filename = FString(), bool bCaptureStacks = false);
+	void Stop();
+	bool IsRunning();
+
+	//Called from the exception handler, doesn't allocate or lock
+	void RecordHit(int32 Slot, FName Label, const void* Address, int32 Size, uint64 ProgramCounter, struct _EXCEPTION_POINTERS* ExceptionInfo);
+}
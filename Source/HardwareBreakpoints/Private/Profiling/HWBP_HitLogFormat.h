@@ -0,0 +1,74 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Binary hit log format, shared by the writer (HWBP_HitLog) and the offline analyzer (UHWBP_HitLogCommandlet)
+//
+//File layout:
+//	FHeader
+//	NumModules x { uint64 Base, uint64 Size, varint NameLength, UTF8 Name }	(loaded modules, to symbolize program counters offline)
+//	Records, each one a tag byte followed by its payload, until the end of the file or a None tag (the unwritten tail of a mapped file)
+//
+//Strings, program counters, stacks and threads are defined once by their own record and referenced by id afterwards
+//Hit timestamps and frame numbers are deltas to the previous hit. All integers in records are LEB128 varints
+namespace HWBP_HitLogFormat
+{
+	static constexpr uint32 Magic = 'LBWH';
+	static constexpr uint32 Version = 1;
+
+	struct FHeader
+	{
+		uint32 Magic = HWBP_HitLogFormat::Magic;
+		uint32 Version = HWBP_HitLogFormat::Version;
+		double SecondsPerCycle = 0.0;
+		uint64 StartCycles = 0;
+		uint64 StartFrame = 0;
+		uint32 NumModules = 0;
+		uint32 Reserved = 0;
+	};
+
+	enum class ERecordTag : uint8
+	{
+		None = 0,
+		//varint Id, varint Length, UTF8 bytes
+		String = 1,
+		//varint Id, varint ProgramCounter
+		ProgramCounter = 2,
+		//varint Id, varint Depth, Depth x varint ProgramCounterId
+		Stack = 3,
+		//varint ThreadId, varint NameStringId
+		Thread = 4,
+		//varint DeltaCycles, varint DeltaFrame, varint ThreadId, varint Slot, varint LabelStringId, varint ProgramCounterId,
+		//varint StackId (0 if no stack was captured), varint ValueSize, ValueSize bytes with the value after the write
+		Hit = 5,
+	};
+
+	inline void WriteVarint(TArray<uint8>& Out, uint64 Value)
+	{
+		do
+		{
+			uint8 Byte = Value & 0x7F;
+			Value >>= 7;
+			Out.Add(Byte | (Value ? 0x80 : 0));
+		}
+		while (Value);
+	}
+
+	//Returns false if the buffer ended in the middle of the varint
+	inline bool ReadVarint(const uint8*& Cursor, const uint8* End, uint64& OutValue)
+	{
+		OutValue = 0;
+		for (int32 Shift = 0; Cursor < End && Shift < 64; Shift += 7)
+		{
+			const uint8 Byte = *Cursor++;
+			OutValue |= (uint64)(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
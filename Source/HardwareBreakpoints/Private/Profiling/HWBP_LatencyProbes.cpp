@@ -0,0 +1,87 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_LatencyProbes.h"
+
+#include "HAL/IConsoleManager.h"
+
+#include "HardwareBreakpointsLog.h"
+#include "HWBP_SymbolIndex.h"
+
+namespace HWBP_LatencyProbes
+{
+	DebugRegisterIndex ProbeSymbol(const FString& SymbolName)
+	{
+		HWBP_SymbolIndex::FSymbol Symbol;
+		if (!HWBP_SymbolIndex::Resolve(SymbolName, Symbol))
+		{
+			return -1;
+		}
+		DebugRegisterIndex Index = FPlatformHardwareBreakpoints::SetFunctionLatencyProbe((void*)Symbol.Address);
+		if (Index < 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't probe %s, a latency probe needs two free breakpoint slots"), *SymbolName);
+			return -1;
+		}
+		FPlatformHardwareBreakpoints::SetBreakpointLabel(Index, FName(*Symbol.Name));
+		return Index;
+	}
+
+	static double CyclesToMicroseconds(uint64 Cycles)
+	{
+		return FPlatformTime::ToMilliseconds64(Cycles) * 1000.0;
+	}
+
+	void DumpReport(bool bReset)
+	{
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= FUNCTION LATENCY ============="));
+		for (DebugRegisterIndex Index = 0; Index < FPlatformHardwareBreakpointTraits::NumSlots; ++Index)
+		{
+			FHardwareBreakpointLatencyHistogram Histogram;
+			if (!FPlatformHardwareBreakpoints::GetLatencyHistogram(Index, Histogram, bReset))
+			{
+				continue;
+			}
+			const FName Label = FPlatformHardwareBreakpoints::GetBreakpointLabel(Index);
+			if (Histogram.Count == 0)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s: no calls timed"), *Label.ToString());
+				continue;
+			}
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s: %llu calls, mean %.2f us, min %.2f us, p50 %.2f us, p90 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us"),
+				*Label.ToString(),
+				Histogram.Count,
+				CyclesToMicroseconds(Histogram.TotalCycles / Histogram.Count),
+				CyclesToMicroseconds(Histogram.MinCycles),
+				CyclesToMicroseconds(Histogram.GetValueAtPercentile(50.0)),
+				CyclesToMicroseconds(Histogram.GetValueAtPercentile(90.0)),
+				CyclesToMicroseconds(Histogram.GetValueAtPercentile(99.0)),
+				CyclesToMicroseconds(Histogram.GetValueAtPercentile(99.9)),
+				CyclesToMicroseconds(Histogram.MaxCycles));
+			if (Histogram.NestedCalls > 0 || Histogram.AbandonedCalls > 0)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %u nested calls not timed, %u calls didn't return normally"), Histogram.NestedCalls, Histogram.AbandonedCalls);
+			}
+		}
+	}
+
+	static FAutoConsoleCommand ProbeCommand(
+		TEXT("HWBP.Probe"),
+		TEXT("Times every call to a native function on the game thread. Usage: HWBP.Probe <Symbol>, e.g. HWBP.Probe UWorld::Tick"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0)
+			{
+				ProbeSymbol(Args[0]);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.Probe.Report"),
+		TEXT("Prints the latency distribution of every active probe. Pass 'reset' to clear the histograms afterwards."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			DumpReport(Args.Num() > 0 && Args[0] == TEXT("reset"));
+		})
+	);
+}
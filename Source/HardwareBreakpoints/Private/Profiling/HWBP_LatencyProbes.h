@@ -0,0 +1,16 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformHardwareBreakpoints.h"
+
+//Latency distributions of native functions in a running build, without recompiling or adding cycle counters
+//Each probe uses two debug registers (entry and return), so at most two functions can be probed at once
+//Times include the cost of the exception round trips (a few microseconds), compare distributions rather than absolute values of very short functions
+//Console: HWBP.Probe <Symbol>, HWBP.Probe.Report [reset]
+namespace HWBP_LatencyProbes
+{
+	DebugRegisterIndex ProbeSymbol(const FString& SymbolName);
+	void DumpReport(bool bReset = false);
+}
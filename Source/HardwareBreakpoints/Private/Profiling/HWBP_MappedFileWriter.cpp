@@ -0,0 +1,194 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_MappedFileWriter.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+	#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+#include "HardwareBreakpointsLog.h"
+
+bool FHWBP_MappedFileWriter::Open(const FString& Filename)
+{
+	Close();
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+#if PLATFORM_WINDOWS
+	HANDLE File = CreateFileW(*Filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't create %s (error %u)"), *Filename, GetLastError());
+		return false;
+	}
+	FileHandle = File;
+	Written = 0;
+	if (!MapWindow(0))
+	{
+		Close();
+		return false;
+	}
+	return true;
+#else
+	FallbackWriter = IFileManager::Get().CreateFileWriter(*Filename);
+	Written = 0;
+	return FallbackWriter != nullptr;
+#endif
+}
+
+bool FHWBP_MappedFileWriter::IsOpen() const
+{
+	return View != nullptr || FallbackWriter != nullptr;
+}
+
+bool FHWBP_MappedFileWriter::MapWindow(int64 Offset)
+{
+#if PLATFORM_WINDOWS
+	UnmapWindow();
+	//Offset is always a multiple of the window size, which keeps it aligned to the allocation granularity
+	const int64 MappingSize = Offset + WindowSize;
+	MappingHandle = CreateFileMappingW((HANDLE)FileHandle, nullptr, PAGE_READWRITE, (DWORD)(MappingSize >> 32), (DWORD)MappingSize, nullptr);
+	if (MappingHandle == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't grow hit log file mapping to %lld bytes (error %u)"), MappingSize, GetLastError());
+		return false;
+	}
+	View = (uint8*)MapViewOfFile((HANDLE)MappingHandle, FILE_MAP_WRITE, (DWORD)(Offset >> 32), (DWORD)Offset, WindowSize);
+	if (View == nullptr)
+	{
+		UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't map hit log file at offset %lld (error %u)"), Offset, GetLastError());
+		return false;
+	}
+	ViewOffset = Offset;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void FHWBP_MappedFileWriter::UnmapWindow()
+{
+#if PLATFORM_WINDOWS
+	if (View)
+	{
+		UnmapViewOfFile(View);
+		View = nullptr;
+	}
+	if (MappingHandle)
+	{
+		CloseHandle((HANDLE)MappingHandle);
+		MappingHandle = nullptr;
+	}
+#endif
+}
+
+void FHWBP_MappedFileWriter::Append(const void* Data, int64 Size)
+{
+	if (FallbackWriter)
+	{
+		FallbackWriter->Serialize(const_cast<void*>(Data), Size);
+		Written += Size;
+		return;
+	}
+	const uint8* Source = (const uint8*)Data;
+	while (Size > 0 && View)
+	{
+		const int64 OffsetInView = Written - ViewOffset;
+		const int64 ToCopy = FMath::Min(Size, WindowSize - OffsetInView);
+		FMemory::Memcpy(View + OffsetInView, Source, ToCopy);
+		Written += ToCopy;
+		Source += ToCopy;
+		Size -= ToCopy;
+		if (Written - ViewOffset == WindowSize && !MapWindow(ViewOffset + WindowSize))
+		{
+			//Nothing more can be written, Close still keeps what made it to disk
+			UnmapWindow();
+		}
+	}
+}
+
+void FHWBP_MappedFileWriter::Close()
+{
+	if (FallbackWriter)
+	{
+		FallbackWriter->Close();
+		delete FallbackWriter;
+		FallbackWriter = nullptr;
+	}
+#if PLATFORM_WINDOWS
+	UnmapWindow();
+	if (FileHandle)
+	{
+		//The mapping grew the file a whole window at a time, drop the unwritten tail
+		LARGE_INTEGER End;
+		End.QuadPart = Written;
+		SetFilePointerEx((HANDLE)FileHandle, End, nullptr, FILE_BEGIN);
+		SetEndOfFile((HANDLE)FileHandle);
+		CloseHandle((HANDLE)FileHandle);
+		FileHandle = nullptr;
+	}
+#endif
+}
+
+bool FHWBP_MappedFileReader::Open(const FString& Filename)
+{
+	Close();
+#if PLATFORM_WINDOWS
+	HANDLE File = CreateFileW(*Filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	FileHandle = File;
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	MappingHandle = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	Data = MappingHandle ? (const uint8*)MapViewOfFile((HANDLE)MappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (Data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	Size = FileSize.QuadPart;
+	return true;
+#else
+	if (!FFileHelper::LoadFileToArray(FallbackData, *Filename, FILEREAD_Silent) || FallbackData.Num() == 0)
+	{
+		return false;
+	}
+	Data = FallbackData.GetData();
+	Size = FallbackData.Num();
+	return true;
+#endif
+}
+
+void FHWBP_MappedFileReader::Close()
+{
+#if PLATFORM_WINDOWS
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if (MappingHandle)
+	{
+		CloseHandle((HANDLE)MappingHandle);
+		MappingHandle = nullptr;
+	}
+	if (FileHandle)
+	{
+		CloseHandle((HANDLE)FileHandle);
+		FileHandle = nullptr;
+	}
+#endif
+	Data = nullptr;
+	Size = 0;
+	FallbackData.Empty();
+}
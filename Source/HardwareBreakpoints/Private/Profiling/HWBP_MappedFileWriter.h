@@ -0,0 +1,55 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Append-only file writer that maps the tail of the file and copies straight into the mapping, so writing a record costs a memcpy
+//instead of a syscall. The file grows a window at a time, and is truncated to what was actually written on Close
+//Platforms without a mapping implementation fall back to a regular file writer
+class FHWBP_MappedFileWriter
+{
+public:
+	~FHWBP_MappedFileWriter() { Close(); }
+
+	bool Open(const FString& Filename);
+	void Append(const void* Data, int64 Size);
+	void Close();
+
+	bool IsOpen() const;
+	int64 Tell() const { return Written; }
+
+private:
+	bool MapWindow(int64 Offset);
+	void UnmapWindow();
+
+	//Size the file grows by, and size of each mapped view
+	static constexpr int64 WindowSize = 16 * 1024 * 1024;
+
+	void* FileHandle = nullptr;
+	void* MappingHandle = nullptr;
+	uint8* View = nullptr;
+	int64 ViewOffset = 0;
+	int64 Written = 0;
+	FArchive* FallbackWriter = nullptr;
+};
+
+//Read-only view of a whole file, mapped where the platform supports it, otherwise loaded into memory
+class FHWBP_MappedFileReader
+{
+public:
+	~FHWBP_MappedFileReader() { Close(); }
+
+	bool Open(const FString& Filename);
+	void Close();
+
+	const uint8* GetData() const { return Data; }
+	int64 GetSize() const { return Size; }
+
+private:
+	void* FileHandle = nullptr;
+	void* MappingHandle = nullptr;
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+	TArray<uint8> FallbackData;
+};
@@ -0,0 +1,208 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_NodeHeatmap.h"
+
+#include "HAL/IConsoleManager.h"
+#include "UObject/Class.h"
+#include "UObject/Stack.h"
+#if WITH_EDITOR
+#include "EdGraph/EdGraph.h"
+#include "EdGraph/EdGraphNode.h"
+#include "Kismet2/KismetDebugUtilities.h"
+#endif
+
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_LockFreeTable.h"
+
+namespace HWBP_NodeHeatmap
+{
+	static const uint32 MaxEntries = 1024;
+	//Bounds the work done in the handler. Hits that don't find their entry within this many probes are dropped
+	static const uint32 MaxProbes = 32;
+
+	//Copy of an entry, for the report
+	struct FNodeHit
+	{
+		FName Label;
+		const void* Watched = nullptr;
+		//Null for hits from native code
+		const UFunction* Function = nullptr;
+		FWeakObjectPtr WeakFunction;
+		int32 ScriptOffset = INDEX_NONE;
+		uint32 Count = 0;
+	};
+
+	//Keyed by a hash of what was hit and where
+	struct FNodeHitEntry : FHWBP_LockFreeTableEntry
+	{
+		std::atomic<uint32> Count{ 0 };
+		FNodeHit Hit;
+	};
+
+	static THWBP_LockFreeTable<FNodeHitEntry, MaxEntries, MaxProbes> Table;
+	static bool bRunning = false;
+
+	void Start()
+	{
+		Reset();
+		bRunning = true;
+	}
+
+	void Stop()
+	{
+		bRunning = false;
+	}
+
+	bool IsRunning()
+	{
+		return bRunning;
+	}
+
+	void RecordHit(FName Label, const void* Watched)
+	{
+		if (!bRunning)
+		{
+			return;
+		}
+		const UFunction* Function = nullptr;
+		int32 ScriptOffset = INDEX_NONE;
+		const FFrame* Frame = FFrame::GetThreadLocalTopStackFrame();
+		if (Frame && Frame->Node && Frame->Code)
+		{
+			Function = Frame->Node;
+			//Code already points past the opcode being executed, the node lookup allows imprecise hits for this reason
+			ScriptOffset = (int32)(Frame->Code - Frame->Node->Script.GetData());
+		}
+		uint64 Key = (uint64)(UPTRINT)Watched * 0x9E3779B97F4A7C15ull;
+		Key = (Key ^ (uint64)(UPTRINT)Function) * 0xBF58476D1CE4E5B9ull;
+		Key = (Key ^ (uint32)ScriptOffset) * 0x94D049BB133111EBull;
+		Key = (Key ^ (Key >> 31)) | 1;
+
+		bool bClaimed = false;
+		FNodeHitEntry* Entry = Table.FindOrClaim(Key, bClaimed);
+		if (Entry == nullptr)
+		{
+			return;
+		}
+		if (bClaimed)
+		{
+			Entry->Hit.Label = Label;
+			Entry->Hit.Watched = Watched;
+			Entry->Hit.Function = Function;
+			Entry->Hit.WeakFunction = Function;
+			Entry->Hit.ScriptOffset = ScriptOffset;
+			Entry->Publish();
+		}
+		Entry->Count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static FString DescribeNode(const FNodeHit& Hit)
+	{
+		if (Hit.Function == nullptr)
+		{
+			return TEXT("<native code>");
+		}
+		UFunction* Function = Cast<UFunction>(Hit.WeakFunction.Get());
+		if (Function == nullptr)
+		{
+			return TEXT("<unloaded function>");
+		}
+#if WITH_EDITOR
+		if (UEdGraphNode* Node = FKismetDebugUtilities::FindSourceNodeForCodeLocation(nullptr, Function, Hit.ScriptOffset, true))
+		{
+			return FString::Printf(TEXT("%s (%s.%s)"),
+				*Node->GetNodeTitle(ENodeTitleType::ListView).ToString(),
+				*GetNameSafe(Function->GetOuter()),
+				*GetNameSafe(Node->GetGraph()));
+		}
+#endif
+		return FString::Printf(TEXT("%s+0x%X"), *Function->GetPathName(), Hit.ScriptOffset);
+	}
+
+	void DumpReport(int32 MaxNodes)
+	{
+		TArray<FNodeHit> Hits;
+		Table.ForEachReady([&Hits](const FNodeHitEntry& Entry)
+		{
+			FNodeHit& Hit = Hits.Add_GetRef(Entry.Hit);
+			Hit.Count = Entry.Count.load(std::memory_order_relaxed);
+		});
+		const uint32 Dropped = Table.GetNumDropped();
+		//Grouped by what was hit, hottest node first
+		Hits.Sort([](const FNodeHit& A, const FNodeHit& B)
+		{
+			if (A.Watched != B.Watched)
+			{
+				return A.Watched < B.Watched;
+			}
+			return A.Count > B.Count;
+		});
+
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= BLUEPRINT NODE HEATMAP ============="));
+		for (int32 GroupStart = 0; GroupStart < Hits.Num();)
+		{
+			int32 GroupEnd = GroupStart;
+			uint64 Total = 0;
+			while (GroupEnd < Hits.Num() && Hits[GroupEnd].Watched == Hits[GroupStart].Watched)
+			{
+				Total += Hits[GroupEnd++].Count;
+			}
+			const FNodeHit& First = Hits[GroupStart];
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s: %llu hits"), First.Label.IsNone() ? *FString::Printf(TEXT("%p"), First.Watched) : *First.Label.ToString(), Total);
+			const uint32 MaxCount = First.Count;
+			for (int32 i = GroupStart; i < GroupEnd && i - GroupStart < MaxNodes; ++i)
+			{
+				//The bar is the heat, relative to the hottest node of the group
+				const int32 BarLength = FMath::Max(1, (int32)(20.0 * Hits[i].Count / MaxCount));
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %-20s %8u  %s"), *FString::ChrN(BarLength, TEXT('#')), Hits[i].Count, *DescribeNode(Hits[i]));
+			}
+			GroupStart = GroupEnd;
+		}
+		if (Dropped > 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%u hits dropped, the table is full"), Dropped);
+		}
+	}
+
+	//Entries are cleared in place, a hit recorded at the same time may be lost
+	void Reset()
+	{
+		Table.Reset([](FNodeHitEntry& Entry)
+		{
+			Entry.Count.store(0, std::memory_order_relaxed);
+			Entry.Hit = FNodeHit();
+		});
+	}
+
+	static FAutoConsoleCommand StartCommand(
+		TEXT("HWBP.Heatmap.Start"),
+		TEXT("Starts aggregating count-only data breakpoint and script function breakpoint hits per Blueprint node"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Start();
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.Heatmap.Stop"),
+		TEXT("Stops the Blueprint node heatmap and prints it"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+			DumpReport();
+		})
+	);
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.Heatmap.Report"),
+		TEXT("Prints hits per Blueprint node. Pass 'reset' to clear them afterwards."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			DumpReport();
+			if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			{
+				Reset();
+			}
+		})
+	);
+}
@@ -0,0 +1,23 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Which Blueprint nodes hammer a watched variable (or call a watched function), without stepping through the graph
+//Hits of count-only data breakpoints and script function breakpoints are aggregated by the script function and code offset
+//executing at the time, and the report maps each offset back to its graph node (node names need the editor)
+//Console: HWBP.Heatmap.Start, HWBP.Heatmap.Stop, HWBP.Heatmap.Report [reset]
+namespace HWBP_NodeHeatmap
+{
+	void Start();
+	void Stop();
+	bool IsRunning();
+
+	//Records the Blueprint node executing on this thread. Safe to call from the exception handler, doesn't allocate or lock
+	//Label and Watched identify what was hit (a property label and its address, or a function)
+	void RecordHit(FName Label, const void* Watched);
+
+	void DumpReport(int32 MaxNodes = 20);
+	void Reset();
+}
@@ -0,0 +1,263 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_OpcodeProfiler.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Templates/IntegerSequence.h"
+#include "UObject/Class.h"
+#include "UObject/Script.h"
+#include "UObject/Stack.h"
+
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_Ticker.h"
+
+extern COREUOBJECT_API FNativeFuncPtr GNatives[];
+
+namespace HWBP_OpcodeProfiler
+{
+	struct FOpcodeStats
+	{
+		uint64 Count = 0;
+		uint64 ExclusiveCycles = 0;
+	};
+
+	struct FFunctionStats
+	{
+		FWeakObjectPtr Function;
+		uint64 Count = 0;
+		uint64 ExclusiveCycles = 0;
+	};
+
+	static FNativeFuncPtr OriginalNatives[EX_Max];
+	static bool bSwapped[EX_Max];
+	static FOpcodeStats OpcodeStats[EX_Max];
+	static TMap<const UFunction*, FFunctionStats> FunctionStats;
+	//Consecutive opcodes almost always belong to the same function, this saves most map lookups
+	static const UFunction* CachedNode = nullptr;
+	static FFunctionStats* CachedFunctionStats = nullptr;
+	//Opcodes nest (e.g. a Let evaluates its operands through GNatives), children add their time here so parents can subtract it
+	static uint64 ChildCycles = 0;
+	static uint64 ProfiledFrames = 0;
+	static FHWBP_TickerHandle TickerHandle;
+
+	template <int32 Opcode>
+	static void CountingTrampoline(UObject* Context, FFrame& Stack, RESULT_DECL)
+	{
+		if (!IsInGameThread())
+		{
+			OriginalNatives[Opcode](Context, Stack, RESULT_PARAM);
+			return;
+		}
+		const UFunction* Node = Stack.Node;
+		const uint64 ParentChildCycles = ChildCycles;
+		ChildCycles = 0;
+		const uint64 Start = FPlatformTime::Cycles64();
+		OriginalNatives[Opcode](Context, Stack, RESULT_PARAM);
+		const uint64 Elapsed = FPlatformTime::Cycles64() - Start;
+		const uint64 Exclusive = Elapsed > ChildCycles ? Elapsed - ChildCycles : 0;
+		ChildCycles = ParentChildCycles + Elapsed;
+
+		++OpcodeStats[Opcode].Count;
+		OpcodeStats[Opcode].ExclusiveCycles += Exclusive;
+		if (Node != CachedNode)
+		{
+			FFunctionStats& NodeStats = FunctionStats.FindOrAdd(Node);
+			NodeStats.Function = Node;
+			CachedNode = Node;
+			CachedFunctionStats = &NodeStats;
+		}
+		++CachedFunctionStats->Count;
+		CachedFunctionStats->ExclusiveCycles += Exclusive;
+	}
+
+	template <typename Sequence>
+	struct TTrampolineTable;
+
+	template <int32... Opcodes>
+	struct TTrampolineTable<TIntegerSequence<int32, Opcodes...>>
+	{
+		static constexpr FNativeFuncPtr Entries[] = { &CountingTrampoline<Opcodes>... };
+	};
+	using FTrampolineTable = TTrampolineTable<TMakeIntegerSequence<int32, EX_Max>>;
+
+	static const TCHAR* GetOpcodeName(int32 Opcode)
+	{
+		switch (Opcode)
+		{
+#define HWBP_OPCODE_NAME(Token) case Token: return TEXT(#Token);
+		HWBP_OPCODE_NAME(EX_LocalVariable)
+		HWBP_OPCODE_NAME(EX_InstanceVariable)
+		HWBP_OPCODE_NAME(EX_DefaultVariable)
+		HWBP_OPCODE_NAME(EX_LocalOutVariable)
+		HWBP_OPCODE_NAME(EX_Return)
+		HWBP_OPCODE_NAME(EX_Jump)
+		HWBP_OPCODE_NAME(EX_JumpIfNot)
+		HWBP_OPCODE_NAME(EX_Nothing)
+		HWBP_OPCODE_NAME(EX_Let)
+		HWBP_OPCODE_NAME(EX_LetBool)
+		HWBP_OPCODE_NAME(EX_LetObj)
+		HWBP_OPCODE_NAME(EX_Self)
+		HWBP_OPCODE_NAME(EX_Context)
+		HWBP_OPCODE_NAME(EX_Context_FailSilent)
+		HWBP_OPCODE_NAME(EX_StructMemberContext)
+		HWBP_OPCODE_NAME(EX_VirtualFunction)
+		HWBP_OPCODE_NAME(EX_FinalFunction)
+		HWBP_OPCODE_NAME(EX_LocalVirtualFunction)
+		HWBP_OPCODE_NAME(EX_LocalFinalFunction)
+		HWBP_OPCODE_NAME(EX_CallMath)
+		HWBP_OPCODE_NAME(EX_CallMulticastDelegate)
+		HWBP_OPCODE_NAME(EX_DynamicCast)
+		HWBP_OPCODE_NAME(EX_MetaCast)
+		HWBP_OPCODE_NAME(EX_Cast)
+		HWBP_OPCODE_NAME(EX_IntConst)
+		HWBP_OPCODE_NAME(EX_True)
+		HWBP_OPCODE_NAME(EX_False)
+		HWBP_OPCODE_NAME(EX_PushExecutionFlow)
+		HWBP_OPCODE_NAME(EX_PopExecutionFlow)
+		HWBP_OPCODE_NAME(EX_PopExecutionFlowIfNot)
+		HWBP_OPCODE_NAME(EX_ComputedJump)
+		HWBP_OPCODE_NAME(EX_SwitchValue)
+		HWBP_OPCODE_NAME(EX_ArrayGetByRef)
+		HWBP_OPCODE_NAME(EX_Tracepoint)
+		HWBP_OPCODE_NAME(EX_WireTracepoint)
+		HWBP_OPCODE_NAME(EX_InstrumentationEvent)
+		HWBP_OPCODE_NAME(EX_EndOfScript)
+#undef HWBP_OPCODE_NAME
+		default: return nullptr;
+		}
+	}
+
+	static FString DescribeOpcode(int32 Opcode)
+	{
+		const TCHAR* Name = GetOpcodeName(Opcode);
+		return Name ? FString(Name) : FString::Printf(TEXT("0x%02X"), Opcode);
+	}
+
+	static double CyclesToMilliseconds(uint64 Cycles)
+	{
+		return FPlatformTime::ToMilliseconds64(Cycles);
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		++ProfiledFrames;
+		return true;
+	}
+
+	bool Start(const TArray<uint8>& Opcodes)
+	{
+		check(IsInGameThread());
+		Stop();
+		FMemory::Memzero(OpcodeStats);
+		FunctionStats.Reset();
+		CachedNode = nullptr;
+		CachedFunctionStats = nullptr;
+		ChildCycles = 0;
+		ProfiledFrames = 0;
+		for (int32 Opcode = 0; Opcode < EX_Max; ++Opcode)
+		{
+			//Only opcodes with a handler registered are swapped, the rest never run
+			if (GNatives[Opcode] == nullptr || (Opcodes.Num() > 0 && !Opcodes.Contains((uint8)Opcode)))
+			{
+				continue;
+			}
+			OriginalNatives[Opcode] = GNatives[Opcode];
+			GNatives[Opcode] = FTrampolineTable::Entries[Opcode];
+			bSwapped[Opcode] = true;
+		}
+		TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+		return true;
+	}
+
+	void Stop()
+	{
+		check(IsInGameThread());
+		for (int32 Opcode = 0; Opcode < EX_Max; ++Opcode)
+		{
+			if (bSwapped[Opcode])
+			{
+				GNatives[Opcode] = OriginalNatives[Opcode];
+				bSwapped[Opcode] = false;
+			}
+		}
+		if (TickerHandle.IsValid())
+		{
+			FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+		}
+	}
+
+	bool IsRunning()
+	{
+		return TickerHandle.IsValid();
+	}
+
+	void DumpReport(int32 MaxFunctions)
+	{
+		const double Frames = FMath::Max<uint64>(ProfiledFrames, 1);
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= BLUEPRINT VM OPCODES (%llu frames) ============="), ProfiledFrames);
+
+		TArray<int32> SortedOpcodes;
+		for (int32 Opcode = 0; Opcode < EX_Max; ++Opcode)
+		{
+			if (OpcodeStats[Opcode].Count > 0)
+			{
+				SortedOpcodes.Add(Opcode);
+			}
+		}
+		SortedOpcodes.Sort([](int32 A, int32 B) { return OpcodeStats[A].ExclusiveCycles > OpcodeStats[B].ExclusiveCycles; });
+		for (int32 Opcode : SortedOpcodes)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %-28s %10.1f/frame %8.3f ms/frame"),
+				*DescribeOpcode(Opcode),
+				OpcodeStats[Opcode].Count / Frames,
+				CyclesToMilliseconds(OpcodeStats[Opcode].ExclusiveCycles) / Frames);
+		}
+
+		TArray<FFunctionStats> SortedFunctions;
+		FunctionStats.GenerateValueArray(SortedFunctions);
+		SortedFunctions.Sort([](const FFunctionStats& A, const FFunctionStats& B) { return A.ExclusiveCycles > B.ExclusiveCycles; });
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Top functions by VM time (excluding time spent in the functions they call from script):"));
+		for (int32 i = 0; i < SortedFunctions.Num() && i < MaxFunctions; ++i)
+		{
+			const UObject* Function = SortedFunctions[i].Function.Get();
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %s: %.1f opcodes/frame, %.3f ms/frame"),
+				Function ? *Function->GetPathName() : TEXT("<unloaded function>"),
+				SortedFunctions[i].Count / Frames,
+				CyclesToMilliseconds(SortedFunctions[i].ExclusiveCycles) / Frames);
+		}
+	}
+
+	static FAutoConsoleCommand StartCommand(
+		TEXT("HWBP.OpcodeProfiler.Start"),
+		TEXT("Profiles Blueprint VM opcodes and functions on the game thread. Optionally pass the opcodes to profile, in hex (e.g. 0x1B 0x44)"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			TArray<uint8> Opcodes;
+			for (const FString& Arg : Args)
+			{
+				Opcodes.Add((uint8)FCString::Strtoi(*Arg, nullptr, 16));
+			}
+			Start(Opcodes);
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.OpcodeProfiler.Stop"),
+		TEXT("Restores the original opcode handlers and prints the opcode profiler report"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+			DumpReport();
+		})
+	);
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.OpcodeProfiler.Report"),
+		TEXT("Prints the opcode profiler report without stopping it"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			DumpReport();
+		})
+	);
+}
@@ -0,0 +1,19 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Shows which Blueprint graphs and opcodes dominate VM time, to decide what to nativize
+//Swaps GNatives entries (the VM's opcode handlers) for counting trampolines, and swaps the originals back on Stop
+//Counts and exclusive time are recorded per opcode and per UFunction. Only the game thread is profiled
+//Console: HWBP.OpcodeProfiler.Start [Opcode...], HWBP.OpcodeProfiler.Stop, HWBP.OpcodeProfiler.Report
+namespace HWBP_OpcodeProfiler
+{
+	//Empty Opcodes profiles every opcode
+	bool Start(const TArray<uint8>& Opcodes = TArray<uint8>());
+	void Stop();
+	bool IsRunning();
+
+	void DumpReport(int32 MaxFunctions = 20);
+}
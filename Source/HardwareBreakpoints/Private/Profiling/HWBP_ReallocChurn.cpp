@@ -0,0 +1,181 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_ReallocChurn.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_LockFreeTable.h"
+
+namespace HWBP_ReallocChurn
+{
+	static const int32 MaxCallSiteDepth = 8;
+	static const uint32 MaxEntries = 256;
+	//Bounds the work done in the handler. Events that don't find their entry within this many probes are dropped
+	static const uint32 MaxProbes = 16;
+
+	//Keyed by a hash of the array and call stack
+	struct FChurnEntry : FHWBP_LockFreeTableEntry
+	{
+		const void* ArrayHeader = nullptr;
+		uint64 CallStack[MaxCallSiteDepth] = { 0 };
+		uint32 Depth = 0;
+		std::atomic<uint32> Counts[(int32)EContainerEvent::Count] = {};
+	};
+
+	//Copy of an entry for the report
+	struct FChurnSnapshot
+	{
+		const void* ArrayHeader = nullptr;
+		uint64 CallStack[MaxCallSiteDepth] = { 0 };
+		uint32 Depth = 0;
+		uint32 Counts[(int32)EContainerEvent::Count] = { 0 };
+	};
+
+	static THWBP_LockFreeTable<FChurnEntry, MaxEntries, MaxProbes> Table;
+
+	static uint64 HashCallSite(const void* ArrayHeader, const uint64* CallStack, uint32 Depth)
+	{
+		uint64 Hash = (uint64)(UPTRINT)ArrayHeader * 0x9E3779B97F4A7C15ull;
+		for (uint32 i = 0; i < Depth; ++i)
+		{
+			Hash = (Hash ^ CallStack[i]) * 0xBF58476D1CE4E5B9ull;
+			Hash ^= Hash >> 31;
+		}
+		return Hash | 1;
+	}
+
+	void RecordContainerWrite(const void* ArrayHeader, EContainerEvent Event, struct _EXCEPTION_POINTERS* ExceptionInfo)
+	{
+		//The cached unwind tables, DbgHelp's walker is far too slow to run on every container write
+		uint64 CallStack[MaxCallSiteDepth] = { 0 };
+		const uint32 Depth = FPlatformHardwareBreakpoints::UnwindStackBackTrace(CallStack, MaxCallSiteDepth, ExceptionInfo);
+		const uint64 Key = HashCallSite(ArrayHeader, CallStack, Depth);
+
+		bool bClaimed = false;
+		FChurnEntry* Entry = Table.FindOrClaim(Key, bClaimed);
+		if (Entry == nullptr)
+		{
+			return;
+		}
+		if (bClaimed)
+		{
+			Entry->ArrayHeader = ArrayHeader;
+			Entry->Depth = Depth;
+			FMemory::Memcpy(Entry->CallStack, CallStack, sizeof(CallStack));
+			Entry->Publish();
+		}
+		Entry->Counts[(int32)Event].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//The frames closest to the write are usually TArray/allocator internals, we want to report who asked for the growth
+	static bool IsContainerInternalFunction(const ANSICHAR* FunctionName)
+	{
+		static const ANSICHAR* InternalNames[] = {
+			"TArray<",
+			"FScriptArray",
+			"TScriptArray<",
+			"FHeapAllocator",
+			"TSizedHeapAllocator<",
+			"FMemory::",
+			"FMalloc",
+			"FString::",
+			"operator+=",
+		};
+		for (const ANSICHAR* InternalName : InternalNames)
+		{
+			if (FCStringAnsi::Strstr(FunctionName, InternalName))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static FString DescribeCallSite(const FChurnSnapshot& Entry)
+	{
+		FProgramCounterSymbolInfo FirstSymbol;
+		for (uint32 i = 0; i < Entry.Depth; ++i)
+		{
+			FProgramCounterSymbolInfo SymbolInfo;
+			FPlatformStackWalk::ProgramCounterToSymbolInfo(Entry.CallStack[i], SymbolInfo);
+			if (i == 0)
+			{
+				FirstSymbol = SymbolInfo;
+			}
+			if (!IsContainerInternalFunction(SymbolInfo.FunctionName))
+			{
+				return FString::Printf(TEXT("%s [%s:%d]"), ANSI_TO_TCHAR(SymbolInfo.FunctionName), ANSI_TO_TCHAR(SymbolInfo.Filename), SymbolInfo.LineNumber);
+			}
+		}
+		return FString::Printf(TEXT("%s [%s:%d]"), ANSI_TO_TCHAR(FirstSymbol.FunctionName), ANSI_TO_TCHAR(FirstSymbol.Filename), FirstSymbol.LineNumber);
+	}
+
+	void DumpReport()
+	{
+		TArray<FChurnSnapshot> Sorted;
+		Table.ForEachReady([&Sorted](const FChurnEntry& Entry)
+		{
+			FChurnSnapshot& Snapshot = Sorted[Sorted.AddDefaulted()];
+			Snapshot.ArrayHeader = Entry.ArrayHeader;
+			Snapshot.Depth = Entry.Depth;
+			FMemory::Memcpy(Snapshot.CallStack, Entry.CallStack, sizeof(Snapshot.CallStack));
+			for (int32 i = 0; i < (int32)EContainerEvent::Count; ++i)
+			{
+				Snapshot.Counts[i] = Entry.Counts[i].load(std::memory_order_relaxed);
+			}
+		});
+		const uint32 Dropped = Table.GetNumDropped();
+		auto Total = [](const FChurnSnapshot& Entry)
+		{
+			return Entry.Counts[(int32)EContainerEvent::Reallocation] + Entry.Counts[(int32)EContainerEvent::Grow] + Entry.Counts[(int32)EContainerEvent::Shrink];
+		};
+		Sorted.Sort([&Total](const FChurnSnapshot& A, const FChurnSnapshot& B) { return Total(A) > Total(B); });
+
+		FPlatformStackWalk::InitStackWalking();
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= REALLOCATION CHURN ============="));
+		for (const FChurnSnapshot& Entry : Sorted)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("Array %p: %u reallocations, %u grows, %u shrinks from %s"),
+				Entry.ArrayHeader,
+				Entry.Counts[(int32)EContainerEvent::Reallocation],
+				Entry.Counts[(int32)EContainerEvent::Grow],
+				Entry.Counts[(int32)EContainerEvent::Shrink],
+				*DescribeCallSite(Entry));
+		}
+		if (Dropped > 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("%u events were dropped because the churn table was full"), Dropped);
+		}
+	}
+
+	//Entries are cleared in place, a write recorded at the same time may be lost or land in a half cleared entry
+	void Reset()
+	{
+		Table.Reset([](FChurnEntry& Entry)
+		{
+			for (std::atomic<uint32>& Count : Entry.Counts)
+			{
+				Count.store(0, std::memory_order_relaxed);
+			}
+		});
+	}
+
+	static FAutoConsoleCommand ReallocChurnCommand(
+		TEXT("HWBP.ReallocChurn"),
+		TEXT("Prints which call sites grow or reallocate arrays watched by realloc-following data breakpoints. Pass 'reset' to clear the collected data."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			{
+				Reset();
+			}
+			else
+			{
+				DumpReport();
+			}
+		})
+	);
+}
@@ -0,0 +1,26 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Collects container header writes seen by realloc-following data breakpoints
+//so we can report which call sites grow or reallocate which arrays, and how often
+//Use the HWBP.ReallocChurn console command to print the report (HWBP.ReallocChurn reset to clear it)
+namespace HWBP_ReallocChurn
+{
+	enum class EContainerEvent : uint8
+	{
+		Reallocation,
+		Grow,
+		Shrink,
+
+		Count
+	};
+
+	//Called from the exception handler, doesn't allocate or lock. The call site comes from the cached unwind tables
+	void RecordContainerWrite(const void* ArrayHeader, EContainerEvent Event, struct _EXCEPTION_POINTERS* ExceptionInfo);
+
+	void DumpReport();
+	void Reset();
+}
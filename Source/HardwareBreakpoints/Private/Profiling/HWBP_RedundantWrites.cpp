@@ -0,0 +1,87 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_RedundantWrites.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+
+namespace HWBP_RedundantWrites
+{
+	void DumpReport(int32 MaxCallSites)
+	{
+		FPlatformStackWalk::InitStackWalking();
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= REDUNDANT WRITES ============="));
+		for (DebugRegisterIndex Index = 0; Index < FPlatformHardwareBreakpointTraits::NumSlots; ++Index)
+		{
+			FHardwareBreakpointHitCounters Counters;
+			if (FPlatformHardwareBreakpoints::GetBreakpointMode(Index) != EDataBreakpointMode::RedundantWrites || !FPlatformHardwareBreakpoints::GetHitCounters(Index, Counters))
+			{
+				continue;
+			}
+			const double Total = FMath::Max<uint32>(Counters.TotalHits, 1);
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s: %u writes, %u didn't change the value (%.1f%%)"),
+				*FPlatformHardwareBreakpoints::GetBreakpointLabel(Index).ToString(),
+				Counters.TotalHits,
+				Counters.RedundantHits,
+				100.0 * Counters.RedundantHits / Total);
+
+			TArray<FHardwareBreakpointHitCounters::FCallSite, TInlineAllocator<FHardwareBreakpointHitCounters::MaxCallSites>> Offenders;
+			for (const FHardwareBreakpointHitCounters::FCallSite& CallSite : Counters.CallSites)
+			{
+				if (CallSite.RedundantCount > 0)
+				{
+					Offenders.Add(CallSite);
+				}
+			}
+			Offenders.Sort([](const FHardwareBreakpointHitCounters::FCallSite& A, const FHardwareBreakpointHitCounters::FCallSite& B)
+			{
+				return A.RedundantCount > B.RedundantCount;
+			});
+			for (int32 i = 0; i < Offenders.Num() && i < MaxCallSites; ++i)
+			{
+				ANSICHAR HumanReadableString[1024] = { 0 };
+				FPlatformStackWalk::ProgramCounterToHumanReadableString(0, Offenders[i].ProgramCounter, HumanReadableString, sizeof(HumanReadableString));
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %u of %u writes redundant, %.1f%% of all writes: %s"),
+					Offenders[i].RedundantCount,
+					Offenders[i].Count,
+					100.0 * Offenders[i].RedundantCount / Total,
+					ANSI_TO_TCHAR(HumanReadableString));
+			}
+			if (Counters.UntrackedHits > 0)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %u writes from untracked call sites"), Counters.UntrackedHits);
+			}
+		}
+	}
+
+	void ResetCounters()
+	{
+		for (DebugRegisterIndex Index = 0; Index < FPlatformHardwareBreakpointTraits::NumSlots; ++Index)
+		{
+			FHardwareBreakpointHitCounters Unused;
+			if (FPlatformHardwareBreakpoints::GetBreakpointMode(Index) == EDataBreakpointMode::RedundantWrites)
+			{
+				FPlatformHardwareBreakpoints::GetHitCounters(Index, Unused, true);
+			}
+		}
+	}
+
+	static FAutoConsoleCommand RedundantWritesCommand(
+		TEXT("HWBP.RedundantWrites"),
+		TEXT("Prints no-op writes per call site for every active redundant write breakpoint. Pass 'reset' to clear the counters."),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			{
+				ResetCounters();
+			}
+			else
+			{
+				DumpReport();
+			}
+		})
+	);
+}
@@ -0,0 +1,15 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Reports writes that stored the value that was already there, for every active RedundantWrites data breakpoint
+//Those still invalidate cache lines, dirty push model replication and trigger OnReps, for nothing
+//Console: HWBP.RedundantWrites [reset]
+namespace HWBP_RedundantWrites
+{
+	//Logs, per watched property, the call sites with the most no-op writes and their share of all writes to it
+	void DumpReport(int32 MaxCallSites = 5);
+	void ResetCounters();
+}
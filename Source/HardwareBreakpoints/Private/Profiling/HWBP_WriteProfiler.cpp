@@ -0,0 +1,392 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#include "Profiling/HWBP_WriteProfiler.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+#include "UObject/UnrealType.h"
+#include "UObject/UObjectGlobals.h"
+
+#include "CallStackViewer.h"
+#include "HAL/PlatformHardwareBreakpoints.h"
+#include "HardwareBreakpointsLog.h"
+#include "Misc/HWBP_Ticker.h"
+#include "PropertyHelpers.h"
+
+using namespace PropertyHelpers;
+
+namespace HWBP_WriteProfiler
+{
+	struct FPropertyStats
+	{
+		const PropertyType* Property = nullptr;
+		FString Name;
+		uint64 Writes = 0;
+		uint64 UntrackedWrites = 0;
+		double WatchedSeconds = 0.0;
+		uint64 WatchedFrames = 0;
+		TMap<uint64, uint64> CallSites;
+	};
+
+	//One property can take several slots (e.g. an FVector needs 3 8-byte watches). They're linked, so each write is counted once
+	struct FActiveWatch
+	{
+		int32 StatsIndex = INDEX_NONE;
+		DebugRegisterIndex Slot = -1;
+		//Tells the watch apart from a breakpoint that was set in the same slot after ours was removed from somewhere else
+		const void* Address = nullptr;
+	};
+
+	static TWeakObjectPtr<UObject> Target;
+	static TArray<FPropertyStats> Stats;
+	static TArray<FActiveWatch> ActiveWatches;
+	static int32 NextProperty = 0;
+	static int32 FramesPerWindow = 30;
+	static int32 FramesInWindow = 0;
+	static double WindowStartTime = 0.0;
+	//Properties harvested since the last report, a report is logged each time the rotation has gone over the whole class
+	static int32 PropertiesSinceReport = 0;
+	static FHWBP_TickerHandle TickerHandle;
+	static FDelegateHandle RemoveBreakpointHandle;
+
+	static bool IsOwnWatch(const FActiveWatch& Watch)
+	{
+		return FPlatformHardwareBreakpoints::GetBreakpointAddress(Watch.Slot) == Watch.Address;
+	}
+
+	static void RemoveOwnWatch(const FActiveWatch& Watch)
+	{
+		if (IsOwnWatch(Watch))
+		{
+			FPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(Watch.Slot);
+		}
+	}
+
+	//A slot removed from somewhere else (callstack window, owner reclaim) can be handed to another breakpoint right away,
+	//so the property it belonged to is dropped from this window, it's watched again on the next rotation
+	static void OnBreakpointRemoved(DebugRegisterIndex Index)
+	{
+		const int32 WatchIndex = ActiveWatches.IndexOfByPredicate([Index](const FActiveWatch& Watch) { return Watch.Slot == Index; });
+		if (WatchIndex == INDEX_NONE)
+		{
+			return;
+		}
+		const int32 StatsIndex = ActiveWatches[WatchIndex].StatsIndex;
+		for (int32 i = ActiveWatches.Num() - 1; i >= 0; --i)
+		{
+			if (ActiveWatches[i].StatsIndex == StatsIndex)
+			{
+				if (ActiveWatches[i].Slot != Index)
+				{
+					RemoveOwnWatch(ActiveWatches[i]);
+				}
+				ActiveWatches.RemoveAt(i);
+			}
+		}
+	}
+
+	//Splits [Address, Address + Size) into naturally aligned 1/2/4/8 byte chunks, which is what debug registers can watch
+	static int32 PlanChunks(uint8* Address, int32 Size, TArray<TPair<uint8*, int32>, TInlineAllocator<FPlatformHardwareBreakpointTraits::NumSlots>>& OutChunks)
+	{
+		OutChunks.Reset();
+		while (Size > 0)
+		{
+			int32 ChunkSize = 8;
+			while (ChunkSize > 1 && (ChunkSize > Size || (UPTRINT)Address % ChunkSize != 0))
+			{
+				ChunkSize /= 2;
+			}
+			if (OutChunks.Num() == FPlatformHardwareBreakpointTraits::NumSlots)
+			{
+				return INDEX_NONE;
+			}
+			OutChunks.Emplace(Address, ChunkSize);
+			Address += ChunkSize;
+			Size -= ChunkSize;
+		}
+		return OutChunks.Num();
+	}
+
+	static void HarvestWindow()
+	{
+		const double Elapsed = FPlatformTime::Seconds() - WindowStartTime;
+		TSet<int32> WatchedThisWindow;
+		for (const FActiveWatch& Watch : ActiveWatches)
+		{
+			if (!IsOwnWatch(Watch))
+			{
+				continue;
+			}
+			FHardwareBreakpointHitCounters Counters;
+			if (FPlatformHardwareBreakpoints::GetHitCounters(Watch.Slot, Counters))
+			{
+				FPropertyStats& PropertyStats = Stats[Watch.StatsIndex];
+				PropertyStats.Writes += Counters.TotalHits;
+				PropertyStats.UntrackedWrites += Counters.UntrackedHits;
+				for (const FHardwareBreakpointHitCounters::FCallSite& CallSite : Counters.CallSites)
+				{
+					if (CallSite.Count > 0)
+					{
+						PropertyStats.CallSites.FindOrAdd(CallSite.ProgramCounter) += CallSite.Count;
+					}
+				}
+			}
+			WatchedThisWindow.Add(Watch.StatsIndex);
+		}
+		//Only removed once every counter was read, the chunks of a property are linked and go away together
+		for (const FActiveWatch& Watch : ActiveWatches)
+		{
+			RemoveOwnWatch(Watch);
+		}
+		for (int32 StatsIndex : WatchedThisWindow)
+		{
+			Stats[StatsIndex].WatchedSeconds += Elapsed;
+			Stats[StatsIndex].WatchedFrames += FramesInWindow;
+		}
+		//A class that fits in the free slots is watched whole every window and never rotates, its report is left to Stop/Report
+		if (WatchedThisWindow.Num() < Stats.Num())
+		{
+			PropertiesSinceReport += WatchedThisWindow.Num();
+		}
+		ActiveWatches.Reset();
+	}
+
+	//Arms as many properties as there are free slots, starting at NextProperty
+	static void ArmNextWindow(UObject* Object)
+	{
+		const int32 FirstProperty = NextProperty;
+		TArray<TPair<uint8*, int32>, TInlineAllocator<FPlatformHardwareBreakpointTraits::NumSlots>> Chunks;
+		bool bSlotsFull = false;
+		do
+		{
+			FPropertyStats& PropertyStats = Stats[NextProperty];
+			uint8* Address = PropertyStats.Property->ContainerPtrToValuePtr<uint8>(Object);
+			if (PlanChunks(Address, PropertyStats.Property->GetSize(), Chunks) != INDEX_NONE)
+			{
+				const int32 FirstWatch = ActiveWatches.Num();
+				for (const TPair<uint8*, int32>& Chunk : Chunks)
+				{
+					DebugRegisterIndex Slot = FPlatformHardwareBreakpoints::SetCountingDataBreakpoint(Chunk.Key, Chunk.Value);
+					if (Slot < 0)
+					{
+						bSlotsFull = true;
+						break;
+					}
+					ActiveWatches.Add({ NextProperty, Slot, Chunk.Key });
+				}
+				if (bSlotsFull)
+				{
+					//Partially watched properties would report wrong rates, so this one waits for the next window
+					for (int32 i = FirstWatch; i < ActiveWatches.Num(); ++i)
+					{
+						RemoveOwnWatch(ActiveWatches[i]);
+					}
+					ActiveWatches.SetNum(FirstWatch);
+					break;
+				}
+				//A store that spans several chunks fires all of them at once, linked chunks count it once for the property
+				DebugRegisterIndex PropertySlots[FPlatformHardwareBreakpointTraits::NumSlots];
+				for (int32 i = FirstWatch; i < ActiveWatches.Num(); ++i)
+				{
+					PropertySlots[i - FirstWatch] = ActiveWatches[i].Slot;
+				}
+				FPlatformHardwareBreakpoints::LinkBreakpoints(PropertySlots, ActiveWatches.Num() - FirstWatch);
+			}
+			NextProperty = (NextProperty + 1) % Stats.Num();
+		}
+		while (NextProperty != FirstProperty);
+
+		if (ActiveWatches.Num() == 0)
+		{
+			UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Write profiler couldn't arm any breakpoint, all slots are in use"));
+		}
+		FramesInWindow = 0;
+		WindowStartTime = FPlatformTime::Seconds();
+	}
+
+	static bool Tick(float DeltaTime)
+	{
+		UObject* Object = Target.Get();
+		if (Object == nullptr)
+		{
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("Write profiler target was destroyed, stopping"));
+			Stop();
+			return false;
+		}
+		if (++FramesInWindow >= FramesPerWindow)
+		{
+			HarvestWindow();
+			if (PropertiesSinceReport >= Stats.Num())
+			{
+				//Finished a full rotation over the class
+				PropertiesSinceReport -= Stats.Num();
+				DumpReport();
+			}
+			ArmNextWindow(Object);
+		}
+		return true;
+	}
+
+	bool Start(UObject* Object, int32 InFramesPerWindow)
+	{
+		Stop();
+		if (Object == nullptr)
+		{
+			return false;
+		}
+
+		Stats.Reset();
+		TArray<TPair<uint8*, int32>, TInlineAllocator<FPlatformHardwareBreakpointTraits::NumSlots>> Chunks;
+		for (TFieldIterator<PropertyType> It(Object->GetClass()); It; ++It)
+		{
+			//Containers are headers pointing somewhere else, their contents would need a path of their own
+			if (CAST_PROPERTY<ArrayPropertyType>(*It) || CAST_PROPERTY<MapPropertyType>(*It) || CAST_PROPERTY<SetPropertyType>(*It))
+			{
+				continue;
+			}
+			//The object doesn't move, so a property that can't be covered by the slots now never will be
+			if (PlanChunks(It->ContainerPtrToValuePtr<uint8>(Object), It->GetSize(), Chunks) == INDEX_NONE)
+			{
+				UE_LOG(LogHardwareBreakpoints, Warning, TEXT("Write profiler skips %s::%s, its %d bytes need more than %d breakpoint slots"),
+					*It->GetOwnerStruct()->GetName(), *It->GetName(), It->GetSize(), FPlatformHardwareBreakpointTraits::NumSlots);
+				continue;
+			}
+			FPropertyStats& PropertyStats = Stats[Stats.AddDefaulted()];
+			PropertyStats.Property = *It;
+			PropertyStats.Name = FString::Printf(TEXT("%s::%s"), *It->GetOwnerStruct()->GetName(), *It->GetName());
+		}
+		if (Stats.Num() == 0)
+		{
+			return false;
+		}
+
+		Target = Object;
+		FramesPerWindow = FMath::Max(1, InFramesPerWindow);
+		NextProperty = 0;
+		PropertiesSinceReport = 0;
+		ArmNextWindow(Object);
+		TickerHandle = FHWBP_Ticker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&Tick));
+		RemoveBreakpointHandle = CallStackViewer::OnRemoveBreakpoint.AddStatic(&OnBreakpointRemoved);
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("Write profiler started on %s: %d properties, %d frames per window"), *Object->GetName(), Stats.Num(), FramesPerWindow);
+		return true;
+	}
+
+	void Stop()
+	{
+		if (TickerHandle.IsValid())
+		{
+			FHWBP_Ticker::GetCoreTicker().RemoveTicker(TickerHandle);
+			TickerHandle.Reset();
+		}
+		if (ActiveWatches.Num() > 0)
+		{
+			HarvestWindow();
+		}
+		if (RemoveBreakpointHandle.IsValid())
+		{
+			CallStackViewer::OnRemoveBreakpoint.Remove(RemoveBreakpointHandle);
+			RemoveBreakpointHandle.Reset();
+		}
+		Target.Reset();
+	}
+
+	bool IsRunning()
+	{
+		return TickerHandle.IsValid();
+	}
+
+	void DumpReport(int32 MaxProperties)
+	{
+		TArray<const FPropertyStats*> Sorted;
+		for (const FPropertyStats& PropertyStats : Stats)
+		{
+			if (PropertyStats.WatchedSeconds > 0.0)
+			{
+				Sorted.Add(&PropertyStats);
+			}
+		}
+		Sorted.Sort([](const FPropertyStats& A, const FPropertyStats& B)
+		{
+			return A.Writes / A.WatchedSeconds > B.Writes / B.WatchedSeconds;
+		});
+
+		FPlatformStackWalk::InitStackWalking();
+		UE_LOG(LogHardwareBreakpoints, Log, TEXT("============= PROPERTY WRITE FREQUENCY ============="));
+		for (int32 i = 0; i < Sorted.Num() && i < MaxProperties; ++i)
+		{
+			const FPropertyStats& PropertyStats = *Sorted[i];
+			if (PropertyStats.Writes == 0)
+			{
+				break;
+			}
+			UE_LOG(LogHardwareBreakpoints, Log, TEXT("%s: %.1f writes/sec, %.2f writes/frame (watched %.1fs, %llu frames)"),
+				*PropertyStats.Name,
+				PropertyStats.Writes / PropertyStats.WatchedSeconds,
+				PropertyStats.WatchedFrames > 0 ? (double)PropertyStats.Writes / PropertyStats.WatchedFrames : 0.0,
+				PropertyStats.WatchedSeconds,
+				PropertyStats.WatchedFrames);
+
+			TArray<TPair<uint64, uint64>> TopWriters;
+			for (const TPair<uint64, uint64>& CallSite : PropertyStats.CallSites)
+			{
+				TopWriters.Add(CallSite);
+			}
+			TopWriters.Sort([](const TPair<uint64, uint64>& A, const TPair<uint64, uint64>& B) { return A.Value > B.Value; });
+			for (int32 j = 0; j < TopWriters.Num() && j < 3; ++j)
+			{
+				ANSICHAR HumanReadableString[1024] = { 0 };
+				FPlatformStackWalk::ProgramCounterToHumanReadableString(0, TopWriters[j].Key, HumanReadableString, sizeof(HumanReadableString));
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %llu writes from %s"), TopWriters[j].Value, ANSI_TO_TCHAR(HumanReadableString));
+			}
+			if (PropertyStats.UntrackedWrites > 0)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("    %llu writes from untracked call sites"), PropertyStats.UntrackedWrites);
+			}
+		}
+	}
+
+	static FAutoConsoleCommand StartCommand(
+		TEXT("HWBP.WriteProfiler.Start"),
+		TEXT("Rotates count-only data breakpoints over the properties of an object. Usage: HWBP.WriteProfiler.Start <ObjectName> [FramesPerWindow]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() < 1)
+			{
+				return;
+			}
+#if ENGINE_MAJOR_VERSION > 5 || ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1
+			UObject* Object = FindFirstObject<UObject>(*Args[0], EFindFirstObjectOptions::None);
+#else
+			UObject* Object = FindObject<UObject>(ANY_PACKAGE, *Args[0]);
+#endif
+			int32 Frames = 30;
+			if (Args.Num() > 1)
+			{
+				LexFromString(Frames, *Args[1]);
+			}
+			if (!Start(Object, Frames))
+			{
+				UE_LOG(LogHardwareBreakpoints, Error, TEXT("Couldn't start write profiler on %s"), *Args[0]);
+			}
+		})
+	);
+
+	static FAutoConsoleCommand StopCommand(
+		TEXT("HWBP.WriteProfiler.Stop"),
+		TEXT("Stops the write profiler and prints its report"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			Stop();
+			DumpReport();
+		})
+	);
+
+	static FAutoConsoleCommand ReportCommand(
+		TEXT("HWBP.WriteProfiler.Report"),
+		TEXT("Prints the write profiler report collected so far"),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			DumpReport();
+		})
+	);
+}
@@ -0,0 +1,22 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UObject;
+
+//Finds properties that are written far more often than needed
+//Rotates count-only data breakpoints over the properties of an object's class, a few frames per group of properties,
+//and reports writes/sec per property with its top writing call sites
+//The report is logged after every full rotation over the class. Properties too big for the slots to cover are skipped, with a warning on start
+//Console: HWBP.WriteProfiler.Start <Object> [FramesPerWindow], HWBP.WriteProfiler.Stop, HWBP.WriteProfiler.Report
+namespace HWBP_WriteProfiler
+{
+	bool Start(UObject* Object, int32 FramesPerWindow = 30);
+	void Stop();
+	bool IsRunning();
+
+	//Logs the properties sorted by writes/sec, with the top call sites for each
+	void DumpReport(int32 MaxProperties = 20);
+}
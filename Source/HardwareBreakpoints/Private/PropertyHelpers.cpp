@@ -166,14 +166,41 @@ namespace PropertyHelpers
 		{
 			FPropertyAndIndex PropertyAndIndex = FindPropertyAndArrayIndex(InStruct, InPropertyNames[Index]);
 
+			if (PropertyAndIndex.ArrayIndex != INDEX_NONE && !InPropertyNames.IsValidIndex(Index + 1))
+			{
+				//Subscript on an FString addresses a single character
+				if (StrPropertyType* StrProp = CAST_PROPERTY<StrPropertyType>(PropertyAndIndex.Property))
+				{
+					FString* String = StrProp->ContainerPtrToValuePtr<FString>(BasePointer);
+					if (String->GetCharArray().IsValidIndex(PropertyAndIndex.ArrayIndex))
+					{
+						NewAddress.Property = StrProp;
+						NewAddress.Address = &String->GetCharArray()[PropertyAndIndex.ArrayIndex];
+						NewAddress.ContainerHeader = &String->GetCharArray();
+						NewAddress.ContainerIndex = PropertyAndIndex.ArrayIndex;
+						NewAddress.ContainerElementSize = sizeof(TCHAR);
+					}
+					break;
+				}
+			}
+
 			if (PropertyAndIndex.ArrayIndex != INDEX_NONE)
 			{
 				const ArrayPropertyType* ArrayProp = CAST_PROPERTY<ArrayPropertyType>(PropertyAndIndex.Property);
+				if (ArrayProp == nullptr)
+				{
+					break;
+				}
 
 				FScriptArrayHelper ArrayHelper(ArrayProp, ArrayProp->ContainerPtrToValuePtr<void>(BasePointer));
 
 				if (ArrayHelper.IsValidIndex(PropertyAndIndex.ArrayIndex))
 				{
+					//Remember the innermost container, anything we resolve inside this element moves with it when the array reallocates
+					NewAddress.ContainerHeader = ArrayProp->ContainerPtrToValuePtr<void>(BasePointer);
+					NewAddress.ContainerIndex = PropertyAndIndex.ArrayIndex;
+					NewAddress.ContainerElementSize = ArrayProp->Inner->GetSize();
+
 					StructPropertyType* InnerStructProp = CAST_PROPERTY<StructPropertyType>(ArrayProp->Inner);
 					if (InnerStructProp && InPropertyNames.IsValidIndex(Index + 1))
 					{
@@ -218,6 +245,10 @@ namespace PropertyHelpers
 					UObject* Object = ObjectProp->GetObjectPropertyValue(ObjectContainer);
 					if (Object)
 					{
+						//Following an object pointer leaves the memory of any container we were in
+						NewAddress.ContainerHeader = nullptr;
+						NewAddress.ContainerIndex = INDEX_NONE;
+						NewAddress.ContainerElementSize = 0;
 						BasePointer = Object;
 						InStruct = Object->GetClass();
 						continue;
@@ -257,4 +288,351 @@ namespace PropertyHelpers
 			return FPropertyAddress();
 		}
 	}
+
+	//Like the lookup in FindPropertyAndArrayIndex, but without subscript parsing, and also matching BP struct display names for plain names
+	static PropertyType* FindPropertyByName(UStruct* InStruct, const FString& PropertyName)
+	{
+		if (auto UserDefinedStruct = Cast<UUserDefinedStruct>(InStruct))
+		{
+			if (PropertyType* Property = FindBPStructField(UserDefinedStruct, PropertyName))
+			{
+				return Property;
+			}
+		}
+#if ENGINE_MAJOR_VERSION >= 5 || ENGINE_MAJOR_VERSION == 4 && ENGINE_MINOR_VERSION >= 25
+		return FindFProperty<FProperty>(InStruct, *PropertyName);
+#else
+		return FindField<UProperty>(InStruct, *PropertyName);
+#endif
+	}
+
+	//Moves into the value of a struct or object property so the next segment can be looked up in it
+	static bool DescendIntoValue(PropertyType* ValueProperty, void* ValuePtr, void*& OutBase, UStruct*& OutStruct)
+	{
+		if (StructPropertyType* StructProp = CAST_PROPERTY<StructPropertyType>(ValueProperty))
+		{
+			OutBase = ValuePtr;
+			OutStruct = StructProp->Struct;
+			return true;
+		}
+		if (UObjectPropertyType* ObjectProp = CAST_PROPERTY<UObjectPropertyType>(ValueProperty))
+		{
+			UObject* Object = ObjectProp->GetObjectPropertyValue(ValuePtr);
+			if (Object)
+			{
+				OutBase = Object;
+				OutStruct = Object->GetClass();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static PropertyType* FindSegmentProperty(const FCompiledPropertyPath::FSegment& Segment, UStruct* InStruct)
+	{
+		if (PropertyType** Cached = Segment.PropertyCache.Find(InStruct))
+		{
+			return *Cached;
+		}
+		PropertyType* Property = FindPropertyByName(InStruct, Segment.Name);
+		Segment.PropertyCache.Add(InStruct, Property);
+		return Property;
+	}
+
+	bool FCompiledPropertyPath::Compile(const FString& InPropertyPath)
+	{
+		Segments.Reset();
+		FirstWildcard = INDEX_NONE;
+		Path = InPropertyPath;
+
+		TArray<FString> PropertyNames;
+		InPropertyPath.ParseIntoArray(PropertyNames, TEXT("."), true);
+
+		for (const FString& PropertyName : PropertyNames)
+		{
+			FSegment& Segment = Segments[Segments.AddDefaulted()];
+			Segment.Name = PropertyName;
+
+			int32 OpenIndex = 0;
+			if (PropertyName.EndsWith(TEXT("]")) && PropertyName.FindLastChar('[', OpenIndex))
+			{
+				Segment.Name = PropertyName.Left(OpenIndex);
+				const FString Subscript = PropertyName.Mid(OpenIndex + 1, PropertyName.Len() - OpenIndex - 2);
+				if (Subscript == TEXT("*"))
+				{
+					Segment.bWildcard = true;
+					if (FirstWildcard == INDEX_NONE)
+					{
+						FirstWildcard = Segments.Num() - 1;
+					}
+				}
+				else if (Subscript.Len() > 0 && Subscript.Len() <= 10 && Subscript.IsNumeric())
+				{
+					LexFromString(Segment.ArrayIndex, *Subscript);
+				}
+				else
+				{
+					Segments.Reset();
+					FirstWildcard = INDEX_NONE;
+					return false;
+				}
+			}
+		}
+		return Segments.Num() > 0;
+	}
+
+	int32 FCompiledPropertyPath::FindNextWildcard(int32 StartSegment) const
+	{
+		for (int32 Index = StartSegment; Index < Segments.Num(); ++Index)
+		{
+			if (Segments[Index].bWildcard)
+			{
+				return Index;
+			}
+		}
+		return INDEX_NONE;
+	}
+
+	bool FCompiledPropertyPath::ResolveRange(int32 StartSegment, int32 EndSegment, void*& InOutBase, UStruct*& InOutStruct, FPropertyAddress& OutLeaf) const
+	{
+		for (int32 Index = StartSegment; Index < EndSegment; ++Index)
+		{
+			const FSegment& Segment = Segments[Index];
+			check(!Segment.bWildcard);
+
+			PropertyType* Property = FindSegmentProperty(Segment, InOutStruct);
+			if (Property == nullptr)
+			{
+				return false;
+			}
+
+			PropertyType* ValueProperty = Property;
+			void* ValuePtr = nullptr;
+			if (Segment.ArrayIndex != INDEX_NONE)
+			{
+				const ArrayPropertyType* ArrayProp = CAST_PROPERTY<ArrayPropertyType>(Property);
+				if (ArrayProp == nullptr)
+				{
+					return false;
+				}
+				FScriptArrayHelper ArrayHelper(ArrayProp, ArrayProp->ContainerPtrToValuePtr<void>(InOutBase));
+				if (!ArrayHelper.IsValidIndex(Segment.ArrayIndex))
+				{
+					return false;
+				}
+				ValueProperty = ArrayProp->Inner;
+				ValuePtr = ArrayHelper.GetRawPtr(Segment.ArrayIndex);
+			}
+			else
+			{
+				ValuePtr = Property->ContainerPtrToValuePtr<void>(InOutBase);
+			}
+
+			if (Index == Segments.Num() - 1)
+			{
+				OutLeaf.Property = ValueProperty;
+				OutLeaf.Address = ValuePtr;
+				return true;
+			}
+			if (!DescendIntoValue(ValueProperty, ValuePtr, InOutBase, InOutStruct))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void FPropertyPathExpansion::Reset(const FCompiledPropertyPath& InPath)
+	{
+		Path = InPath;
+		PrefixLeaf = FPropertyAddress();
+		Root.Reset();
+	}
+
+	int32 FPropertyPathExpansion::Update(void* BasePointer, UStruct* InStruct, TArray<FPropertyAddress>* OutAdded)
+	{
+		if (!Path.IsValid() || BasePointer == nullptr || InStruct == nullptr)
+		{
+			return 0;
+		}
+
+		const int32 Wildcard = Path.FindNextWildcard(0);
+		void* Base = BasePointer;
+		UStruct* Struct = InStruct;
+		FPropertyAddress Leaf;
+		const bool bResolved = Path.ResolveRange(0, Wildcard == INDEX_NONE ? Path.Num() : Wildcard, Base, Struct, Leaf);
+
+		//No wildcards, this is just a cached single address
+		if (Wildcard == INDEX_NONE)
+		{
+			if (Leaf.Address == PrefixLeaf.Address)
+			{
+				return 0;
+			}
+			const int32 Changed = (PrefixLeaf.Address ? 1 : 0) + (Leaf.Address ? 1 : 0);
+			PrefixLeaf = Leaf;
+			if (OutAdded && Leaf.Address)
+			{
+				OutAdded->Add(Leaf);
+			}
+			return Changed;
+		}
+
+		if (!bResolved)
+		{
+			const int32 Changed = Root.IsValid() ? CountAddresses(*Root) : 0;
+			Root.Reset();
+			return Changed;
+		}
+		if (!Root.IsValid())
+		{
+			Root = MakeShared<FNode>();
+		}
+		return UpdateNode(*Root, Wildcard, Base, Struct, OutAdded);
+	}
+
+	int32 FPropertyPathExpansion::UpdateNode(FNode& Node, int32 WildcardSegment, void* BasePointer, UStruct* InStruct, TArray<FPropertyAddress>* OutAdded)
+	{
+		int32 Changed = 0;
+		const ArrayPropertyType* ArrayProp = CAST_PROPERTY<ArrayPropertyType>(FindSegmentProperty(Path[WildcardSegment], InStruct));
+		if (ArrayProp == nullptr)
+		{
+			Changed += CountAddresses(Node);
+			Node.Elements.Reset();
+			Node.ArrayContainer = nullptr;
+			Node.ArrayData = nullptr;
+			return Changed;
+		}
+
+		void* ArrayContainer = ArrayProp->ContainerPtrToValuePtr<void>(BasePointer);
+		const void* ArrayData = static_cast<FScriptArray*>(ArrayContainer)->GetData();
+		FScriptArrayHelper ArrayHelper(ArrayProp, ArrayContainer);
+
+		//If the array moved or reallocated, every element address we have is stale
+		if (Node.ArrayContainer != ArrayContainer || Node.ArrayData != ArrayData)
+		{
+			Changed += CountAddresses(Node);
+			Node.Elements.Reset();
+			Node.ArrayContainer = ArrayContainer;
+			Node.ArrayData = ArrayData;
+		}
+
+		const int32 NewNum = ArrayHelper.Num();
+		for (int32 Index = NewNum; Index < Node.Elements.Num(); ++Index)
+		{
+			Changed += CountAddresses(Node.Elements[Index]);
+		}
+		Node.Elements.SetNum(NewNum);
+
+		for (int32 Index = 0; Index < NewNum; ++Index)
+		{
+			UpdateElement(Node.Elements[Index], WildcardSegment, ArrayProp, ArrayHelper.GetRawPtr(Index), OutAdded, Changed);
+		}
+		return Changed;
+	}
+
+	void FPropertyPathExpansion::UpdateElement(FElement& Element, int32 WildcardSegment, const ArrayPropertyType* ArrayProp, void* ElementPtr, TArray<FPropertyAddress>* OutAdded, int32& InOutChanged)
+	{
+		PropertyType* Inner = ArrayProp->Inner;
+		const void* Key = ElementPtr;
+		if (UObjectPropertyType* ObjectProp = CAST_PROPERTY<UObjectPropertyType>(Inner))
+		{
+			Key = ObjectProp->GetObjectPropertyValue(ElementPtr);
+		}
+
+		//Element was already expanded through the same memory/object, and there's no nested wildcard that could have changed
+		if (Element.Key == Key && Key != nullptr && Element.Leaf.Address != nullptr)
+		{
+			return;
+		}
+		if (Element.Key != Key)
+		{
+			InOutChanged += CountAddresses(Element);
+			Element = FElement();
+			Element.Key = Key;
+		}
+
+		FPropertyAddress Leaf;
+		if (WildcardSegment == Path.Num() - 1)
+		{
+			Leaf.Property = Inner;
+			Leaf.Address = ElementPtr;
+		}
+		else
+		{
+			void* Base = nullptr;
+			UStruct* Struct = nullptr;
+			if (!DescendIntoValue(Inner, ElementPtr, Base, Struct))
+			{
+				return;
+			}
+			const int32 NextWildcard = Path.FindNextWildcard(WildcardSegment + 1);
+			const int32 EndSegment = NextWildcard == INDEX_NONE ? Path.Num() : NextWildcard;
+			if (!Path.ResolveRange(WildcardSegment + 1, EndSegment, Base, Struct, Leaf))
+			{
+				return;
+			}
+			if (NextWildcard != INDEX_NONE)
+			{
+				if (!Element.Child.IsValid())
+				{
+					Element.Child = MakeShared<FNode>();
+				}
+				InOutChanged += UpdateNode(*Element.Child, NextWildcard, Base, Struct, OutAdded);
+				return;
+			}
+		}
+
+		if (Leaf.Address)
+		{
+			Element.Leaf = Leaf;
+			++InOutChanged;
+			if (OutAdded)
+			{
+				OutAdded->Add(Leaf);
+			}
+		}
+	}
+
+	void FPropertyPathExpansion::GetAddresses(TArray<FPropertyAddress>& OutAddresses) const
+	{
+		if (PrefixLeaf.Address)
+		{
+			OutAddresses.Add(PrefixLeaf);
+		}
+		if (Root.IsValid())
+		{
+			CollectAddresses(*Root, OutAddresses);
+		}
+	}
+
+	void FPropertyPathExpansion::CollectAddresses(const FNode& Node, TArray<FPropertyAddress>& OutAddresses)
+	{
+		for (const FElement& Element : Node.Elements)
+		{
+			if (Element.Leaf.Address)
+			{
+				OutAddresses.Add(Element.Leaf);
+			}
+			if (Element.Child.IsValid())
+			{
+				CollectAddresses(*Element.Child, OutAddresses);
+			}
+		}
+	}
+
+	int32 FPropertyPathExpansion::CountAddresses(const FNode& Node)
+	{
+		int32 Count = 0;
+		for (const FElement& Element : Node.Elements)
+		{
+			Count += CountAddresses(Element);
+		}
+		return Count;
+	}
+
+	int32 FPropertyPathExpansion::CountAddresses(const FElement& Element)
+	{
+		return (Element.Leaf.Address ? 1 : 0) + (Element.Child.IsValid() ? CountAddresses(*Element.Child) : 0);
+	}
 }
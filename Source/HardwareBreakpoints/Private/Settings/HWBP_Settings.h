@@ -6,6 +6,28 @@
 #include "UObject/NoExportTypes.h"
 #include "HWBP_Settings.generated.h"
 
+UENUM()
+enum class EHWBP_SymbolPreload : uint8
+{
+	//Symbols are loaded on the first hit that shows a callstack, after asking
+	Disabled,
+	//Start loading symbols in the background when the plugin starts
+	AtStartup,
+	//Start loading symbols in the background when the first breakpoint is set
+	OnFirstBreakpoint,
+};
+
+UENUM()
+enum class EHWBP_StackWalker : uint8
+{
+	//StackWalk64. The most robust, and by far the slowest
+	DbgHelp,
+	//Walks the unwind tables of the loaded modules directly, with a cache of function lookups
+	UnwindTables,
+	//Follows saved frame pointers, well under a microsecond for short stacks. Falls back to the unwind tables when the chain
+	//doesn't look valid, e.g. in modules built without frame pointers
+	FramePointers,
+};
 
 UCLASS(config = HardwareBreakpoints, notplaceable)
 class UHWBP_Settings : public UObject
@@ -18,4 +40,21 @@ public:
 
 	UPROPERTY(config, EditAnywhere, Category = HardwareBreakpoints, meta = (DisplayName = "Don't break even if debugger is attached"))
 	bool DontBreakEvenIfDebuggerAttached;
+
+	//Hits that arrive while symbols are still loading are logged with their callstack once loading is done, instead of freezing the application
+	UPROPERTY(config, EditAnywhere, Category = HardwareBreakpoints, meta = (DisplayName = "Preload debug symbols in the background"))
+	EHWBP_SymbolPreload SymbolPreload = EHWBP_SymbolPreload::Disabled;
+
+	//How callstacks of hits are captured, both for the callstack window and for recorders like the hit log
+	UPROPERTY(config, EditAnywhere, Category = HardwareBreakpoints)
+	EHWBP_StackWalker StackWalker = EHWBP_StackWalker::DbgHelp;
+
+	//Frames captured for the callstack of a hit. Can be overridden per breakpoint with FPlatformHardwareBreakpoints::SetBreakpointStackDepth
+	UPROPERTY(config, EditAnywhere, Category = HardwareBreakpoints, meta = (ClampMin = 1, ClampMax = 256))
+	int32 StackDepth = 100;
+
+	//Hits that don't open the callstack window only walk and log the stack of a call site (slot, instruction and return address)
+	//once per this many frames. Later hits from it are counted, see HWBP.Stacks.Report. 0 logs the stack of every hit
+	UPROPERTY(config, EditAnywhere, Category = HardwareBreakpoints, meta = (ClampMin = 0, DisplayName = "Collapse repeated call sites (frames)"))
+	int32 StackDedupeFrames = 1;
 };
@@ -2,9 +2,14 @@
 
 #include "Windows/WindowsPlatformHardwareBreakpoints.h"
 
+#include <atomic>
+
 #include "HAL/PlatformStackWalk.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
 #include "Windows/AllowWindowsPlatformTypes.h"
 	#include <DbgHelp.h>
+	#include <TlHelp32.h>
 #include "Windows/HideWindowsPlatformTypes.h"
 #include "Runtime/Launch/Resources/Version.h"
 #include "Internationalization/Text.h"
@@ -14,6 +19,12 @@
 
 #include "WindowsPlatformHardwareBreakpointsUser.h"
 #include "Misc/HWBP_Build.h"
+#include "HWBP_SymbolCache.h"
+#include "HWBP_SymbolPreloader.h"
+#include "HWBP_StackDedupe.h"
+#include "HWBP_Trace.h"
+#include "HWBP_Core/HWBP_DebugRegisters.h"
+#include "HWBP_Core/HWBP_FrameWalk.h"
 
 #if ENGINE_MAJOR_VERSION >= 5 || ENGINE_MAJOR_VERSION == 4 && ENGINE_MINOR_VERSION >= 20
 #include "HardwareBreakpointsLog.h"
@@ -35,6 +46,8 @@ PRAGMA_DISABLE_OPTIMIZATION
 enum EDebugRegisterOperation
 {
 	Set,
+	//Set on RegisterIndex, whether it's free or not (used to mirror a slot to other threads)
+	SetAt,
 	Remove,
 	RemoveAll
 };
@@ -51,13 +64,30 @@ struct FHardwareBreakpointData
 	bool RegistersChanged = { false };
 };
 
-template <typename T>
-static void SetBits(T& Register, int LowBit, int BitCount, int NewBits)
+//The exception handler is only installed while some slot is armed, so sessions that never set a breakpoint
+//don't put it in front of every SEH exception in the process
+namespace HardwareBreakpointsUtils
 {
-	T Mask = (1 << BitCount) - 1; 
-	Register = (Register & ~(Mask << LowBit)) | (NewBits << LowBit);
+	static PVOID GExceptionHandlerHandle = nullptr;
+	static FCriticalSection ExceptionHandlerLock;
+	//One bit per slot in use, process wide like DataBreakpointInfo. Native function breakpoints don't fill DataBreakpointInfo,
+	//so this is tracked here. Per thread register counts can't be used, a thread that exits with a slot armed is never visited again
+	static std::atomic<uint32> ArmedSlots{ 0 };
+	//Slots mirrored to every thread. Removing one of these from inside the handler only disarms the thread that hit it
+	static std::atomic<uint32> AllThreadsSlots{ 0 };
+	//Threads that disabled a breakpoint to step over it and still have to restore their debug registers
+	static std::atomic<int32> PendingSingleSteps{ 0 };
+	//Per thread: with breakpoints armed on every thread, several threads can be stepping over a breakpoint at the same time
+	static thread_local bool WaitingForSingleStep = false;
 }
 
+static_assert((int)HWBP_Core::EAccess::Execute == (int)EHardwareBreakpointType::Execute
+	&& (int)HWBP_Core::EAccess::ReadWrite == (int)EHardwareBreakpointType::ReadWrite
+	&& (int)HWBP_Core::EAccess::Write == (int)EHardwareBreakpointType::Write, "HWBP_Core::EAccess must match EHardwareBreakpointType");
+static_assert(FPlatformHardwareBreakpointTraits::NumSlots == HWBP_Core::NumDebugRegisters, "Windows should use the x64 debug register traits");
+//DR0-DR3, DR6 and DR7 are contiguous in CONTEXT, the single step restore in the handler relies on it too
+static_assert(sizeof(HWBP_Core::FDebugRegisterState) == 6 * sizeof(DWORD64), "FDebugRegisterState must match the debug registers in CONTEXT");
+
 static DWORD WINAPI ApplyDebugRegisterChanges(LPVOID Parameter)
 {
 	FHardwareBreakpointData* Data = (FHardwareBreakpointData*)Parameter;
@@ -72,76 +102,36 @@ static DWORD WINAPI ApplyDebugRegisterChanges(LPVOID Parameter)
 	LastCallResult = GetThreadContext(Data->ThreadHandle, &Context);
     LastError = GetLastError();
 
-	bool Busy[4];
-
-	Busy[0] = (Context.Dr7 & 1) != 0;
-	Busy[1] = (Context.Dr7 & 4) != 0;
-	Busy[2] = (Context.Dr7 & 16) != 0;
-	Busy[3] = (Context.Dr7 & 64) != 0;
-
-	auto DebugRegisters = &Context.Dr0;
+	HWBP_Core::FDebugRegisterState Registers;
+	FMemory::Memcpy(&Registers, &Context.Dr0, sizeof(Registers));
 
 	switch (Data->OperationToPerform)
 	{
 	case EDebugRegisterOperation::Set:
+	case EDebugRegisterOperation::SetAt:
 		{
-			for (; Data->RegisterIndex < 4; ++Data->RegisterIndex)
-			{
-				if (!Busy[Data->RegisterIndex])
-					break;
-			}
-			if (Data->RegisterIndex < 4)
-			{
-				DebugRegisters[Data->RegisterIndex] = (DWORD_PTR)Data->Address;
-			}
-			else
+			const int Slot = Registers.Arm((uint64)Data->Address, (HWBP_Core::EAccess)Data->Type, 1 << (int)Data->Size, Data->RegisterIndex, Data->OperationToPerform == EDebugRegisterOperation::SetAt);
+			if (Slot < 0)
 			{
 				Data->Success = false;
 				LastCallResult = ResumeThread(Data->ThreadHandle);
 				LastError = GetLastError();
 				return 0;
 			}
-			Context.Dr6 = 0;
-			int TypeBits;
-			switch (Data->Type)
-			{
-			case EHardwareBreakpointType::Execute:		TypeBits = 0; break;
-			case EHardwareBreakpointType::ReadWrite:	TypeBits = 3; break;
-			case EHardwareBreakpointType::Write:		TypeBits = 1; break;
-			default: TypeBits = 0; break;
-			}
-			int SizeBits;
-			switch (Data->Size)
-			{
-			case EHardwareBreakpointSize::Size_1: SizeBits = 0; break;
-			case EHardwareBreakpointSize::Size_2: SizeBits = 1; break;
-			case EHardwareBreakpointSize::Size_4: SizeBits = 3; break;
-			case EHardwareBreakpointSize::Size_8: SizeBits = 2; break;
-			default: SizeBits = 0; break;;
-			}
-
-			SetBits(Context.Dr7, 16 + Data->RegisterIndex * 4, 2, TypeBits);
-			SetBits(Context.Dr7, 18 + Data->RegisterIndex * 4, 2, SizeBits);
-			SetBits(Context.Dr7, Data->RegisterIndex * 2, 1, 1);
+			Data->RegisterIndex = Slot;
 		}
 		break;
 
 	case EDebugRegisterOperation::Remove:
-		DebugRegisters[Data->RegisterIndex] = 0;
-		Data->RegistersChanged = Busy[Data->RegisterIndex];
-		Context.Dr7 &= ~(1 << (Data->RegisterIndex * 2));
+		Data->RegistersChanged = Registers.Disarm(Data->RegisterIndex);
 		break;
 
 	case EDebugRegisterOperation::RemoveAll:
-		for (int i = 0; i < 4; ++i)
-		{
-			DebugRegisters[i] = 0;
-			Data->RegistersChanged = Data->RegistersChanged || Busy[i];
-			Context.Dr7 &= ~(1 << (i * 2));
-		}
+		Data->RegistersChanged = Registers.DisarmAll();
 		break;
 	}
 
+	FMemory::Memcpy(&Context.Dr0, &Registers, sizeof(Registers));
 	Context.ContextFlags = CONTEXT_DEBUG_REGISTERS;
 	LastCallResult = SetThreadContext(Data->ThreadHandle,&Context);
     LastError = GetLastError();
@@ -155,6 +145,12 @@ static DWORD WINAPI ApplyDebugRegisterChanges(LPVOID Parameter)
 
 DebugRegisterIndex FWindowsPlatformHardwareBreakpoints::SetHardwareBreakpoint(EHardwareBreakpointType Type,EHardwareBreakpointSize Size,void* Address)
 {
+	if (!FPlatformHardwareBreakpointTraits::SupportsType(Type) || !FPlatformHardwareBreakpointTraits::SupportsSize(Size))
+	{
+		return -1;
+	}
+	//Installed before arming, a watch on shared memory can be hit by another thread right away
+	AddStructuredExceptionHandler();
 	HANDLE hThread = GetCurrentThread();
 	FHardwareBreakpointData Data;
 	Data.Address = Address;
@@ -173,11 +169,73 @@ DebugRegisterIndex FWindowsPlatformHardwareBreakpoints::SetHardwareBreakpoint(EH
 
 	if (!Data.Success)
 	{
+		RemoveStructuredExceptionHandlerIfIdle();
 		return -1;
 	}
+	HardwareBreakpointsUtils::ArmedSlots |= 1u << Data.RegisterIndex;
+	HWBP_TRACE_SET(Data.RegisterIndex, Type, Address);
+	if (GetDefault<UHWBP_Settings>()->SymbolPreload == EHWBP_SymbolPreload::OnFirstBreakpoint)
+	{
+		HWBP_SymbolPreloader::Start();
+	}
 	return Data.RegisterIndex;
 }
 
+//Applies the same debug register change to every thread of the process except the calling one
+//Threads are suspended while their context is changed, so this can be called directly instead of through a helper thread
+static int32 ApplyDebugRegisterChangesToOtherThreads(const FHardwareBreakpointData& Template)
+{
+	const DWORD ProcessId = GetCurrentProcessId();
+	const DWORD CurrentThreadId = GetCurrentThreadId();
+	HANDLE Snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (Snapshot == INVALID_HANDLE_VALUE)
+	{
+		return 0;
+	}
+	int32 NumThreads = 0;
+	THREADENTRY32 ThreadEntry;
+	ThreadEntry.dwSize = sizeof(ThreadEntry);
+	for (BOOL bHasEntry = Thread32First(Snapshot, &ThreadEntry); bHasEntry; bHasEntry = Thread32Next(Snapshot, &ThreadEntry))
+	{
+		if (ThreadEntry.th32OwnerProcessID != ProcessId || ThreadEntry.th32ThreadID == CurrentThreadId)
+		{
+			continue;
+		}
+		FHardwareBreakpointData Data = Template;
+		Data.ThreadHandle = OpenThread(THREAD_GET_CONTEXT | THREAD_SET_CONTEXT | THREAD_SUSPEND_RESUME, 0, ThreadEntry.th32ThreadID);
+		if (Data.ThreadHandle == nullptr)
+		{
+			continue;
+		}
+		ApplyDebugRegisterChanges(&Data);
+		CloseHandle(Data.ThreadHandle);
+		NumThreads += Data.Success ? 1 : 0;
+	}
+	CloseHandle(Snapshot);
+	return NumThreads;
+}
+
+DebugRegisterIndex FWindowsPlatformHardwareBreakpoints::SetHardwareBreakpointOnAllThreads(EHardwareBreakpointType Type, EHardwareBreakpointSize Size, void* Address)
+{
+	//The slot is picked on the calling thread, then mirrored to the others
+	//Slots are global (DataBreakpointInfo is shared by all threads), so overwriting the same slot on other threads is safe
+	DebugRegisterIndex Index = SetHardwareBreakpoint(Type, Size, Address);
+	if (Index < 0)
+	{
+		return -1;
+	}
+	FHardwareBreakpointData Data;
+	Data.Address = Address;
+	Data.Size = Size;
+	Data.Type = Type;
+	Data.RegisterIndex = Index;
+	Data.OperationToPerform = EDebugRegisterOperation::SetAt;
+	HardwareBreakpointsUtils::AllThreadsSlots |= 1u << Index;
+	const int32 NumThreads = ApplyDebugRegisterChangesToOtherThreads(Data);
+	UE_LOG(LogHardwareBreakpoints, Verbose, TEXT("Breakpoint %d armed on %d other threads"), Index, NumThreads);
+	return Index;
+}
+
 namespace HardwareBreakpointsUtils
 {
 	struct FFetchContextData
@@ -227,7 +285,7 @@ namespace HardwareBreakpointsUtils
 bool FWindowsPlatformHardwareBreakpoints::IsBreakpointSet(DebugRegisterIndex Index)
 {
 	using namespace HardwareBreakpointsUtils;
-	if (Index < 0 || Index > 3)
+	if (Index < 0 || Index >= FPlatformHardwareBreakpointTraits::NumSlots)
 	{
 		return false;
 	}
@@ -266,15 +324,254 @@ bool FWindowsPlatformHardwareBreakpoints::AnyBreakpointSet()
 	return false;
 }
 
-bool FWindowsPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(DebugRegisterIndex Index)
+bool FWindowsPlatformHardwareBreakpoints::RetargetBreakpointInContext(DebugRegisterIndex Index, void* NewAddress, struct _EXCEPTION_POINTERS* ExceptionInfo)
 {
-	static_assert(MAX_HARDWARE_BREAKPOINTS == 4, "Windows hardware breakpoints should be 4, is some other value. Check that the plugin is being compiled without unity build");
-	if (Index < 0 || Index > MAX_HARDWARE_BREAKPOINTS-1)
+	if (Index < 0 || Index >= FPlatformHardwareBreakpointTraits::NumSlots)
 	{
 		return false;
 	}
-	RemoveBreakpointAssociatedData(Index);
+	auto DebugRegisters = &ExceptionInfo->ContextRecord->Dr0;
+	DebugRegisters[Index] = (DWORD64)NewAddress;
+	return true;
+}
+
+uint32 FWindowsPlatformHardwareBreakpoints::CaptureStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	switch (GetDefault<UHWBP_Settings>()->StackWalker)
+	{
+	case EHWBP_StackWalker::FramePointers:
+		return FramePointerStackBackTrace(OutBackTrace, MaxDepth, ExceptionInfo);
+	case EHWBP_StackWalker::UnwindTables:
+		return UnwindStackBackTrace(OutBackTrace, MaxDepth, ExceptionInfo);
+	default:
+		break;
+	}
+	void* ContextWrapper = FWindowsPlatformStackWalk::MakeThreadContextWrapper(ExceptionInfo->ContextRecord, GetCurrentThread());
+	uint32 Depth = FPlatformStackWalk::CaptureStackBackTrace(OutBackTrace, MaxDepth, ContextWrapper);
+	FWindowsPlatformStackWalk::ReleaseThreadContextWrapper(ContextWrapper);
+	return Depth;
+}
+
+//Direct mapped cache of RtlLookupFunctionEntry results. Hit stacks repeat the same return addresses over and over, and the lookup
+//(find the module, then binary search its function table) is most of the cost of an unwind step
+//Slots are guarded by a sequence number, so hits on several threads can read and fill it without locks or allocations
+//Entries of a module that gets unloaded go stale, but a return address into unloaded code can't be on any stack anymore
+namespace FunctionEntryCache
+{
+	static constexpr uint32 NumSlots = 1024;
+
+	struct FSlot
+	{
+		std::atomic<uint32> Sequence{ 0 };
+		DWORD64 ProgramCounter = 0;
+		DWORD64 ImageBase = 0;
+		PRUNTIME_FUNCTION Function = nullptr;
+	};
+	static FSlot Slots[NumSlots];
+
+	static PRUNTIME_FUNCTION Lookup(DWORD64 ProgramCounter, DWORD64& OutImageBase)
+	{
+		FSlot& Slot = Slots[((ProgramCounter >> 4) ^ (ProgramCounter >> 14)) & (NumSlots - 1)];
+		uint32 Sequence = Slot.Sequence.load(std::memory_order_acquire);
+		if ((Sequence & 1) == 0)
+		{
+			const DWORD64 CachedProgramCounter = Slot.ProgramCounter;
+			const DWORD64 CachedImageBase = Slot.ImageBase;
+			PRUNTIME_FUNCTION CachedFunction = Slot.Function;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (CachedProgramCounter == ProgramCounter && CachedFunction && Slot.Sequence.load(std::memory_order_relaxed) == Sequence)
+			{
+				OutImageBase = CachedImageBase;
+				return CachedFunction;
+			}
+		}
+		PRUNTIME_FUNCTION Function = RtlLookupFunctionEntry(ProgramCounter, &OutImageBase, nullptr);
+		//Misses aren't cached, and a slot being written by another thread is just left alone
+		if (Function && (Sequence & 1) == 0 && Slot.Sequence.compare_exchange_strong(Sequence, Sequence + 1, std::memory_order_acquire))
+		{
+			Slot.ProgramCounter = ProgramCounter;
+			Slot.ImageBase = OutImageBase;
+			Slot.Function = Function;
+			Slot.Sequence.store(Sequence + 2, std::memory_order_release);
+		}
+		return Function;
+	}
+}
+
+uint32 FWindowsPlatformHardwareBreakpoints::UnwindStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	CONTEXT Context = *ExceptionInfo->ContextRecord;
+	uint32 Depth = 0;
+	while (Depth < MaxDepth && Context.Rip != 0)
+	{
+		OutBackTrace[Depth++] = Context.Rip;
+		const DWORD64 PreviousStackPointer = Context.Rsp;
+		DWORD64 ImageBase = 0;
+		PRUNTIME_FUNCTION Function = FunctionEntryCache::Lookup(Context.Rip, ImageBase);
+		if (Function == nullptr)
+		{
+			//Leaf functions have no unwind data, the return address is on top of the stack
+			Context.Rip = *(DWORD64*)Context.Rsp;
+			Context.Rsp += sizeof(DWORD64);
+		}
+		else
+		{
+			PVOID HandlerData = nullptr;
+			DWORD64 EstablisherFrame = 0;
+			RtlVirtualUnwind(UNW_FLAG_NHANDLER, ImageBase, Context.Rip, Function, &Context, &HandlerData, &EstablisherFrame, nullptr);
+		}
+		//The stack only grows one way, anything else means the unwind data didn't match the code
+		if (Context.Rsp <= PreviousStackPointer)
+		{
+			break;
+		}
+	}
+	return Depth;
+}
+
+uint32 FWindowsPlatformHardwareBreakpoints::FramePointerStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	const CONTEXT& Context = *ExceptionInfo->ContextRecord;
+	ULONG_PTR StackLow = 0;
+	ULONG_PTR StackHigh = 0;
+	GetCurrentThreadStackLimits(&StackLow, &StackHigh);
+	const uint32 Depth = HWBP_Core::WalkFramePointers(Context.Rip, Context.Rbp, Context.Rsp, StackHigh, OutBackTrace, MaxDepth);
+
+	//x64 code doesn't have to keep a frame pointer, and RBP is just another register when it doesn't
+	//A chain that ends early, or goes through an address that can't be a return address, means this walk can't be trusted
+	static const uint32 MinTrustedDepth = 4;
+	bool bTrusted = Depth >= FMath::Min(MaxDepth, MinTrustedDepth);
+	for (uint32 i = 1; bTrusted && i < Depth; ++i)
+	{
+		DWORD64 ImageBase = 0;
+		bTrusted = FunctionEntryCache::Lookup(OutBackTrace[i], ImageBase) != nullptr;
+	}
+	return bTrusted ? Depth : UnwindStackBackTrace(OutBackTrace, MaxDepth, ExceptionInfo);
+}
 
+bool FWindowsPlatformHardwareBreakpoints::GetModuleBuildId(uint64 ProgramCounter, FHardwareBreakpointModuleBuildId& OutBuildId)
+{
+	PVOID Base = nullptr;
+	if (RtlPcToFileHeader((PVOID)ProgramCounter, &Base) == nullptr)
+	{
+		return false;
+	}
+	const uint8* Image = (const uint8*)Base;
+	const IMAGE_DOS_HEADER* DosHeader = (const IMAGE_DOS_HEADER*)Image;
+	if (DosHeader->e_magic != IMAGE_DOS_SIGNATURE)
+	{
+		return false;
+	}
+	const IMAGE_NT_HEADERS64* NtHeaders = (const IMAGE_NT_HEADERS64*)(Image + DosHeader->e_lfanew);
+	const IMAGE_DATA_DIRECTORY& DebugDirectory = NtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG];
+	const IMAGE_DEBUG_DIRECTORY* DebugEntries = (const IMAGE_DEBUG_DIRECTORY*)(Image + DebugDirectory.VirtualAddress);
+	for (DWORD i = 0; DebugDirectory.VirtualAddress && i < DebugDirectory.Size / sizeof(IMAGE_DEBUG_DIRECTORY); ++i)
+	{
+		//CodeView RSDS record: signature, PDB GUID, age, PDB path
+		const uint8* CodeView = Image + DebugEntries[i].AddressOfRawData;
+		if (DebugEntries[i].Type != IMAGE_DEBUG_TYPE_CODEVIEW || DebugEntries[i].AddressOfRawData == 0 || FMemory::Memcmp(CodeView, "RSDS", 4) != 0)
+		{
+			continue;
+		}
+		FMemory::Memcpy(OutBuildId.Id, CodeView + 4, sizeof(OutBuildId.Id));
+		OutBuildId.Base = (uint64)Base;
+		OutBuildId.Size = NtHeaders->OptionalHeader.SizeOfImage;
+		TCHAR ModulePath[MAX_PATH] = { 0 };
+		GetModuleFileNameW((HMODULE)Base, ModulePath, MAX_PATH);
+		OutBuildId.Name = FPaths::GetBaseFilename(ModulePath);
+		return true;
+	}
+	return false;
+}
+
+bool FWindowsPlatformHardwareBreakpoints::EnumerateFunctionSymbols(uint64 ModuleBase, TFunctionRef<void(const ANSICHAR*, uint64, uint32)> Visitor)
+{
+	FPlatformStackWalk::InitStackWalking();
+	auto Callback = [](PSYMBOL_INFO SymbolInfo, ULONG SymbolSize, PVOID UserContext) -> BOOL
+	{
+		//SymTagFunction from cvconst.h, which DbgHelp.h doesn't include. Public symbols would duplicate every function that has full debug info
+		static constexpr ULONG SymTagFunction = 5;
+		if (SymbolInfo->Tag == SymTagFunction)
+		{
+			(*(TFunctionRef<void(const ANSICHAR*, uint64, uint32)>*)UserContext)(SymbolInfo->Name, SymbolInfo->Address, SymbolSize);
+		}
+		return TRUE;
+	};
+	return SymEnumSymbols(GetCurrentProcess(), ModuleBase, "*", Callback, &Visitor) != FALSE;
+}
+
+//Older DbgHelp.h versions don't have it
+#ifndef ESLFLAG_INLINE_SITE
+#define ESLFLAG_INLINE_SITE 0x10
+#endif
+
+bool FWindowsPlatformHardwareBreakpoints::EnumerateSourceLineAddresses(uint64 ModuleBase, const ANSICHAR* File, int32 Line, TFunctionRef<void(uint64, const ANSICHAR*)> Visitor)
+{
+	FPlatformStackWalk::InitStackWalking();
+	auto Callback = [](PSRCCODEINFO LineInfo, PVOID UserContext) -> BOOL
+	{
+		(*(TFunctionRef<void(uint64, const ANSICHAR*)>*)UserContext)(LineInfo->Address, LineInfo->FileName);
+		return TRUE;
+	};
+	return SymEnumSourceLines(GetCurrentProcess(), ModuleBase, nullptr, File, Line, ESLFLAG_FULLPATH | ESLFLAG_INLINE_SITE, Callback, &Visitor) != FALSE;
+}
+
+uint32 FWindowsPlatformHardwareBreakpoints::GetTriggeredBreakpointMask(struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	//DR6 B0-B3 tell which breakpoint conditions were met. The handler clears DR6 before continuing, since the CPU never does
+	return HWBP_Core::GetTriggeredSlots(ExceptionInfo->ContextRecord->Dr6);
+}
+
+uint64 FWindowsPlatformHardwareBreakpoints::GetExceptionProgramCounter(struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	return ExceptionInfo->ContextRecord->Rip;
+}
+
+uint64 FWindowsPlatformHardwareBreakpoints::GetExceptionStackPointer(struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	return ExceptionInfo->ContextRecord->Rsp;
+}
+
+uint64 FWindowsPlatformHardwareBreakpoints::GetExceptionThisPointer(struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	return ExceptionInfo->ContextRecord->Rcx;
+}
+
+//Follows jmp rel32 stubs, like the ones incremental linking puts in front of every function
+static uint8* SkipJumpStubs(uint8* Code)
+{
+	for (int32 i = 0; i < 4 && Code[0] == 0xE9; ++i)
+	{
+		Code = Code + 5 + *reinterpret_cast<int32*>(Code + 1);
+	}
+	return Code;
+}
+
+void* FWindowsPlatformHardwareBreakpoints::ResolveMemberFunctionAddress(void* Address, const void* Instance)
+{
+	uint8* Code = SkipJumpStubs(static_cast<uint8*>(Address));
+	//A pointer to a virtual method points to a vcall thunk: mov rax, [rcx] followed by jmp qword ptr [rax + VTableOffset]
+	if (Instance && Code[0] == 0x48 && Code[1] == 0x8B && Code[2] == 0x01 && Code[3] == 0xFF)
+	{
+		int32 VTableOffset = -1;
+		switch (Code[4])
+		{
+		case 0x20: VTableOffset = 0; break;
+		case 0x60: VTableOffset = *reinterpret_cast<int8*>(Code + 5); break;
+		case 0xA0: VTableOffset = *reinterpret_cast<int32*>(Code + 5); break;
+		default: break;
+		}
+		if (VTableOffset >= 0)
+		{
+			void* const* VTable = *static_cast<void* const* const*>(Instance);
+			Code = SkipJumpStubs(static_cast<uint8*>(VTable[VTableOffset / sizeof(void*)]));
+		}
+	}
+	return Code;
+}
+
+static bool RemoveDebugRegister(DebugRegisterIndex Index)
+{
 	FHardwareBreakpointData Data;
 
 	Data.ThreadHandle = GetCurrentThread();
@@ -293,9 +590,56 @@ bool FWindowsPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(DebugRegister
 	return Data.RegistersChanged;
 }
 
+bool FWindowsPlatformHardwareBreakpoints::RemoveHardwareBreakpoint(DebugRegisterIndex Index)
+{
+	if (Index < 0 || Index >= FPlatformHardwareBreakpointTraits::NumSlots)
+	{
+		return false;
+	}
+	HWBP_TRACE_REMOVE(Index);
+	DebugRegisterIndex Linked[FPlatformHardwareBreakpointTraits::NumSlots];
+	const int32 NumLinked = GetLinkedBreakpoints(Index, Linked);
+	const bool bAllThreads = DataBreakpointInfo[Index].bAllThreads;
+	RemoveBreakpointAssociatedData(Index);
+	for (int32 i = 0; i < NumLinked; ++i)
+	{
+		RemoveBreakpointAssociatedData(Linked[i]);
+		RemoveDebugRegister(Linked[i]);
+	}
+	if (bAllThreads)
+	{
+		FHardwareBreakpointData Data;
+		Data.RegisterIndex = Index;
+		Data.OperationToPerform = EDebugRegisterOperation::Remove;
+		ApplyDebugRegisterChangesToOtherThreads(Data);
+	}
+	const bool bRemoved = RemoveDebugRegister(Index);
+	uint32 RemovedSlots = 1u << Index;
+	for (int32 i = 0; i < NumLinked; ++i)
+	{
+		RemovedSlots |= 1u << Linked[i];
+	}
+	HardwareBreakpointsUtils::ArmedSlots &= ~RemovedSlots;
+	HardwareBreakpointsUtils::AllThreadsSlots &= ~RemovedSlots;
+	RemoveStructuredExceptionHandlerIfIdle();
+	return bRemoved;
+}
+
 bool FWindowsPlatformHardwareBreakpoints::RemoveAllHardwareBreakpoints()
 {
+	HWBP_TRACE_REMOVE(-1);
+	bool bAnyOnAllThreads = false;
+	for (const FDataBreakpointInfo& Info : DataBreakpointInfo)
+	{
+		bAnyOnAllThreads |= Info.Address && Info.bAllThreads;
+	}
 	RemoveAllBreakpointAssociatedData();
+	if (bAnyOnAllThreads)
+	{
+		FHardwareBreakpointData Data;
+		Data.OperationToPerform = EDebugRegisterOperation::RemoveAll;
+		ApplyDebugRegisterChangesToOtherThreads(Data);
+	}
 
 	FHardwareBreakpointData Data;
 	Data.ThreadHandle = GetCurrentThread();
@@ -310,11 +654,14 @@ bool FWindowsPlatformHardwareBreakpoints::RemoveAllHardwareBreakpoints()
 	CloseHandle(OperationThread);
 	CloseHandle(Data.ThreadHandle);
 
+	HardwareBreakpointsUtils::ArmedSlots = 0;
+	HardwareBreakpointsUtils::AllThreadsSlots = 0;
+	//Nothing is armed anymore, so no handler can be using the table
+	HWBP_StackDedupe::Reset();
+	RemoveStructuredExceptionHandlerIfIdle();
 	return Data.RegistersChanged;
 }
 
-extern COREUOBJECT_API FNativeFuncPtr GNatives[];
-
 namespace HardwareBreakpointsUtils
 {
 	inline bool AddressIsWatchedNativeFunctionCall(PVOID Address, PCONTEXT ContextRecord, int& OutRegisterIndex)
@@ -332,12 +679,58 @@ namespace HardwareBreakpointsUtils
 		return false;
 	}
 
+	//Native function breakpoint that has an instance filter, hit by a call on another object
+	inline bool IsFilteredOutNativeFunctionCall(PVOID Address, PCONTEXT ContextRecord, int& OutRegisterIndex)
+	{
+		if (!AddressIsWatchedNativeFunctionCall(Address, ContextRecord, OutRegisterIndex))
+		{
+			return false;
+		}
+		const void* InstanceFilter = FPlatformHardwareBreakpoints::GetBreakpointInstanceFilter(OutRegisterIndex);
+		return InstanceFilter != nullptr && InstanceFilter != (const void*)ContextRecord->Rcx;
+	}
+
+	//Only disarms the registers, the slot's data (label, instance filter, linked slots...) is left to the caller
 	inline void ClearBreakpointFromContextRecord(PCONTEXT ContextRecord, int Index)
 	{
+		DebugRegisterIndex Linked[FPlatformHardwareBreakpointTraits::NumSlots];
+		const int32 NumLinked = FPlatformHardwareBreakpoints::GetLinkedBreakpoints(Index, Linked);
 		auto DebugRegisters = &ContextRecord->Dr0;
-		DebugRegisters[Index] = 0;
-		ContextRecord->Dr7 &= ~(1 << (Index * 2));
+		auto ClearRegister = [&](int RegisterIndex)
+		{
+			DebugRegisters[RegisterIndex] = 0;
+			ContextRecord->Dr7 = HWBP_Core::DisableSlot(ContextRecord->Dr7, RegisterIndex);
+		};
+		for (int32 i = 0; i < NumLinked; ++i)
+		{
+			ClearRegister(Linked[i]);
+		}
+		ClearRegister(Index);
+	}
+
+	//Removes the breakpoint for good from inside the handler, along with its data and that of its linked slots
+	inline void RemoveBreakpointFromContextRecord(PCONTEXT ContextRecord, int Index)
+	{
+		DebugRegisterIndex Linked[FPlatformHardwareBreakpointTraits::NumSlots];
+		const int32 NumLinked = FPlatformHardwareBreakpoints::GetLinkedBreakpoints(Index, Linked);
+		ClearBreakpointFromContextRecord(ContextRecord, Index);
+		uint32 RemovedSlots = 1u << Index;
+		for (int32 i = 0; i < NumLinked; ++i)
+		{
+			FPlatformHardwareBreakpoints::RemoveBreakpointAssociatedData(Linked[i]);
+			RemovedSlots |= 1u << Linked[i];
+		}
 		FPlatformHardwareBreakpoints::RemoveBreakpointAssociatedData(Index);
+		//Slots armed on every thread are still armed on the other threads, so they keep the handler installed until they're
+		//removed from outside it. The handler itself is never uninstalled from here, only by the next call from outside it
+		ArmedSlots &= ~(RemovedSlots & ~AllThreadsSlots.load());
+	}
+
+	//Unlike ClearBreakpointFromContextRecord this keeps the breakpoint's data, it's meant to be restored after a single step
+	//It doesn't change ArmedSlots either, the handler has to stay installed to restore it
+	inline void DisableBreakpointInContextRecord(PCONTEXT ContextRecord, int Index)
+	{
+		ContextRecord->Dr7 = HWBP_Core::DisableSlot(ContextRecord->Dr7, Index);
 	}
 
 	inline void ShiftBreakpointAddressToNextByte(PCONTEXT ContextRecord, int Index)
@@ -365,6 +758,10 @@ namespace HardwareBreakpointsUtils
 	int32 FindRegisterForBPFunction(PCONTEXT ContextRecord)
 	{
 		const FFrame* ScriptStack = FFrame::GetThreadLocalTopStackFrame();
+		if (ScriptStack == nullptr)
+		{
+			return INDEX_NONE;
+		}
 
 		auto* DebugRegisters = &ContextRecord->Dr0;
 
@@ -378,8 +775,6 @@ namespace HardwareBreakpointsUtils
 		return INDEX_NONE;
 	}
 
-	static bool WaitingForSingleStep = false;
-
 	static void ProcessBreakpointClearing(struct _EXCEPTION_POINTERS *ExceptionInfo)
 	{
 		WindowsPlatformHardwareBreakpoints::FBreakpointClearData ClearData;
@@ -389,8 +784,7 @@ namespace HardwareBreakpointsUtils
 		{
 			if (ClearData.ClearBreakpoint[i] || ClearData.ClearAllBreakpoints)
 			{
-				ClearBreakpointFromContextRecord(ExceptionInfo->ContextRecord, i);
-				FPlatformHardwareBreakpoints::RemoveBreakpointAssociatedData(i);
+				RemoveBreakpointFromContextRecord(ExceptionInfo->ContextRecord, i);
 			}
 		}
 	}
@@ -433,23 +827,41 @@ namespace HardwareBreakpointsUtils
 		return false;
 	}
 
-	void CustomStackTraceToLog(CONTEXT* ContextRecord, void* ContextWrapper, DebugRegisterIndex BreakpointIndex)
+	inline bool CanShowCallstackWindow()
+	{
+		return IsInGameThread() && FSlateApplication::IsInitialized() && FSlateApplication::Get().CanAddModalWindow();
+	}
+
+	void CustomStackTraceToLog(CONTEXT* ContextRecord, void* ContextWrapper, DebugRegisterIndex BreakpointIndex, uint32 CollapsedHits = 0)
 	{
 		// Temporary memory holding the stack trace.
-		static const int MAX_DEPTH = 100;
+		// Sized for the largest depth the settings allow, the depth actually captured comes from the breakpoint or the settings
+		static const int MAX_DEPTH = 256;
 		uint64 StackTrace[MAX_DEPTH];
 		FMemory::Memzero(StackTrace);
+		const UHWBP_Settings* Settings = GetDefault<UHWBP_Settings>();
+		const int32 BreakpointDepth = FPlatformHardwareBreakpoints::GetBreakpointStackDepth(BreakpointIndex);
+		const uint32 MaxDepth = (uint32)FMath::Clamp(BreakpointDepth > 0 ? BreakpointDepth : Settings->StackDepth, 1, MAX_DEPTH);
 
 		// Capture stack backtrace
 		// Using optional ContextWrapper. Without it, the stack trace was incomplete for native function breakpoints
-		uint32 Depth = FPlatformStackWalk::CaptureStackBackTrace(StackTrace, MAX_DEPTH, ContextWrapper);
+		uint32 Depth = 0;
+		if (Settings->StackWalker == EHWBP_StackWalker::DbgHelp)
+		{
+			Depth = FPlatformStackWalk::CaptureStackBackTrace(StackTrace, MaxDepth, ContextWrapper);
+		}
+		else
+		{
+			EXCEPTION_POINTERS ExceptionInfo = { nullptr, ContextRecord };
+			Depth = FPlatformHardwareBreakpoints::CaptureStackBackTrace(StackTrace, MaxDepth, &ExceptionInfo);
+		}
 
 		TArray<FExtendedProgramCounterSymbolInfo> StackTraceSymbolInfo;
 		StackTraceSymbolInfo.AddDefaulted(Depth);
 
 		for (uint32 i = 0; i < Depth; ++i)
 		{
-			FPlatformStackWalk::ProgramCounterToSymbolInfo(StackTrace[i], StackTraceSymbolInfo[i].SymbolInfo);
+			HWBP_SymbolCache::ProgramCounterToSymbolInfo(StackTrace[i], StackTraceSymbolInfo[i].SymbolInfo);
 		}
 #if DO_BLUEPRINT_GUARD
 #if ENGINE_MAJOR_VERSION >= 5 || ENGINE_MAJOR_VERSION == 4 && ENGINE_MINOR_VERSION >= 25
@@ -499,11 +911,11 @@ namespace HardwareBreakpointsUtils
 				FCStringAnsi::Strncat(StackTraceReadableString, LINE_TERMINATOR_ANSI, StackTraceReadableStringSize);
 			}
 		}
-		if (IsInGameThread() && FSlateApplication::IsInitialized() && FSlateApplication::Get().CanAddModalWindow())
+		if (CanShowCallstackWindow())
 		{
 			{
 				FDelegateHandle CallstackHandle = CallStackViewer::OnRemoveBreakpoint.AddLambda([ContextRecord](DebugRegisterIndex Index) {
-					ClearBreakpointFromContextRecord(ContextRecord, Index);
+					RemoveBreakpointFromContextRecord(ContextRecord, Index);
 				});
 				OpenModalCallstackWindow(BreakpointIndex, StackTraceSymbolInfo);
 				CallStackViewer::OnRemoveBreakpoint.Remove(CallstackHandle);
@@ -511,7 +923,14 @@ namespace HardwareBreakpointsUtils
 		}
 		
 		{
-			UE_LOG(LogHardwareBreakpoints, Log, TEXT("_\n============= HARDWARE BREAKPOINT STACK ===========\nStack:\n%s"), ANSI_TO_TCHAR(StackTraceReadableString));
+			if (CollapsedHits > 0)
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("_\n============= HARDWARE BREAKPOINT STACK (%u earlier hits from this call site collapsed) ===========\nStack:\n%s"), CollapsedHits, ANSI_TO_TCHAR(StackTraceReadableString));
+			}
+			else
+			{
+				UE_LOG(LogHardwareBreakpoints, Log, TEXT("_\n============= HARDWARE BREAKPOINT STACK ===========\nStack:\n%s"), ANSI_TO_TCHAR(StackTraceReadableString));
+			}
 			GLog->Flush();
 		}
 		FMemory::SystemFree(StackTraceReadableString);
@@ -521,6 +940,25 @@ namespace HardwareBreakpointsUtils
 	{
 		if (!GetDefault<UHWBP_Settings>()->DontShowCallstackWindowIfDebuggerAttached || !FPlatformMisc::IsDebuggerPresent())
 		{
+			uint32 CollapsedHits = 0;
+			if (!CanShowCallstackWindow())
+			{
+				//Only the instruction and its return address are needed to tell call sites apart, which the cached unwind tables give cheaply
+				uint64 CallSite[2] = { 0, 0 };
+				EXCEPTION_POINTERS ExceptionInfo = { nullptr, ContextRecord };
+				FPlatformHardwareBreakpoints::UnwindStackBackTrace(CallSite, 2, &ExceptionInfo);
+				if (!HWBP_StackDedupe::ShouldCaptureStack(BreakpointIndex, ContextRecord->Rip, CallSite[1], CollapsedHits))
+				{
+					return;
+				}
+			}
+			if (HWBP_SymbolPreloader::IsLoading())
+			{
+				//Symbols are being loaded on another thread, the callstack is logged once they're ready
+				EXCEPTION_POINTERS ExceptionInfo = { nullptr, ContextRecord };
+				HWBP_SymbolPreloader::QueueHit(BreakpointIndex, &ExceptionInfo);
+				return;
+			}
 			bool DoLog = true;
 			if (!FPlatformHardwareBreakpoints::IsStackWalkingInitialized())
 			{
@@ -535,20 +973,34 @@ namespace HardwareBreakpointsUtils
 			{
 				FPlatformStackWalk::InitStackWalking();
 #if !NO_LOGGING
-				CustomStackTraceToLog(ContextRecord, ContextWrapper, BreakpointIndex);
+				CustomStackTraceToLog(ContextRecord, ContextWrapper, BreakpointIndex, CollapsedHits);
 #endif
 			}
 		}
 	}
 
-	static PVOID GExceptionHandlerHandle = nullptr;
-	static CONTEXT StoredContext;
+	static thread_local HWBP_Core::FDebugRegisterState StoredDebugRegisters;
 
-	static void StoreContext(struct _EXCEPTION_POINTERS *ExceptionInfo)
+	//Saves the thread's debug registers before a breakpoint is disabled or moved, they're restored on the next single step exception
+	static void BeginSingleStepRestore(struct _EXCEPTION_POINTERS *ExceptionInfo)
 	{
-		FMemory::Memcpy(StoredContext, *ExceptionInfo->ContextRecord);
+		FMemory::Memcpy(&StoredDebugRegisters, &ExceptionInfo->ContextRecord->Dr0, sizeof(StoredDebugRegisters));
+		if (!WaitingForSingleStep)
+		{
+			WaitingForSingleStep = true;
+			++PendingSingleSteps;
+		}
+	}
+}
+
+void FWindowsPlatformHardwareBreakpoints::RemoveBreakpointInContext(DebugRegisterIndex Index, struct _EXCEPTION_POINTERS* ExceptionInfo)
+{
+	if (Index >= 0 && Index < FPlatformHardwareBreakpointTraits::NumSlots)
+	{
+		HardwareBreakpointsUtils::RemoveBreakpointFromContextRecord(ExceptionInfo->ContextRecord, Index);
 	}
 }
+
 #define CALL_FIRST 1  
 #define CALL_LAST 0
 
@@ -560,23 +1012,38 @@ LONG WINAPI HardwareBreakpointsExceptionHandler(struct _EXCEPTION_POINTERS *Exce
 	{
 		return EXCEPTION_CONTINUE_SEARCH;
 	}
+	HWBP_TRACE_HANDLER_SCOPE();
 	//If we just single stepped after a native or blueprint function breakpoint restore breakpoint state
 	if (WaitingForSingleStep)
 	{
 		WaitingForSingleStep = false;
-		auto CurrentDebugRegisters = &ExceptionInfo->ContextRecord->Dr0;
-		auto OldDebugRegisters = &StoredContext.Dr0;
-		FMemory::Memcpy(CurrentDebugRegisters, OldDebugRegisters, sizeof(*CurrentDebugRegisters) * 6);
+		--PendingSingleSteps;
+		FMemory::Memcpy(&ExceptionInfo->ContextRecord->Dr0, &StoredDebugRegisters, sizeof(StoredDebugRegisters));
+		ExceptionInfo->ContextRecord->Dr6 = 0;
 		return EXCEPTION_CONTINUE_EXECUTION;
 	}
+	//Calls on objects we're not interested in are stepped over before doing anything else, hot methods hit this path thousands of times per frame
+	{
+		int FilteredRegisterIndex;
+		if (IsFilteredOutNativeFunctionCall(ExceptionInfo->ExceptionRecord->ExceptionAddress, ExceptionInfo->ContextRecord, FilteredRegisterIndex))
+		{
+			BeginSingleStepRestore(ExceptionInfo);
+			DisableBreakpointInContextRecord(ExceptionInfo->ContextRecord, FilteredRegisterIndex);
+			ExceptionInfo->ContextRecord->EFlags |= HWBP_Core::TrapFlag;
+			ExceptionInfo->ContextRecord->Dr6 = 0;
+			return EXCEPTION_CONTINUE_EXECUTION;
+		}
+	}
 
 	HANDLE DumpThreadHandle = GetCurrentThread();
 	void* ContextWrapper = FWindowsPlatformStackWalk::MakeThreadContextWrapper(ExceptionInfo->ContextRecord, DumpThreadHandle);
 	CONTEXT* ContextRecord = ExceptionInfo->ContextRecord;
 
 	int32 OutRegisterIndex = FindRegisterForBPFunction(ContextRecord);
+	bool bStepOverProbe = false;
 	if (const bool bBlueprintFunctionCall = OutRegisterIndex != INDEX_NONE)
 	{
+		HWBP_TRACE_HIT(OutRegisterIndex, ContextRecord->Rip);
 		DumpStackIfEnabled(ContextRecord, ContextWrapper, OutRegisterIndex);
 		WindowsPlatformHardwareBreakpoints::CaughtBlueprintFunctionBreakpoint();
 		ProcessBreakpointClearing(ExceptionInfo);
@@ -587,16 +1054,26 @@ LONG WINAPI HardwareBreakpointsExceptionHandler(struct _EXCEPTION_POINTERS *Exce
 		{
 			if (OutRegisterIndex != -1)
 			{
-				StoreContext(ExceptionInfo);
+				BeginSingleStepRestore(ExceptionInfo);
 				//We shift the bytecode read breakpoint to the next byte, and mark that we're waiting
 				//On next exception we won't break, but we'll reset the breakpoint to its original state
 				ShiftBreakpointAddressToNextByte(ContextRecord, OutRegisterIndex);
-				WaitingForSingleStep = true;
 			}
 		}
 	}
+	else if (FPlatformHardwareBreakpoints::HandleFunctionProbeHit(OutRegisterIndex, bStepOverProbe, ExceptionInfo))
+	{
+		//Latency probes and counting execute breakpoints never stop. Same single step dance as native function breakpoints, but the slot keeps its data
+		if (bStepOverProbe)
+		{
+			BeginSingleStepRestore(ExceptionInfo);
+			DisableBreakpointInContextRecord(ContextRecord, OutRegisterIndex);
+			ContextRecord->EFlags |= HWBP_Core::TrapFlag;
+		}
+	}
 	else if (AddressIsWatchedNativeFunctionCall(ExceptionInfo->ExceptionRecord->ExceptionAddress, ContextRecord, OutRegisterIndex))
 	{
+		HWBP_TRACE_HIT(OutRegisterIndex, ContextRecord->Rip);
 		DumpStackIfEnabled(ContextRecord, ContextWrapper, OutRegisterIndex);
 		WindowsPlatformHardwareBreakpoints::CaughtNativeFunctionBreakpoint();
 		ProcessBreakpointClearing(ExceptionInfo);
@@ -605,12 +1082,12 @@ LONG WINAPI HardwareBreakpointsExceptionHandler(struct _EXCEPTION_POINTERS *Exce
 
 		if (BreakpointIsStillActive)
 		{
-			StoreContext(ExceptionInfo);
-			//Native function breakpoints need to be cleared so execution can continue
-			ClearBreakpointFromContextRecord(ContextRecord, OutRegisterIndex);
+			BeginSingleStepRestore(ExceptionInfo);
+			//Native function breakpoints need to be disabled so execution can continue. The slot stays set in ArmedSlots,
+			//it's re-enabled from StoredDebugRegisters after the single step
+			DisableBreakpointInContextRecord(ContextRecord, OutRegisterIndex);
 			//We mark the single step trap flag so we can restore it after the instruction pointer has moved to the next instruction
-			ContextRecord->EFlags |= 0x0100;
-			WaitingForSingleStep = true;
+			ContextRecord->EFlags |= HWBP_Core::TrapFlag;
 		}
 	}
 	else if (FPlatformHardwareBreakpoints::CheckDataBreakpointConditions(OutRegisterIndex, ExceptionInfo))
@@ -621,19 +1098,41 @@ LONG WINAPI HardwareBreakpointsExceptionHandler(struct _EXCEPTION_POINTERS *Exce
 	}
 
 	FWindowsPlatformStackWalk::ReleaseThreadContextWrapper(ContextWrapper);
+	ContextRecord->Dr6 = 0;
 	return EXCEPTION_CONTINUE_EXECUTION;
 }
 
 void FWindowsPlatformHardwareBreakpoints::AddStructuredExceptionHandler()
 {
-	HardwareBreakpointsUtils::GExceptionHandlerHandle = AddVectoredExceptionHandler(CALL_FIRST, HardwareBreakpointsExceptionHandler);
+	using namespace HardwareBreakpointsUtils;
+	FScopeLock Lock(&ExceptionHandlerLock);
+	if (GExceptionHandlerHandle == nullptr)
+	{
+		GExceptionHandlerHandle = AddVectoredExceptionHandler(CALL_FIRST, HardwareBreakpointsExceptionHandler);
+	}
 }
 
 void FWindowsPlatformHardwareBreakpoints::RemoveStructuredExceptionHandler()
 {
 	using namespace HardwareBreakpointsUtils;
-	RemoveVectoredExceptionHandler(GExceptionHandlerHandle);
-	GExceptionHandlerHandle = nullptr;
+	FScopeLock Lock(&ExceptionHandlerLock);
+	if (GExceptionHandlerHandle)
+	{
+		RemoveVectoredExceptionHandler(GExceptionHandlerHandle);
+		GExceptionHandlerHandle = nullptr;
+	}
+}
+
+void FWindowsPlatformHardwareBreakpoints::RemoveStructuredExceptionHandlerIfIdle()
+{
+	using namespace HardwareBreakpointsUtils;
+	FScopeLock Lock(&ExceptionHandlerLock);
+	//A pending single step still has to come back to the handler to restore the debug registers
+	if (GExceptionHandlerHandle && ArmedSlots.load() == 0 && PendingSingleSteps.load() == 0)
+	{
+		RemoveVectoredExceptionHandler(GExceptionHandlerHandle);
+		GExceptionHandlerHandle = nullptr;
+	}
 }
 
 int32 FWindowsPlatformHardwareBreakpoints::GetSymbolDisplacementForProgramCounter(uint64 ProgramCounter)
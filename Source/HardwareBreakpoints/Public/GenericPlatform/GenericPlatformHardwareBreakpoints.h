@@ -3,11 +3,13 @@
 #pragma once
 
 #include "CoreTypes.h"
+#include "HAL/PlatformAtomics.h"
+#include "HAL/PlatformMath.h"
 #include "UObject/WeakObjectPtr.h"
-
-#ifndef MAX_HARDWARE_BREAKPOINTS
-#define MAX_HARDWARE_BREAKPOINTS 1
-#endif
+#include "Containers/StaticArray.h"
+#include "Templates/Function.h"
+#include "HWBP_Core/HWBP_Conditions.h"
+#include "HWBP_Core/HWBP_DebugRegisters.h"
 
 enum class EHardwareBreakpointType
 {
@@ -25,31 +27,186 @@ enum class EHardwareBreakpointSize
 };
 typedef int DebugRegisterIndex;
 
-class IHardwareBreakpointCondition
+//What the breakpoint hardware of a platform can do, known at compile time
+template <int32 InNumSlots, uint32 InSupportedTypeMask, uint32 InSupportedSizeMask>
+struct THardwareBreakpointTraits
+{
+	static constexpr int32 NumSlots = InNumSlots;
+
+	static constexpr bool SupportsType(EHardwareBreakpointType Type)
+	{
+		return (InSupportedTypeMask & (1u << (uint32)Type)) != 0;
+	}
+	static constexpr bool SupportsSize(EHardwareBreakpointSize Size)
+	{
+		return (InSupportedSizeMask & (1u << (uint32)Size)) != 0;
+	}
+};
+
+typedef THardwareBreakpointTraits<1, 0, 0> FGenericHardwareBreakpointTraits;
+//x86-64 debug registers: DR0-DR3, execute/write/read-write, 1/2/4/8 bytes
+typedef THardwareBreakpointTraits<HWBP_Core::NumDebugRegisters, 0x7, 0xF> FX64HardwareBreakpointTraits;
+
+//Selected from platform macros that are always defined, so every translation unit (unity or not) sees the same slot count
+#if PLATFORM_WINDOWS && PLATFORM_CPU_X86_FAMILY && PLATFORM_64BITS
+typedef FX64HardwareBreakpointTraits FPlatformHardwareBreakpointTraits;
+#else
+typedef FGenericHardwareBreakpointTraits FPlatformHardwareBreakpointTraits;
+#endif
+
+//Kept for code written against older versions of the plugin
+#define MAX_HARDWARE_BREAKPOINTS FPlatformHardwareBreakpointTraits::NumSlots
+
+//What the exception handler does when a data breakpoint is hit
+enum class EDataBreakpointMode : uint8
+{
+	//Dump the callstack and break into the debugger (default)
+	Break,
+	//Only count the hit per call site, no stack walk, no window, no debugger break
+	CountOnly,
+	//Like CountOnly, but also compares the old and new value on every hit to count writes that didn't change anything
+	RedundantWrites,
+	//Like CountOnly, but records which thread wrote which offset and when, for the false sharing detector
+	ThreadAttribution,
+};
+
+//Per call site hit counts for a breakpoint. Fixed size so the exception handler never allocates
+struct FHardwareBreakpointHitCounters
 {
-public:
-	virtual bool ShouldBreak(uint8 (&LastValue)[8], void* BreakpointAddress) = 0;
-	virtual ~IHardwareBreakpointCondition() {};
+	static constexpr int32 MaxCallSites = 16;
+
+	struct FCallSite
+	{
+		uint64 ProgramCounter = 0;
+		uint32 Count = 0;
+		//Writes that stored the value that was already there (RedundantWrites mode only)
+		uint32 RedundantCount = 0;
+	};
+	FCallSite CallSites[MaxCallSites];
+	uint32 TotalHits = 0;
+	uint32 RedundantHits = 0;
+	//Hits from call sites that didn't fit in CallSites
+	uint32 UntrackedHits = 0;
+
+	//Called from the exception handler, possibly on several threads at once for watches armed on all threads
+	//Call sites are claimed with a compare exchange, so two threads never take the same entry for different program counters
+	void Record(uint64 ProgramCounter, bool bRedundant = false)
+	{
+		FPlatformAtomics::InterlockedIncrement((volatile int32*)&TotalHits);
+		if (bRedundant)
+		{
+			FPlatformAtomics::InterlockedIncrement((volatile int32*)&RedundantHits);
+		}
+		for (FCallSite& CallSite : CallSites)
+		{
+			uint64 SiteProgramCounter = (uint64)FPlatformAtomics::AtomicRead((volatile int64*)&CallSite.ProgramCounter);
+			if (SiteProgramCounter == 0)
+			{
+				SiteProgramCounter = (uint64)FPlatformAtomics::InterlockedCompareExchange((volatile int64*)&CallSite.ProgramCounter, (int64)ProgramCounter, 0);
+				SiteProgramCounter = SiteProgramCounter == 0 ? ProgramCounter : SiteProgramCounter;
+			}
+			if (SiteProgramCounter == ProgramCounter)
+			{
+				FPlatformAtomics::InterlockedIncrement((volatile int32*)&CallSite.Count);
+				if (bRedundant)
+				{
+					FPlatformAtomics::InterlockedIncrement((volatile int32*)&CallSite.RedundantCount);
+				}
+				return;
+			}
+		}
+		FPlatformAtomics::InterlockedIncrement((volatile int32*)&UntrackedHits);
+	}
+
+	void Reset()
+	{
+		*this = FHardwareBreakpointHitCounters();
+	}
 };
 
-template <typename T, typename L>
-class TDataBreakpointConditionAdapter : public IHardwareBreakpointCondition
+//Log-linear (HDR style) histogram of function latencies, in FPlatformTime cycles
+//Each power of two is split in SubBucketCount linear buckets, so a bucket is never wider than ~6% of the values it holds
+//Fixed size so the exception handler never allocates
+struct FHardwareBreakpointLatencyHistogram
 {
-	L Lambda;
-public:
-	TDataBreakpointConditionAdapter(const L& InLambda) 
-		: Lambda(InLambda)
+	static constexpr int32 SubBucketBits = 4;
+	static constexpr int32 SubBucketCount = 1 << SubBucketBits;
+	static constexpr int32 BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+	uint32 Buckets[BucketCount] = {0};
+	uint64 Count = 0;
+	uint64 TotalCycles = 0;
+	uint64 MinCycles = MAX_uint64;
+	uint64 MaxCycles = 0;
+	//Calls made while an outer call was still being timed (recursion), only the outer one is measured
+	uint32 NestedCalls = 0;
+	//Calls that never returned through their return address (exceptions, longjmp)
+	uint32 AbandonedCalls = 0;
+
+	static int32 GetBucketIndex(uint64 Cycles)
 	{
+		if (Cycles < SubBucketCount)
+		{
+			return (int32)Cycles;
+		}
+		const int32 Shift = 63 - (int32)FPlatformMath::CountLeadingZeros64(Cycles) - SubBucketBits;
+		return (Shift + 1) * SubBucketCount + (int32)((Cycles >> Shift) & (SubBucketCount - 1));
+	}
+
+	//Largest value that falls in the bucket
+	static uint64 GetBucketUpperBound(int32 BucketIndex)
+	{
+		if (BucketIndex < SubBucketCount)
+		{
+			return BucketIndex;
+		}
+		const int32 Shift = BucketIndex / SubBucketCount - 1;
+		const uint64 LowerBound = (uint64)(SubBucketCount + BucketIndex % SubBucketCount) << Shift;
+		return LowerBound + ((uint64)1 << Shift) - 1;
+	}
+
+	void Record(uint64 Cycles)
+	{
+		++Buckets[GetBucketIndex(Cycles)];
+		++Count;
+		TotalCycles += Cycles;
+		MinCycles = Cycles < MinCycles ? Cycles : MinCycles;
+		MaxCycles = Cycles > MaxCycles ? Cycles : MaxCycles;
+	}
+
+	//Percentile in [0, 100]. Returns the upper bound of the bucket holding it, clamped to the max recorded value
+	uint64 GetValueAtPercentile(double Percentile) const
+	{
+		const uint64 Target = (uint64)(Percentile / 100.0 * Count + 0.5);
+		uint64 Accumulated = 0;
+		for (int32 i = 0; i < BucketCount; ++i)
+		{
+			Accumulated += Buckets[i];
+			if (Accumulated >= Target && Accumulated > 0)
+			{
+				const uint64 UpperBound = GetBucketUpperBound(i);
+				return UpperBound < MaxCycles ? UpperBound : MaxCycles;
+			}
+		}
+		return MaxCycles;
 	}
 
-	virtual bool ShouldBreak(uint8 (&LastValue)[8], void* BreakpointAddress) override
+	void Reset()
 	{
-		const T& TypedData = *reinterpret_cast<const T*>(BreakpointAddress);
-		const T& TypedLastValue = *reinterpret_cast<const T*>(LastValue);
-		return Lambda(TypedLastValue, TypedData);
+		*this = FHardwareBreakpointLatencyHistogram();
 	}
 };
 
+//Identifies the exact build of a loaded module, so what's learned about its code can be reused in later sessions
+struct FHardwareBreakpointModuleBuildId
+{
+	uint64 Base = 0;
+	uint64 Size = 0;
+	//PDB GUID and age on Windows
+	uint8 Id[20] = { 0 };
+	FString Name;
+};
+
 struct HARDWAREBREAKPOINTS_API FGenericPlatformHardwareBreakpoints
 {
 	template <typename R, typename T, typename... Args>
@@ -78,33 +235,146 @@ struct HARDWAREBREAKPOINTS_API FGenericPlatformHardwareBreakpoints
 
 	static DebugRegisterIndex SetDataBreakpoint(void* Address, int DataSize, UObject* Owner = nullptr);
 
+	//Data breakpoint that never breaks, hits are only counted per call site. Read them with GetHitCounters
+	static DebugRegisterIndex SetCountingDataBreakpoint(void* Address, int DataSize, UObject* Owner = nullptr);
+	//Execute breakpoint that never breaks, hits are only counted (e.g. a source line probe). Read them with GetHitCounters
+	static DebugRegisterIndex SetCountingExecuteBreakpoint(void* Address);
+	static bool GetHitCounters(DebugRegisterIndex Index, FHardwareBreakpointHitCounters& OutCounters, bool bReset = false);
+
+	//Links slots that watch parts of one value (e.g. the 8 byte chunks of an FVector): removing one removes them all,
+	//and a counting hit on several of them in one exception is only counted on the lowest of them
+	static void LinkBreakpoints(const DebugRegisterIndex* Indices, int32 NumIndices);
+
+	//Data breakpoint that never breaks, counts writes per call site and how many of them stored the value that was already there
+	static DebugRegisterIndex SetRedundantWriteDataBreakpoint(void* Address, int DataSize, UObject* Owner = nullptr);
+
+	//Count-only data breakpoint armed on every thread of the process (threads created afterwards are not covered)
+	//Each hit is attributed to the writing thread and forwarded to the false sharing detector
+	static DebugRegisterIndex SetThreadAttributionDataBreakpoint(void* Address, int DataSize);
+
+	//Execute breakpoints with an instance filter are only reported when 'this' is Instance
+	static void SetBreakpointInstanceFilter(DebugRegisterIndex Index, const void* Instance);
+	static const void* GetBreakpointInstanceFilter(DebugRegisterIndex Index);
+
+	//Labels are only used to identify breakpoints in reports
+	static void SetBreakpointLabel(DebugRegisterIndex Index, FName Label);
+	static FName GetBreakpointLabel(DebugRegisterIndex Index);
+	static EDataBreakpointMode GetBreakpointMode(DebugRegisterIndex Index);
+	//Address watched by the slot, null if nothing set through this class is in it. Tools that rotate over slots use it to tell their watches apart
+	static const void* GetBreakpointAddress(DebugRegisterIndex Index);
+
+	//Frames captured for hit callstacks of this breakpoint, 0 uses the project setting. Recorders with fixed size buffers capture at most what fits
+	static void SetBreakpointStackDepth(DebugRegisterIndex Index, int32 Depth);
+	static int32 GetBreakpointStackDepth(DebugRegisterIndex Index);
+
+	//Data breakpoint on an element of a TArray (or a character of an FString) that survives reallocation of the container
+	//Besides the element, this also watches the container's data pointer (and ArrayNum if there's a free slot), so when the container reallocates
+	//the element watch is moved to the new allocation from inside the exception handler
+	//ArrayHeader must point to the FScriptArray/TArray/FString itself. Returns the index of the element watch, linked slots are removed along with it
+	static DebugRegisterIndex SetReallocFollowingDataBreakpoint(void* ArrayHeader, int32 ElementIndex, int32 ElementSize, int32 OffsetInElement, int DataSize, UObject* Owner = nullptr);
+
+	//Latency probe on a native function: never breaks, times every call from entry to return into a histogram
+	//Uses two slots: an execute breakpoint on the function, and one that is moved to the return address on entry
+	//Armed on the calling thread only, and only calls made on that thread are timed. Read results with GetLatencyHistogram
+	static DebugRegisterIndex SetFunctionLatencyProbe(void* FunctionAddress);
+	static bool GetLatencyHistogram(DebugRegisterIndex Index, FHardwareBreakpointLatencyHistogram& OutHistogram, bool bReset = false);
+
 	static DebugRegisterIndex SetHardwareBreakpoint(EHardwareBreakpointType Type, EHardwareBreakpointSize Size, void* Address) { return -1; }
+	static DebugRegisterIndex SetHardwareBreakpointOnAllThreads(EHardwareBreakpointType Type, EHardwareBreakpointSize Size, void* Address) { return -1; }
 	static bool IsBreakpointSet(DebugRegisterIndex Index) { return false; }
 	static bool AnyBreakpointSet() { return false; }
 	static bool RemoveHardwareBreakpoint(DebugRegisterIndex Index) { return false; }
 	static bool RemoveAllHardwareBreakpoints() { return false; }
 	static void AddStructuredExceptionHandler() {}
 	static void RemoveStructuredExceptionHandler() {}
+	static void RemoveStructuredExceptionHandlerIfIdle() {}
 	static int32 GetSymbolDisplacementForProgramCounter(uint64 ProgramCounter) { return 0; }
+	static bool RetargetBreakpointInContext(DebugRegisterIndex Index, void* NewAddress, struct _EXCEPTION_POINTERS* ExceptionInfo) { return false; }
+	static void RemoveBreakpointInContext(DebugRegisterIndex Index, struct _EXCEPTION_POINTERS* ExceptionInfo) {}
+	static uint32 CaptureStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo) { return 0; }
+	static uint32 UnwindStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo) { return 0; }
+	static uint32 FramePointerStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo) { return 0; }
+	static bool GetModuleBuildId(uint64 ProgramCounter, FHardwareBreakpointModuleBuildId& OutBuildId) { return false; }
+	//Calls Visitor(Name, Address, Size) for every function with symbols in the module loaded at ModuleBase. False if the platform can't enumerate symbols
+	static bool EnumerateFunctionSymbols(uint64 ModuleBase, TFunctionRef<void(const ANSICHAR*, uint64, uint32)> Visitor) { return false; }
+	//Calls Visitor(Address, FilePath) for every code address generated for File:Line in the module, including inlined copies. File can be a bare file name
+	static bool EnumerateSourceLineAddresses(uint64 ModuleBase, const ANSICHAR* File, int32 Line, TFunctionRef<void(uint64, const ANSICHAR*)> Visitor) { return false; }
+	//Bit i is set if breakpoint i caused the exception, 0 if the platform can't tell
+	static uint32 GetTriggeredBreakpointMask(struct _EXCEPTION_POINTERS* ExceptionInfo) { return 0; }
+	static uint64 GetExceptionProgramCounter(struct _EXCEPTION_POINTERS* ExceptionInfo) { return 0; }
+	static uint64 GetExceptionStackPointer(struct _EXCEPTION_POINTERS* ExceptionInfo) { return 0; }
+	static uint64 GetExceptionThisPointer(struct _EXCEPTION_POINTERS* ExceptionInfo) { return 0; }
+	static void* ResolveMemberFunctionAddress(void* Address, const void* Instance) { return Address; }
 
 
 	//Internal
+	//Resets everything known about the slot, only for breakpoints that are removed for good
 	static void RemoveBreakpointAssociatedData(DebugRegisterIndex Index);
 	static void RemoveAllBreakpointAssociatedData();
+	//Returns the other slots that belong to the same watch as Index (e.g. container header watches of a realloc-following breakpoint)
+	static int32 GetLinkedBreakpoints(DebugRegisterIndex Index, DebugRegisterIndex (&OutLinked)[FPlatformHardwareBreakpointTraits::NumSlots]);
+	//Removes the watches whose owner was destroyed, along with their linked slots. Returns how many were written to OutRemoved
+	static int32 RemoveBreakpointsWithDestroyedOwners(DebugRegisterIndex (&OutRemoved)[FPlatformHardwareBreakpointTraits::NumSlots]);
 
 	// #TODO: Remove Windows _EXCEPTION_POINTERS from generic struct
 	static bool CheckDataBreakpointConditions(DebugRegisterIndex& OutRegisterIndex, struct _EXCEPTION_POINTERS *ExceptionInfo);
+	//Returns true if the exception was raised by a latency probe or a counting execute breakpoint. bOutStepOver is set if the faulting instruction has to be stepped over with the breakpoint disabled
+	static bool HandleFunctionProbeHit(DebugRegisterIndex& OutRegisterIndex, bool& bOutStepOver, struct _EXCEPTION_POINTERS* ExceptionInfo);
 
 protected:
 
+	enum class EDataBreakpointRole : uint8
+	{
+		//Regular watch, hits are reported
+		Watch,
+		//Internal watch on a container's data pointer, used to follow reallocations
+		ContainerData,
+		//Internal watch on a container's ArrayNum
+		ContainerNum,
+		//Execute breakpoint on the entry of a function with a latency probe
+		ProbeEntry,
+		//Execute breakpoint on the return address of the call being timed, parked on a non-code address between calls
+		ProbeReturn,
+		//Execute breakpoint that only counts hits
+		ExecuteCounter,
+	};
+
 	struct FDataBreakpointInfo
 	{
 		FWeakObjectPtr Owner;
 		bool bHasOwner;
 		void* Address = { nullptr };
-		uint8 LastValue[8] = {0};
+		//Aligned so counting watches can swap it atomically
+		alignas(8) uint8 LastValue[8] = {0};
 		int Size = 0;
 		IHardwareBreakpointCondition* Condition = { nullptr };
+
+		EDataBreakpointRole Role = EDataBreakpointRole::Watch;
+		EDataBreakpointMode Mode = EDataBreakpointMode::Break;
+		FHardwareBreakpointHitCounters Counters;
+		FName Label;
+		//Frames captured for hit callstacks, 0 uses the project setting
+		uint16 StackDepth = 0;
+		//Native function breakpoints only, calls where 'this' is a different object are skipped
+		const void* InstanceFilter = { nullptr };
+		//Armed on every thread, not only the one that set it
+		bool bAllThreads = false;
+		//Slot of the watch this slot belongs to (itself for the main watch), -1 if the watch only uses one slot
+		DebugRegisterIndex Group = -1;
+		//Realloc-following watches only
+		void* ArrayHeader = { nullptr };
+		int32 ElementIndex = -1;
+		int32 ElementSize = 0;
+		int32 OffsetInElement = 0;
+		//Latency probes only. Timing state lives in the return slot, the histogram in the entry slot
+		uint64 ProbeEntryCycles = 0;
+		uint64 ProbeEntryStackPointer = 0;
+		FHardwareBreakpointLatencyHistogram* Latency = { nullptr };
 	};
-	static FDataBreakpointInfo DataBreakpointInfo[MAX_HARDWARE_BREAKPOINTS];
+
+	static void InitDataBreakpointInfo(DebugRegisterIndex Index, void* Address, int DataSize, UObject* Owner);
+	static EHardwareBreakpointSize GetBreakpointSizeForDataSize(int DataSize);
+	static void HandleContainerHeaderWrite(DebugRegisterIndex Index, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	static void RecordHit(DebugRegisterIndex Index, uint64 ProgramCounter, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	static TStaticArray<FDataBreakpointInfo, FPlatformHardwareBreakpointTraits::NumSlots> DataBreakpointInfo;
 };
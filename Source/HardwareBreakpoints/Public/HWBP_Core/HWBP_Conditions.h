@@ -0,0 +1,33 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+//Engine independent breakpoint conditions, evaluated by the exception handler on the previous and current value of the watched memory
+//Only depends on the standard library, don't include engine headers here
+
+class IHardwareBreakpointCondition
+{
+public:
+	virtual bool ShouldBreak(std::uint8_t (&LastValue)[8], void* BreakpointAddress) = 0;
+	virtual ~IHardwareBreakpointCondition() {};
+};
+
+template <typename T, typename L>
+class TDataBreakpointConditionAdapter : public IHardwareBreakpointCondition
+{
+	L Lambda;
+public:
+	TDataBreakpointConditionAdapter(const L& InLambda) 
+		: Lambda(InLambda)
+	{
+	}
+
+	virtual bool ShouldBreak(std::uint8_t (&LastValue)[8], void* BreakpointAddress) override
+	{
+		const T& TypedData = *reinterpret_cast<const T*>(BreakpointAddress);
+		const T& TypedLastValue = *reinterpret_cast<const T*>(LastValue);
+		return Lambda(TypedLastValue, TypedData);
+	}
+};
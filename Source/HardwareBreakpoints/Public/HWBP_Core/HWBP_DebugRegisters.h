@@ -0,0 +1,139 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+//Engine independent x86-64 debug register logic: DR7 encoding, slot allocation and DR6 decoding
+//Everything works on plain register values, so it can be driven by a real thread context or a synthetic one
+//Only depends on the standard library, don't include engine headers here
+namespace HWBP_Core
+{
+	static constexpr int NumDebugRegisters = 4;
+
+	//EFLAGS trap flag, raises a single step exception after the next instruction
+	static constexpr std::uint32_t TrapFlag = 0x100;
+	//DR6 BS, set when the exception was raised by a single step
+	static constexpr std::uint64_t Dr6SingleStep = 1ull << 14;
+
+	//Same order as EHardwareBreakpointType
+	enum class EAccess : std::uint8_t
+	{
+		Execute,
+		ReadWrite,
+		Write,
+	};
+
+	constexpr std::uint64_t SetBits(std::uint64_t Register, int LowBit, int BitCount, std::uint64_t NewBits)
+	{
+		const std::uint64_t Mask = ((1ull << BitCount) - 1) << LowBit;
+		return (Register & ~Mask) | ((NewBits << LowBit) & Mask);
+	}
+
+	//DR7 R/W field
+	constexpr std::uint64_t GetAccessBits(EAccess Access)
+	{
+		return Access == EAccess::Write ? 1 : Access == EAccess::ReadWrite ? 3 : 0;
+	}
+
+	//DR7 LEN field. Execute breakpoints must use a length of 1
+	constexpr std::uint64_t GetLengthBits(int SizeInBytes)
+	{
+		return SizeInBytes == 2 ? 1 : SizeInBytes == 4 ? 3 : SizeInBytes == 8 ? 2 : 0;
+	}
+
+	//The CPU ignores the low bits of the address, so a watch only covers what it's meant to if the address is aligned to its length
+	constexpr bool IsAddressAligned(std::uint64_t Address, int SizeInBytes)
+	{
+		return SizeInBytes > 0 && (Address & (std::uint64_t)(SizeInBytes - 1)) == 0;
+	}
+
+	//Local enable bit (L0-L3)
+	constexpr bool IsSlotEnabled(std::uint64_t Dr7, int Slot)
+	{
+		return (Dr7 & (1ull << (Slot * 2))) != 0;
+	}
+
+	constexpr std::uint64_t EnableSlot(std::uint64_t Dr7, int Slot, EAccess Access, int SizeInBytes)
+	{
+		Dr7 = SetBits(Dr7, 16 + Slot * 4, 2, GetAccessBits(Access));
+		Dr7 = SetBits(Dr7, 18 + Slot * 4, 2, Access == EAccess::Execute ? 0 : GetLengthBits(SizeInBytes));
+		return SetBits(Dr7, Slot * 2, 1, 1);
+	}
+
+	//Only clears the enable bit, the address and the R/W and LEN fields are kept so the slot can be enabled again as it was
+	constexpr std::uint64_t DisableSlot(std::uint64_t Dr7, int Slot)
+	{
+		return Dr7 & ~(1ull << (Slot * 2));
+	}
+
+	//Returns the first slot from FirstSlot on that isn't enabled in DR7, or -1 if they're all in use
+	constexpr int FindFreeSlot(std::uint64_t Dr7, int FirstSlot = 0)
+	{
+		for (int Slot = FirstSlot; Slot < NumDebugRegisters; ++Slot)
+		{
+			if (!IsSlotEnabled(Dr7, Slot))
+			{
+				return Slot;
+			}
+		}
+		return -1;
+	}
+
+	constexpr int CountEnabledSlots(std::uint64_t Dr7)
+	{
+		int Count = 0;
+		for (int Slot = 0; Slot < NumDebugRegisters; ++Slot)
+		{
+			Count += IsSlotEnabled(Dr7, Slot) ? 1 : 0;
+		}
+		return Count;
+	}
+
+	//DR6 B0-B3: bit i is set if slot i's condition was met. The CPU never clears them, the handler has to
+	constexpr std::uint32_t GetTriggeredSlots(std::uint64_t Dr6)
+	{
+		return (std::uint32_t)(Dr6 & 0xF);
+	}
+
+	//Debug register state of one thread, laid out like DR0-DR3, DR6, DR7 in a Windows CONTEXT
+	struct FDebugRegisterState
+	{
+		std::uint64_t Address[NumDebugRegisters] = { 0 };
+		std::uint64_t Dr6 = 0;
+		std::uint64_t Dr7 = 0;
+
+		//Arms Address in the first free slot from FirstSlot on (or exactly in FirstSlot if bExactSlot). Returns the slot, or -1 if none is free
+		int Arm(std::uint64_t InAddress, EAccess Access, int SizeInBytes, int FirstSlot = 0, bool bExactSlot = false)
+		{
+			const int Slot = bExactSlot ? FirstSlot : FindFreeSlot(Dr7, FirstSlot);
+			if (Slot < 0 || Slot >= NumDebugRegisters)
+			{
+				return -1;
+			}
+			Address[Slot] = InAddress;
+			Dr6 = 0;
+			Dr7 = EnableSlot(Dr7, Slot, Access, SizeInBytes);
+			return Slot;
+		}
+
+		//Returns true if the slot was enabled
+		bool Disarm(int Slot)
+		{
+			const bool bWasEnabled = IsSlotEnabled(Dr7, Slot);
+			Address[Slot] = 0;
+			Dr7 = DisableSlot(Dr7, Slot);
+			return bWasEnabled;
+		}
+
+		bool DisarmAll()
+		{
+			bool bAnyEnabled = false;
+			for (int Slot = 0; Slot < NumDebugRegisters; ++Slot)
+			{
+				bAnyEnabled |= Disarm(Slot);
+			}
+			return bAnyEnabled;
+		}
+	};
+}
@@ -0,0 +1,41 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+
+//Engine independent frame pointer stack walk
+//Only depends on the standard library, don't include engine headers here
+namespace HWBP_Core
+{
+	//Follows the chain of saved frame pointers: [FramePointer] holds the caller's frame pointer, [FramePointer + 8] the return address
+	//Only meaningful for code built with frame pointers. The walk stops as soon as the chain leaves [StackLow, StackHigh), isn't aligned,
+	//or doesn't move towards StackHigh, so a frame pointer register holding anything else ends it instead of faulting
+	//StackLow should be the stack pointer of the trapped context, memory above it is always committed
+	inline std::uint32_t WalkFramePointers(std::uint64_t ProgramCounter, std::uint64_t FramePointer, std::uint64_t StackLow, std::uint64_t StackHigh, std::uint64_t* OutBackTrace, std::uint32_t MaxDepth)
+	{
+		if (MaxDepth == 0)
+		{
+			return 0;
+		}
+		std::uint32_t Depth = 0;
+		OutBackTrace[Depth++] = ProgramCounter;
+		while (Depth < MaxDepth && FramePointer >= StackLow && FramePointer + 2 * sizeof(std::uint64_t) <= StackHigh && (FramePointer & 7) == 0)
+		{
+			const std::uint64_t* Frame = reinterpret_cast<const std::uint64_t*>(FramePointer);
+			const std::uint64_t CallerFramePointer = Frame[0];
+			const std::uint64_t ReturnAddress = Frame[1];
+			if (ReturnAddress == 0)
+			{
+				break;
+			}
+			OutBackTrace[Depth++] = ReturnAddress;
+			if (CallerFramePointer <= FramePointer)
+			{
+				break;
+			}
+			FramePointer = CallerFramePointer;
+		}
+		return Depth;
+	}
+}
@@ -0,0 +1,32 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+//Engine independent classification of a data breakpoint exception for one slot
+//Only depends on the standard library, don't include engine headers here
+namespace HWBP_Core
+{
+	struct FHitClassification
+	{
+		//This slot raised the exception
+		bool bTriggered = false;
+		//The watched memory doesn't hold the last known value anymore
+		bool bValueChanged = false;
+		//Triggered by a write that stored the value that was already there
+		bool bRedundant = false;
+	};
+
+	//TriggeredSlots is the DR6 mask, or 0 if the platform can't tell which slot fired
+	//Without it a hit can only be told apart by the value changing, so redundant writes are never seen
+	inline FHitClassification ClassifyHit(std::uint32_t TriggeredSlots, int Slot, const void* LastValue, const void* Current, int Size)
+	{
+		FHitClassification Result;
+		Result.bValueChanged = std::memcmp(LastValue, Current, Size) != 0;
+		Result.bTriggered = TriggeredSlots != 0 ? (TriggeredSlots & (1u << Slot)) != 0 : Result.bValueChanged;
+		Result.bRedundant = Result.bTriggered && !Result.bValueChanged;
+		return Result;
+	}
+}
@@ -37,7 +37,11 @@ DECLARE_DYNAMIC_DELEGATE_RetVal_TwoParams(bool, FHWBP_IntCondition, int, OldValu
  * #TODO: Investigate ways to eliminate or minimize this delay (e.g., detecting when the debugger resumes the thread).
  */
 extern "C" HARDWAREBREAKPOINTS_API bool SetDataBreakpoint(UObject* Object, TCHAR* PropertyPath);
+extern "C" HARDWAREBREAKPOINTS_API bool SetWildcardDataBreakpoints(UObject* Object, TCHAR* PropertyPath);
 extern "C" HARDWAREBREAKPOINTS_API bool SetFunctionBreakpoint(UClass* Class, TCHAR* FunctionName);
+extern "C" HARDWAREBREAKPOINTS_API bool SetScriptFunctionBreakpoint(UClass* Class, TCHAR* FunctionName);
+extern "C" HARDWAREBREAKPOINTS_API bool SetSymbolBreakpoint(TCHAR* SymbolName);
+extern "C" HARDWAREBREAKPOINTS_API bool SetSourceLineBreakpoint(TCHAR* Location);
 extern "C" HARDWAREBREAKPOINTS_API bool AnyHardwareBreakpointSet();
 extern "C" HARDWAREBREAKPOINTS_API void ClearAllHardwareBreakpoints();
 
@@ -45,8 +49,16 @@ extern "C" HARDWAREBREAKPOINTS_API void ClearAllHardwareBreakpoints();
 
 // Alias for SetDataBreakpoint
 extern "C" inline HARDWAREBREAKPOINTS_API bool BP(UObject* Object, TCHAR* PropertyPath) { return SetDataBreakpoint(Object, PropertyPath); };
+// Alias for SetWildcardDataBreakpoints
+extern "C" inline HARDWAREBREAKPOINTS_API bool BPAll(UObject* Object, TCHAR* PropertyPath) { return SetWildcardDataBreakpoints(Object, PropertyPath); };
 // Alias for SetFunctionBreakpoint
 extern "C" inline HARDWAREBREAKPOINTS_API bool BPFunc(UClass* Class, TCHAR* FunctionName) { return SetFunctionBreakpoint(Class, FunctionName); };
+// Alias for SetScriptFunctionBreakpoint
+extern "C" inline HARDWAREBREAKPOINTS_API bool BPScript(UClass* Class, TCHAR* FunctionName) { return SetScriptFunctionBreakpoint(Class, FunctionName); };
+// Alias for SetSymbolBreakpoint
+extern "C" inline HARDWAREBREAKPOINTS_API bool BPSym(TCHAR* SymbolName) { return SetSymbolBreakpoint(SymbolName); };
+// Alias for SetSourceLineBreakpoint
+extern "C" inline HARDWAREBREAKPOINTS_API bool BPLine(TCHAR* Location) { return SetSourceLineBreakpoint(Location); };
 // Alias for ClearAllHardwareBreakpoints
 extern "C" inline HARDWAREBREAKPOINTS_API void ClearBP() { ClearAllHardwareBreakpoints(); }
 
@@ -82,6 +94,21 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
 	static void SetDataBreakpoint(UObject* Object, FString PropertyPath, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle);
 
+	//Sets data breakpoints on every address a wildcard property path expands to, e.g. "Components[*].RelativeLocation"
+	//Addresses are armed in order until no more breakpoint slots are free, bSuccess is true if at least one breakpoint was set
+	//The log says how many addresses couldn't be armed
+	//The path keeps being followed: elements added to the arrays along it are armed, and removed ones disarmed, as slots allow
+	//BreakpointHandles only covers the breakpoints armed by this call. Clearing any of them stops following the path
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void SetWildcardDataBreakpoints(UObject* Object, FString PropertyPath, bool& bSuccess, TArray<FHardwareBreakpointHandle>& BreakpointHandles);
+
+	//Like SetDataBreakpoint, but for paths that go through a TArray element or FString character (e.g. "Items[3].Count" or "Name[0]")
+	//The breakpoint keeps watching the element when the container reallocates, instead of watching freed memory
+	//This uses up to 3 breakpoint slots: the element, the container's data pointer, and the container's ArrayNum (if a slot is available)
+	//Use the HWBP.ReallocChurn console command to see which call sites grew or reallocated the watched containers
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void SetReallocFollowingDataBreakpoint(UObject* Object, FString PropertyPath, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle);
+
 	//A data breakpoint allows you to see what part of the code is modifying a specific float variable on any given object that will trigger only when the specific condition is met
 	//The condition is evaluated only once each time the variable changes value
 	//If you have a debugger attached, you can look up the callstack to see the specific part of the code that is changing the data
@@ -110,6 +137,94 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
 	static void SetFunctionBreakpoint(UClass* Class, FName FunctionName, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle);
 
+	//Like SetFunctionBreakpoint for Blueprint functions, but checked by the script VM instead of using a hardware breakpoint
+	//There's no limit on how many functions can be watched this way, and calls to other functions cost next to nothing
+	//The Blueprint callstack is logged and the debugger breaks (if attached) when the function is entered
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void SetScriptFunctionBreakpoint(UClass* Class, FName FunctionName, bool& bSuccess);
+
+	//Removes a breakpoint set with SetScriptFunctionBreakpoint
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void ClearScriptFunctionBreakpoint(UClass* Class, FName FunctionName);
+
+	//Sets an execute breakpoint on any native function with debug symbols, found by name in the loaded modules (e.g. "UWorld::Tick")
+	//Unlike SetFunctionBreakpoint it doesn't need a UFunction, and it's hit on every call, including direct C++ calls
+	//The name can be partial or have * and ? wildcards, as long as it matches a single function. Prefix it with "Module!" to narrow it down
+	//Use HWBP.Symbols.Find to list the candidates
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void SetSymbolBreakpoint(const FString& SymbolName, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle);
+
+	//Sets breakpoints on every code address of a source line, e.g. "MyActor.cpp:123" or "*-MyGame!MyActor.cpp:123"
+	//Prefixing the module avoids loading the line tables of every other module. If the line has more addresses than there are free slots,
+	//they take turns on the free slots every frame. Use ClearSourceLineWatches to remove them
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void SetSourceLineBreakpoint(const FString& Location, bool& bSuccess);
+
+	//Like SetSourceLineBreakpoint, but never stops, executions of the line are only counted
+	//Use the HWBP.Line.Report console command to see the counts
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void SetSourceLineProbe(const FString& Location, int32 FramesPerWindow, bool& bSuccess);
+
+	//Removes every breakpoint and probe set with SetSourceLineBreakpoint or SetSourceLineProbe
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void ClearSourceLineWatches();
+
+	//Profiles how often each property of an object is written, rotating count-only breakpoints over the properties of its class
+	//Every FramesPerWindow frames the next group of properties is watched. Count-only breakpoints never break or show windows,
+	//they just count writes per call site. The report (writes/sec per property and top writers) is logged after each full rotation
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void StartWriteProfiler(UObject* Object, int32 FramesPerWindow, bool& bSuccess);
+
+	//Watches a property for writes that store the value it already had. Never breaks, writes are counted per call site
+	//Use Log Redundant Write Report (or the HWBP.RedundantWrites console command) to see the top offenders
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void SetRedundantWriteDataBreakpoint(UObject* Object, FString PropertyPath, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle);
+
+	//Logs the no-op writes per call site of every active redundant write breakpoint
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void LogRedundantWriteReport();
+
+	//Stops the write profiler and logs its report
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void StopWriteProfiler();
+
+	//Watches the cache line containing a property for writes from any thread, to confirm false sharing before changing a layout
+	//Only 32 of the 64 bytes can be watched at once, so the line is covered in passes of FramesPerPass frames
+	//Use Stop False Sharing Detector (or the HWBP.FalseSharing.Report console command) to see which threads wrote which offsets
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void StartFalseSharingDetector(UObject* Object, FString PropertyPath, int32 FramesPerPass, bool& bSuccess);
+
+	//Stops the false sharing detector and logs its report
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void StopFalseSharingDetector();
+
+	//Times every call to a native function made on the calling thread, without ever stopping. SymbolName is looked up like in SetSymbolBreakpoint, e.g. UWorld::Tick
+	//Uses two breakpoint slots. Use Log Function Latency Report (or the HWBP.Probe.Report console command) to see the distribution
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void SetFunctionLatencyProbe(FString SymbolName, bool& bSuccess, FHardwareBreakpointHandle& BreakpointHandle);
+
+	//Logs the latency percentiles of every active function latency probe
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void LogFunctionLatencyReport();
+
+	//Counts Blueprint VM opcodes and the time spent in them, per opcode and per Blueprint function, on the game thread
+	//Use Stop Blueprint VM Profiler (or the HWBP.OpcodeProfiler.Report console command) to see which graphs dominate VM time
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly, DisplayName = "Start Blueprint VM Profiler"))
+	static void StartOpcodeProfiler();
+
+	//Stops the Blueprint VM profiler and logs its report
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly, DisplayName = "Stop Blueprint VM Profiler"))
+	static void StopOpcodeProfiler();
+
+	//Starts counting hits of count-only data breakpoints (write profiler, redundant writes...) and script function breakpoints
+	//per Blueprint node. Use Log Blueprint Node Heatmap (or HWBP.Heatmap.Report) to see which nodes hit each watch the most
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void StartBlueprintNodeHeatmap();
+
+	//Logs hits per Blueprint node for every watch, hottest first
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints|Profiling", meta = (DevelopmentOnly))
+	static void LogBlueprintNodeHeatmap();
+
 	//Checks whether a specific hardware breakpoint is set
 	UFUNCTION(BlueprintPure, Category = "Hardware Breakpoints", meta = (DevelopmentOnly, DisplayName="Is Valid"))
 	static bool K2_IsBreakpointHandleValid(FHardwareBreakpointHandle BreakpointHandle);
@@ -119,6 +234,11 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Hardware Breakpoints")
 	static bool AnyHardwareBreakpointSet();
 
+	//Overrides how many frames are captured for the callstacks of this breakpoint's hits (the Stack Depth project setting otherwise)
+	//Short stacks make hits cheaper, especially with the frame pointer stack walker. 0 goes back to the project setting
+	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
+	static void SetBreakpointStackDepth(FHardwareBreakpointHandle BreakpointHandle, int32 Depth);
+
 	//Clears a specific hardware breakpoint, does nothing if the breakpoint handle has already been cleared
 	UFUNCTION(BlueprintCallable, Category = "Hardware Breakpoints", meta = (DevelopmentOnly))
 	static void ClearHardwareBreakpoint(UPARAM(Ref) FHardwareBreakpointHandle& BreakpointHandle);
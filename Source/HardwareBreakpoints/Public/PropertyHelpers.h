@@ -29,6 +29,9 @@ namespace PropertyHelpers
 	using UObjectPropertyType	= FObjectProperty;
 	using FloatPropertyType		= FFloatProperty;
 	using IntPropertyType		= FIntProperty;
+	using StrPropertyType		= FStrProperty;
+	using MapPropertyType		= FMapProperty;
+	using SetPropertyType		= FSetProperty;
 
 	#define CAST_PROPERTY CastField
 #else
@@ -38,6 +41,9 @@ namespace PropertyHelpers
 	using UObjectPropertyType	= UObjectProperty;
 	using FloatPropertyType		= UFloatProperty;
 	using IntPropertyType		= UIntProperty;
+	using StrPropertyType		= UStrProperty;
+	using MapPropertyType		= UMapProperty;
+	using SetPropertyType		= USetProperty;
 	
 	#define CAST_PROPERTY Cast
 #endif
@@ -48,9 +54,18 @@ namespace PropertyHelpers
 		PropertyType* Property;
 		void* Address;
 
+		//If Address lives inside the allocation of a TArray or FString (e.g. "Items[3].Count"), the container that owns it
+		//Used by realloc-following data breakpoints to re-resolve the address when the container reallocates
+		void* ContainerHeader;
+		int32 ContainerIndex;
+		int32 ContainerElementSize;
+
 		FPropertyAddress()
 			: Property(nullptr)
 			, Address(nullptr)
+			, ContainerHeader(nullptr)
+			, ContainerIndex(INDEX_NONE)
+			, ContainerElementSize(0)
 		{}
 	};
 
@@ -68,4 +83,86 @@ namespace PropertyHelpers
 
 	HARDWAREBREAKPOINTS_API FPropertyAddress FindPropertyAddress(void* BasePointer, UStruct* InStruct, const FString& InPropertyPath);
 
+	//A property path parsed once into segments, so it can be resolved repeatedly without re-parsing the string
+	//Segments of the form Name[*] are wildcards that expand to every element of the array
+	//e.g. "Components[*].RelativeLocation" or "Inventory.Items[*].Count"
+	class HARDWAREBREAKPOINTS_API FCompiledPropertyPath
+	{
+	public:
+		struct FSegment
+		{
+			//Property name, without the subscript
+			FString Name;
+			//Index for segments of the form Name[N], INDEX_NONE otherwise
+			int32 ArrayIndex = INDEX_NONE;
+			bool bWildcard = false;
+
+			//Property lookups are cached per struct, as the same path can be resolved against different (sub)classes
+			mutable TMap<const UStruct*, PropertyType*> PropertyCache;
+		};
+
+		bool Compile(const FString& InPropertyPath);
+		bool IsValid() const { return Segments.Num() > 0; }
+		bool HasWildcards() const { return FirstWildcard != INDEX_NONE; }
+		int32 Num() const { return Segments.Num(); }
+		const FSegment& operator[](int32 Index) const { return Segments[Index]; }
+		const FString& GetPath() const { return Path; }
+
+		//Resolves segments [StartSegment, EndSegment) which must not contain wildcards
+		//If EndSegment is the end of the path, OutLeaf receives the final property address
+		//Otherwise InOutBase/InOutStruct are advanced to the container the segment at EndSegment has to be looked up in
+		bool ResolveRange(int32 StartSegment, int32 EndSegment, void*& InOutBase, UStruct*& InOutStruct, FPropertyAddress& OutLeaf) const;
+
+		int32 FindNextWildcard(int32 StartSegment) const;
+
+	private:
+		TArray<FSegment> Segments;
+		FString Path;
+		int32 FirstWildcard = INDEX_NONE;
+	};
+
+	//Keeps the expanded set of addresses for a wildcard path
+	//Update() re-expands incrementally: as long as an array hasn't reallocated, elements that were already expanded are kept
+	//and only elements that were added since the last update get resolved
+	class HARDWAREBREAKPOINTS_API FPropertyPathExpansion
+	{
+	public:
+		FPropertyPathExpansion() = default;
+		explicit FPropertyPathExpansion(const FCompiledPropertyPath& InPath) : Path(InPath) {}
+
+		void Reset(const FCompiledPropertyPath& InPath);
+
+		//Returns the number of addresses that changed (added or removed) since the last update
+		//If OutAdded is passed, it receives the addresses that weren't present on the previous update
+		int32 Update(void* BasePointer, UStruct* InStruct, TArray<FPropertyAddress>* OutAdded = nullptr);
+
+		void GetAddresses(TArray<FPropertyAddress>& OutAddresses) const;
+		const FCompiledPropertyPath& GetPath() const { return Path; }
+
+	private:
+		struct FNode;
+		struct FElement
+		{
+			//Identifies what the element resolved through: the dereferenced object for object arrays, otherwise the element itself
+			const void* Key = nullptr;
+			FPropertyAddress Leaf;
+			TSharedPtr<FNode> Child;
+		};
+		struct FNode
+		{
+			const void* ArrayContainer = nullptr;
+			const void* ArrayData = nullptr;
+			TArray<FElement> Elements;
+		};
+
+		int32 UpdateNode(FNode& Node, int32 WildcardSegment, void* BasePointer, UStruct* InStruct, TArray<FPropertyAddress>* OutAdded);
+		void UpdateElement(FElement& Element, int32 WildcardSegment, const ArrayPropertyType* ArrayProp, void* ElementPtr, TArray<FPropertyAddress>* OutAdded, int32& InOutChanged);
+		static void CollectAddresses(const FNode& Node, TArray<FPropertyAddress>& OutAddresses);
+		static int32 CountAddresses(const FNode& Node);
+		static int32 CountAddresses(const FElement& Element);
+
+		FCompiledPropertyPath Path;
+		FPropertyAddress PrefixLeaf;
+		TSharedPtr<FNode> Root;
+	};
 }
\ No newline at end of file
@@ -4,10 +4,6 @@
 
 #include "CoreTypes.h"
 
-#ifndef MAX_HARDWARE_BREAKPOINTS
-#define MAX_HARDWARE_BREAKPOINTS 4
-#endif
-
 #include "GenericPlatform/GenericPlatformHardwareBreakpoints.h"
 
 struct HARDWAREBREAKPOINTS_API FWindowsPlatformHardwareBreakpoints : public FGenericPlatformHardwareBreakpoints
@@ -19,14 +15,62 @@ struct HARDWAREBREAKPOINTS_API FWindowsPlatformHardwareBreakpoints : public FGen
 		void* Address = reinterpret_cast<void*&>(Func);
 		return SetHardwareBreakpoint(EHardwareBreakpointType::Execute, EHardwareBreakpointSize::Size_1, Address);
 	}
+	//Only breaks when the method is called on Instance, calls on other objects are skipped by the handler before any other work
+	//Virtual methods are resolved through Instance's vtable, so the breakpoint lands on the override that Instance actually runs
+	template <typename R, typename T, typename... Args>
+	static DebugRegisterIndex SetNativeFunctionHardwareBreakpoint(R(T::*Func)(Args...), const T* Instance)
+	{
+		if (Instance == nullptr)
+		{
+			return -1;
+		}
+		void* Address = ResolveMemberFunctionAddress(reinterpret_cast<void*&>(Func), Instance);
+		DebugRegisterIndex Index = SetHardwareBreakpoint(EHardwareBreakpointType::Execute, EHardwareBreakpointSize::Size_1, Address);
+		SetBreakpointInstanceFilter(Index, Instance);
+		return Index;
+	}
+	template <typename R, typename T, typename... Args>
+	static DebugRegisterIndex SetNativeFunctionLatencyProbe(R(T::*Func)(Args...))
+	{
+		void* Address = reinterpret_cast<void*&>(Func);
+		return SetFunctionLatencyProbe(Address);
+	}
 	static DebugRegisterIndex SetHardwareBreakpoint(EHardwareBreakpointType Type, EHardwareBreakpointSize Size, void* Address);
+	//Debug registers are per thread, this arms the breakpoint in the same slot on every thread currently running in the process
+	static DebugRegisterIndex SetHardwareBreakpointOnAllThreads(EHardwareBreakpointType Type, EHardwareBreakpointSize Size, void* Address);
 	static bool IsBreakpointSet(DebugRegisterIndex Index);
 	static bool AnyBreakpointSet();
 	static bool RemoveHardwareBreakpoint(DebugRegisterIndex Index);
 	static bool RemoveAllHardwareBreakpoints();
+	//The exception handler is installed when the first breakpoint is armed, and removed once none is armed on any thread
 	static void AddStructuredExceptionHandler();
 	static void RemoveStructuredExceptionHandler();
+	static void RemoveStructuredExceptionHandlerIfIdle();
 	static bool IsAnyRegistersContainOurBreakpointAddress(const void* BreakpointAddress, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//Moves a breakpoint to a new address from inside the exception handler, the change is applied when execution continues
+	static bool RetargetBreakpointInContext(DebugRegisterIndex Index, void* NewAddress, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//Removes a breakpoint for good from inside the exception handler, the change is applied when execution continues
+	//RemoveHardwareBreakpoint can't be used there, it changes registers through a helper thread and may uninstall the running handler
+	static void RemoveBreakpointInContext(DebugRegisterIndex Index, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//Captures the callstack of the thread that raised the exception, with the stack walker picked in the project settings
+	static uint32 CaptureStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//Same, but walks the unwind tables directly instead of going through DbgHelp, so it can run while symbols are being loaded on another thread
+	static uint32 UnwindStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//Follows RBP, and falls back to UnwindStackBackTrace if any return address isn't in a function with unwind data (i.e. RBP isn't a frame pointer)
+	static uint32 FramePointerStackBackTrace(uint64* OutBackTrace, uint32 MaxDepth, struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//Finds the module containing ProgramCounter and reads the PDB signature from its debug directory
+	static bool GetModuleBuildId(uint64 ProgramCounter, FHardwareBreakpointModuleBuildId& OutBuildId);
+	//Enumerates the module's PDB with SymEnumSymbols, which loads its symbols if they were deferred
+	static bool EnumerateFunctionSymbols(uint64 ModuleBase, TFunctionRef<void(const ANSICHAR*, uint64, uint32)> Visitor);
+	//Reads the PDB line tables with SymEnumSourceLines
+	static bool EnumerateSourceLineAddresses(uint64 ModuleBase, const ANSICHAR* File, int32 Line, TFunctionRef<void(uint64, const ANSICHAR*)> Visitor);
+	static uint32 GetTriggeredBreakpointMask(struct _EXCEPTION_POINTERS* ExceptionInfo);
+	static uint64 GetExceptionProgramCounter(struct _EXCEPTION_POINTERS* ExceptionInfo);
+	static uint64 GetExceptionStackPointer(struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//First argument register, which holds 'this' for member functions (RCX)
+	static uint64 GetExceptionThisPointer(struct _EXCEPTION_POINTERS* ExceptionInfo);
+	//Skips incremental linking jumps, and resolves MSVC vcall thunks (what a pointer to a virtual method points to) through Instance's vtable
+	static void* ResolveMemberFunctionAddress(void* Address, const void* Instance);
 
 	static int32 GetSymbolDisplacementForProgramCounter(uint64 ProgramCounter);
 	static uint64 GetAddressFromSymbolName(const CHAR* SymbolName);
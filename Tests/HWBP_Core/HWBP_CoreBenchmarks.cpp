@@ -0,0 +1,125 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+//Microbenchmarks of the work the exception handler does per hit, on synthetic register contexts and stacks
+//Usage: HWBP_CoreBenchmarks [Iterations]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "HWBP_Core/HWBP_DebugRegisters.h"
+#include "HWBP_Core/HWBP_FrameWalk.h"
+#include "HWBP_Core/HWBP_HitClassification.h"
+
+using namespace HWBP_Core;
+
+//Results are folded into this so the optimizer can't drop the measured work
+static volatile std::uint64_t Sink = 0;
+
+template <typename F>
+static void Run(const char* Name, std::uint64_t Iterations, F&& Body)
+{
+	std::uint64_t Accumulator = 0;
+	const auto Start = std::chrono::steady_clock::now();
+	for (std::uint64_t i = 0; i < Iterations; ++i)
+	{
+		Accumulator += Body(i);
+	}
+	const auto End = std::chrono::steady_clock::now();
+	Sink = Sink + Accumulator;
+	const double Nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start).count();
+	std::printf("%-32s %10.2f ns/op\n", Name, Nanoseconds / (double)Iterations);
+}
+
+int main(int argc, char** argv)
+{
+	const std::uint64_t Iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+	if (Iterations == 0)
+	{
+		std::printf("Usage: HWBP_CoreBenchmarks [Iterations]\n");
+		return 1;
+	}
+
+	//Four armed 8 byte watches, like the handler sees with every slot in use
+	FDebugRegisterState State;
+	for (int Slot = 0; Slot < NumDebugRegisters; ++Slot)
+	{
+		State.Arm(0x1000 + Slot * 8, EAccess::Write, 8);
+	}
+	std::uint64_t LastValues[NumDebugRegisters] = { 1, 2, 3, 4 };
+	std::uint64_t CurrentValues[NumDebugRegisters] = { 1, 5, 3, 6 };
+
+	//What the handler does for a data hit: find the slots that fired in DR6 and classify each of them
+	Run("Dispatch (DR6 mask)", Iterations, [&](std::uint64_t i)
+	{
+		const std::uint32_t Triggered = GetTriggeredSlots((i & 0xF) | Dr6SingleStep);
+		std::uint64_t Hits = 0;
+		for (int Slot = 0; Slot < NumDebugRegisters; ++Slot)
+		{
+			if (IsSlotEnabled(State.Dr7, Slot))
+			{
+				const FHitClassification Hit = ClassifyHit(Triggered, Slot, &LastValues[Slot], &CurrentValues[Slot], 8);
+				Hits += (Hit.bTriggered ? 1 : 0) + (Hit.bRedundant ? 2 : 0);
+			}
+		}
+		return Hits;
+	});
+
+	//Same without DR6, every slot has to be compared
+	Run("Dispatch (value compare)", Iterations, [&](std::uint64_t i)
+	{
+		CurrentValues[i & 3] ^= i;
+		std::uint64_t Hits = 0;
+		for (int Slot = 0; Slot < NumDebugRegisters; ++Slot)
+		{
+			Hits += ClassifyHit(0, Slot, &LastValues[Slot], &CurrentValues[Slot], 8).bTriggered ? 1 : 0;
+		}
+		return Hits;
+	});
+
+	//Temporary disarm and rearm of a slot, as done around the single step that follows a hit
+	Run("Disarm + Arm exact slot", Iterations, [&](std::uint64_t i)
+	{
+		const int Slot = (int)(i & 3);
+		const std::uint64_t Address = State.Address[Slot];
+		State.Disarm(Slot);
+		return (std::uint64_t)State.Arm(Address, EAccess::Write, 8, Slot, true);
+	});
+
+	Run("DisarmAll + Arm x4", Iterations, [&](std::uint64_t i)
+	{
+		State.DisarmAll();
+		std::uint64_t Slots = 0;
+		for (int Slot = 0; Slot < NumDebugRegisters; ++Slot)
+		{
+			Slots += (std::uint64_t)State.Arm((i << 5) + Slot * 8, i & 1 ? EAccess::ReadWrite : EAccess::Write, 8 >> (i & 3));
+		}
+		return Slots + State.Dr7 + State.Address[3];
+	});
+
+	//Frame pointer walk over a depth 32 synthetic chain
+	const std::uint32_t NumFrames = 32;
+	alignas(16) static std::uint64_t Stack[NumFrames * 4 + 4];
+	for (std::uint32_t Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		Stack[Frame * 4] = Frame + 1 < NumFrames ? reinterpret_cast<std::uint64_t>(&Stack[(Frame + 1) * 4]) : 0;
+		Stack[Frame * 4 + 1] = 0x140000000ull + Frame;
+	}
+	const std::uint64_t StackLow = reinterpret_cast<std::uint64_t>(&Stack[0]);
+	const std::uint64_t StackHigh = reinterpret_cast<std::uint64_t>(Stack + sizeof(Stack) / sizeof(Stack[0]));
+	std::uint64_t BackTrace[64];
+
+	Run("WalkFramePointers depth 8", Iterations, [&](std::uint64_t i)
+	{
+		return (std::uint64_t)WalkFramePointers(0x7000 + i, StackLow, StackLow, StackHigh, BackTrace, 8) + BackTrace[7];
+	});
+
+	Run("WalkFramePointers depth 32", Iterations, [&](std::uint64_t i)
+	{
+		return (std::uint64_t)WalkFramePointers(0x7000 + i, StackLow, StackLow, StackHigh, BackTrace, 64) + BackTrace[31];
+	});
+
+	return 0;
+}
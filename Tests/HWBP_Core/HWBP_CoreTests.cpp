@@ -0,0 +1,283 @@
+// Copyright Daniel Amthauer. All Rights Reserved.
+
+//Unit tests for the engine independent core, driven by synthetic register contexts and stacks
+//No test framework on purpose, so the target builds anywhere with just a compiler and CMake
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "HWBP_Core/HWBP_Conditions.h"
+#include "HWBP_Core/HWBP_DebugRegisters.h"
+#include "HWBP_Core/HWBP_FrameWalk.h"
+#include "HWBP_Core/HWBP_HitClassification.h"
+
+using namespace HWBP_Core;
+
+static int NumChecks = 0;
+static int NumFailures = 0;
+
+#define HWBP_CHECK(Expression) \
+	do \
+	{ \
+		++NumChecks; \
+		if (!(Expression)) \
+		{ \
+			++NumFailures; \
+			std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #Expression); \
+		} \
+	} \
+	while (0)
+
+//R/W field of a slot in DR7
+static std::uint64_t GetAccessField(std::uint64_t Dr7, int Slot)
+{
+	return (Dr7 >> (16 + Slot * 4)) & 3;
+}
+
+//LEN field of a slot in DR7
+static std::uint64_t GetLengthField(std::uint64_t Dr7, int Slot)
+{
+	return (Dr7 >> (18 + Slot * 4)) & 3;
+}
+
+static void TestEnableSlot()
+{
+	std::uint64_t Dr7 = EnableSlot(0, 1, EAccess::Write, 4);
+	HWBP_CHECK(IsSlotEnabled(Dr7, 1));
+	HWBP_CHECK(!IsSlotEnabled(Dr7, 0) && !IsSlotEnabled(Dr7, 2) && !IsSlotEnabled(Dr7, 3));
+	HWBP_CHECK(GetAccessField(Dr7, 1) == 1);
+	HWBP_CHECK(GetLengthField(Dr7, 1) == 3);
+	HWBP_CHECK(Dr7 == ((1ull << 2) | (1ull << 20) | (3ull << 22)));
+
+	//LEN encodings: 1 -> 00, 2 -> 01, 8 -> 10, 4 -> 11
+	HWBP_CHECK(GetLengthField(EnableSlot(0, 0, EAccess::ReadWrite, 1), 0) == 0);
+	HWBP_CHECK(GetLengthField(EnableSlot(0, 0, EAccess::ReadWrite, 2), 0) == 1);
+	HWBP_CHECK(GetLengthField(EnableSlot(0, 0, EAccess::ReadWrite, 8), 0) == 2);
+	HWBP_CHECK(GetAccessField(EnableSlot(0, 0, EAccess::ReadWrite, 8), 0) == 3);
+
+	//Execute breakpoints always use a length of 1, whatever size is asked for
+	const std::uint64_t ExecuteDr7 = EnableSlot(0, 3, EAccess::Execute, 8);
+	HWBP_CHECK(IsSlotEnabled(ExecuteDr7, 3));
+	HWBP_CHECK(GetAccessField(ExecuteDr7, 3) == 0);
+	HWBP_CHECK(GetLengthField(ExecuteDr7, 3) == 0);
+
+	//Re-enabling a slot replaces its fields instead of OR-ing them
+	Dr7 = EnableSlot(EnableSlot(0, 2, EAccess::ReadWrite, 8), 2, EAccess::Write, 1);
+	HWBP_CHECK(GetAccessField(Dr7, 2) == 1);
+	HWBP_CHECK(GetLengthField(Dr7, 2) == 0);
+
+	//Other slots are left alone
+	Dr7 = EnableSlot(EnableSlot(0, 0, EAccess::Write, 8), 3, EAccess::ReadWrite, 2);
+	HWBP_CHECK(GetAccessField(Dr7, 0) == 1 && GetLengthField(Dr7, 0) == 2);
+	HWBP_CHECK(GetAccessField(Dr7, 3) == 3 && GetLengthField(Dr7, 3) == 1);
+	HWBP_CHECK(CountEnabledSlots(Dr7) == 2);
+}
+
+static void TestDisableSlot()
+{
+	const std::uint64_t Enabled = EnableSlot(EnableSlot(0, 0, EAccess::Write, 8), 1, EAccess::ReadWrite, 4);
+	const std::uint64_t Disabled = DisableSlot(Enabled, 0);
+	HWBP_CHECK(!IsSlotEnabled(Disabled, 0));
+	HWBP_CHECK(IsSlotEnabled(Disabled, 1));
+	//The R/W and LEN fields survive, so the slot can be enabled again exactly as it was
+	HWBP_CHECK(GetAccessField(Disabled, 0) == 1 && GetLengthField(Disabled, 0) == 2);
+	HWBP_CHECK((Disabled | 1ull) == Enabled);
+	HWBP_CHECK(DisableSlot(Disabled, 0) == Disabled);
+	HWBP_CHECK(CountEnabledSlots(Disabled) == 1);
+}
+
+static void TestFindFreeSlot()
+{
+	HWBP_CHECK(FindFreeSlot(0) == 0);
+	HWBP_CHECK(FindFreeSlot(0, 2) == 2);
+	std::uint64_t Dr7 = EnableSlot(0, 0, EAccess::Write, 8);
+	HWBP_CHECK(FindFreeSlot(Dr7) == 1);
+	Dr7 = EnableSlot(Dr7, 1, EAccess::Write, 8);
+	Dr7 = EnableSlot(Dr7, 3, EAccess::Write, 8);
+	HWBP_CHECK(FindFreeSlot(Dr7) == 2);
+	HWBP_CHECK(FindFreeSlot(Dr7, 3) == -1);
+	Dr7 = EnableSlot(Dr7, 2, EAccess::Write, 8);
+	HWBP_CHECK(FindFreeSlot(Dr7) == -1);
+	HWBP_CHECK(FindFreeSlot(DisableSlot(Dr7, 1)) == 1);
+	HWBP_CHECK(FindFreeSlot(0, NumDebugRegisters) == -1);
+}
+
+static void TestGetTriggeredSlots()
+{
+	HWBP_CHECK(GetTriggeredSlots(0) == 0);
+	HWBP_CHECK(GetTriggeredSlots(0x1) == 0x1);
+	HWBP_CHECK(GetTriggeredSlots(0x8) == 0x8);
+	//BS and the reserved high bits aren't slots
+	HWBP_CHECK(GetTriggeredSlots(Dr6SingleStep | 0x5) == 0x5);
+	HWBP_CHECK(GetTriggeredSlots(0xFFFF0FF0ull) == 0);
+	HWBP_CHECK(GetTriggeredSlots(~0ull) == 0xF);
+}
+
+static void TestAlignment()
+{
+	HWBP_CHECK(IsAddressAligned(0x1000, 8));
+	HWBP_CHECK(!IsAddressAligned(0x1004, 8));
+	HWBP_CHECK(IsAddressAligned(0x1004, 4));
+	HWBP_CHECK(IsAddressAligned(0x1003, 1));
+	HWBP_CHECK(!IsAddressAligned(0x1003, 2));
+	HWBP_CHECK(!IsAddressAligned(0x1000, 0));
+}
+
+static void TestArmDisarm()
+{
+	FDebugRegisterState State;
+	State.Dr6 = 0xF;
+	HWBP_CHECK(State.Arm(0x1000, EAccess::Write, 8) == 0);
+	HWBP_CHECK(State.Address[0] == 0x1000);
+	//Stale hit bits are cleared when arming, so they're not mistaken for a hit of the new watch
+	HWBP_CHECK(State.Dr6 == 0);
+	HWBP_CHECK(State.Arm(0x2000, EAccess::ReadWrite, 4) == 1);
+	HWBP_CHECK(State.Arm(0x3000, EAccess::Execute, 1, 3) == 3);
+	HWBP_CHECK(State.Arm(0x4000, EAccess::Write, 2) == 2);
+	HWBP_CHECK(CountEnabledSlots(State.Dr7) == 4);
+	HWBP_CHECK(State.Arm(0x5000, EAccess::Write, 8) == -1);
+	HWBP_CHECK(State.Address[0] == 0x1000 && State.Address[1] == 0x2000 && State.Address[2] == 0x4000 && State.Address[3] == 0x3000);
+
+	//An exact slot is armed even if it's in use, that's how a watch is moved to a new address in place
+	HWBP_CHECK(State.Arm(0x6000, EAccess::Write, 1, 1, true) == 1);
+	HWBP_CHECK(State.Address[1] == 0x6000);
+	HWBP_CHECK(GetAccessField(State.Dr7, 1) == 1 && GetLengthField(State.Dr7, 1) == 0);
+	HWBP_CHECK(State.Arm(0x6000, EAccess::Write, 1, NumDebugRegisters, true) == -1);
+
+	HWBP_CHECK(State.Disarm(2));
+	HWBP_CHECK(State.Address[2] == 0);
+	HWBP_CHECK(!IsSlotEnabled(State.Dr7, 2));
+	HWBP_CHECK(!State.Disarm(2));
+	HWBP_CHECK(State.Arm(0x7000, EAccess::Write, 8) == 2);
+
+	HWBP_CHECK(State.DisarmAll());
+	HWBP_CHECK(CountEnabledSlots(State.Dr7) == 0);
+	HWBP_CHECK(!State.DisarmAll());
+	for (int Slot = 0; Slot < NumDebugRegisters; ++Slot)
+	{
+		HWBP_CHECK(State.Address[Slot] == 0);
+	}
+}
+
+static void TestClassifyHit()
+{
+	std::uint64_t LastValue = 5;
+	std::uint64_t Current = 5;
+
+	//With DR6 a write of the same value is still seen, as redundant
+	FHitClassification Hit = ClassifyHit(0x2, 1, &LastValue, &Current, 8);
+	HWBP_CHECK(Hit.bTriggered && !Hit.bValueChanged && Hit.bRedundant);
+
+	//Another slot fired
+	Hit = ClassifyHit(0x1, 1, &LastValue, &Current, 8);
+	HWBP_CHECK(!Hit.bTriggered && !Hit.bRedundant);
+
+	Current = 6;
+	Hit = ClassifyHit(0x2, 1, &LastValue, &Current, 8);
+	HWBP_CHECK(Hit.bTriggered && Hit.bValueChanged && !Hit.bRedundant);
+
+	//Without DR6 only changes are hits, and nothing is ever redundant
+	Hit = ClassifyHit(0, 1, &LastValue, &Current, 8);
+	HWBP_CHECK(Hit.bTriggered && Hit.bValueChanged && !Hit.bRedundant);
+	Current = 5;
+	Hit = ClassifyHit(0, 1, &LastValue, &Current, 8);
+	HWBP_CHECK(!Hit.bTriggered && !Hit.bRedundant);
+
+	//Only Size bytes are compared
+	LastValue = 0x1100000000000005ull;
+	Current = 0x2200000000000005ull;
+	Hit = ClassifyHit(0x1, 0, &LastValue, &Current, 4);
+	HWBP_CHECK(Hit.bTriggered && !Hit.bValueChanged && Hit.bRedundant);
+}
+
+static void TestConditions()
+{
+	int Watched = 10;
+	std::uint8_t LastValue[8] = { 0 };
+	const int Previous = 3;
+	std::memcpy(LastValue, &Previous, sizeof(Previous));
+
+	auto Increased = [](const int& Old, const int& New) { return New > Old; };
+	TDataBreakpointConditionAdapter<int, decltype(Increased)> Condition(Increased);
+	IHardwareBreakpointCondition& Generic = Condition;
+	HWBP_CHECK(Generic.ShouldBreak(LastValue, &Watched));
+	Watched = 1;
+	HWBP_CHECK(!Generic.ShouldBreak(LastValue, &Watched));
+}
+
+//Synthetic stack: frame i lives at Stack[FrameStride * i], holding the caller's frame pointer and the return address
+static const std::uint32_t FrameStride = 4;
+static const std::uint32_t NumFrames = 8;
+alignas(16) static std::uint64_t Stack[FrameStride * NumFrames + FrameStride];
+
+static std::uint64_t FrameAddress(std::uint32_t Frame)
+{
+	return reinterpret_cast<std::uint64_t>(&Stack[FrameStride * Frame]);
+}
+
+static void BuildStack()
+{
+	std::memset(Stack, 0, sizeof(Stack));
+	for (std::uint32_t Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		Stack[FrameStride * Frame] = Frame + 1 < NumFrames ? FrameAddress(Frame + 1) : 0;
+		Stack[FrameStride * Frame + 1] = 0x140000000ull + Frame;
+	}
+}
+
+static void TestWalkFramePointers()
+{
+	BuildStack();
+	const std::uint64_t StackLow = FrameAddress(0);
+	const std::uint64_t StackHigh = reinterpret_cast<std::uint64_t>(Stack + sizeof(Stack) / sizeof(Stack[0]));
+	std::uint64_t BackTrace[32] = { 0 };
+
+	//The program counter, then one return address per frame. The last frame's null caller ends the walk
+	std::uint32_t Depth = WalkFramePointers(0x7000, StackLow, StackLow, StackHigh, BackTrace, 32);
+	HWBP_CHECK(Depth == NumFrames + 1);
+	HWBP_CHECK(BackTrace[0] == 0x7000);
+	for (std::uint32_t Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		HWBP_CHECK(BackTrace[Frame + 1] == 0x140000000ull + Frame);
+	}
+
+	HWBP_CHECK(WalkFramePointers(0x7000, StackLow, StackLow, StackHigh, BackTrace, 3) == 3);
+	HWBP_CHECK(WalkFramePointers(0x7000, StackLow, StackLow, StackHigh, BackTrace, 1) == 1);
+	HWBP_CHECK(WalkFramePointers(0x7000, StackLow, StackLow, StackHigh, BackTrace, 0) == 0);
+
+	//A frame pointer register holding something else stops the walk before it's dereferenced
+	HWBP_CHECK(WalkFramePointers(0x7000, 0x10, StackLow, StackHigh, BackTrace, 32) == 1);
+	HWBP_CHECK(WalkFramePointers(0x7000, StackLow + 4, StackLow, StackHigh, BackTrace, 32) == 1);
+	HWBP_CHECK(WalkFramePointers(0x7000, StackHigh, StackLow, StackHigh, BackTrace, 32) == 1);
+
+	//A chain that doesn't move towards the top of the stack is cut
+	Stack[FrameStride * 2] = FrameAddress(1);
+	HWBP_CHECK(WalkFramePointers(0x7000, StackLow, StackLow, StackHigh, BackTrace, 32) == 4);
+
+	//So is one that leaves the stack
+	BuildStack();
+	Stack[FrameStride * 2] = StackHigh + 64;
+	HWBP_CHECK(WalkFramePointers(0x7000, StackLow, StackLow, StackHigh, BackTrace, 32) == 4);
+
+	//A null return address ends the walk without being reported
+	BuildStack();
+	Stack[FrameStride * 3 + 1] = 0;
+	HWBP_CHECK(WalkFramePointers(0x7000, StackLow, StackLow, StackHigh, BackTrace, 32) == 4);
+}
+
+int main()
+{
+	TestEnableSlot();
+	TestDisableSlot();
+	TestFindFreeSlot();
+	TestGetTriggeredSlots();
+	TestAlignment();
+	TestArmDisarm();
+	TestClassifyHit();
+	TestConditions();
+	TestWalkFramePointers();
+
+	std::printf("%d checks, %d failed\n", NumChecks, NumFailures);
+	return NumFailures == 0 ? 0 : 1;
+}